@@ -0,0 +1,19 @@
+#version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Every texture registered into the bindless table.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform Sprite {
+    vec2 offset;
+    float scale;
+    uint texture_index;
+} sprite;
+
+layout(location = 0) in vec2 in_uv;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    out_color = texture(textures[sprite.texture_index], in_uv);
+}
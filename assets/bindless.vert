@@ -0,0 +1,24 @@
+#version 450 core
+
+layout(set = 0, binding = 0) uniform View {
+    mat4 mat_vp;
+};
+
+// Per sprite: where it is, and which texture of the bindless table it uses.
+layout(push_constant) uniform Sprite {
+    vec2 offset;
+    float scale;
+    uint texture_index;
+} sprite;
+
+layout(location = 0) in vec2 a_pos;
+layout(location = 1) in vec2 a_uv;
+
+layout(location = 0) out vec2 out_uv;
+
+void main() {
+    const vec4 world_pos = vec4(sprite.offset + sprite.scale * a_pos, 0.0, 1.0);
+
+    out_uv = a_uv;
+    gl_Position = mat_vp * world_pos;
+}
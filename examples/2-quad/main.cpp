@@ -98,10 +98,10 @@ namespace {
       .usage = vk::BufferUsageFlagBits::eVertexBuffer |
         vk::BufferUsageFlagBits::eIndexBuffer,
       .queue_family = app.gpu.queue_family,
+      .direct_write = app.direct_write,
     };
 
-    auto command_block =
-      framework::CommandBlock{*app.device, app.queue, *app.cmd_block_pool};
+    auto command_block = app.create_command_block();
 
     return framework::vma::create_device_buffer(
       buffer_info, std::move(command_block), total_bytes
@@ -71,7 +71,7 @@ namespace {
   }
 
   auto create_vertex_buffer(framework::Renderer &app)
-    -> std::pair<framework::vma::Buffer, framework::DescriptorBuffer> {
+    -> framework::vma::Buffer {
     static constexpr auto vertices = std::array{
       Vertex{.position = {-200.0f, -200.0f}, .uv = {0.0f, 1.0f}},
       Vertex{.position = {200.0f, -200.0f}, .uv = {1.0f, 1.0f}},
@@ -102,22 +102,14 @@ namespace {
       .usage = vk::BufferUsageFlagBits::eVertexBuffer |
         vk::BufferUsageFlagBits::eIndexBuffer,
       .queue_family = app.gpu.queue_family,
+      .direct_write = app.direct_write,
     };
 
-    auto command_block =
-      framework::CommandBlock{*app.device, app.queue, *app.cmd_block_pool};
+    auto command_block = app.create_command_block();
 
-    auto device_buffer = framework::vma::create_device_buffer(
+    return framework::vma::create_device_buffer(
       buffer_info, std::move(command_block), total_bytes
     );
-
-    auto view_ubo = framework::DescriptorBuffer(
-      app.allocator.get(),
-      app.gpu.queue_family,
-      vk::BufferUsageFlagBits::eUniformBuffer
-    );
-
-    return std::pair(std::move(device_buffer), std::move(view_ubo));
   }
 
   constexpr auto layout_binding(
@@ -137,11 +129,20 @@ auto main() -> int {
   std::println("Using assets directory: {}", assets_dir.string());
 
   auto app = framework::Renderer();
-  auto [vertex_buffer, view_ubo] = create_vertex_buffer(app);
-
-  static constexpr auto pool_sizes = std::array{
-    vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, 2},
-    vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 2},
+  auto vertex_buffer = create_vertex_buffer(app);
+  // Moved by defragmentation (LVK_DEFRAG) like the texture.
+  auto const vertex_tracking = app.defragmenter->track(vertex_buffer);
+
+  // The view ubo is pushed into the uniform arena every frame and bound at a
+  // dynamic offset. The texture has a set per virtual frame: each is
+  // rewritten once its frame has retired, after the texture is relocated.
+  auto const frame_count =
+    static_cast<std::uint32_t>(app.frames_in_flight());
+  auto const pool_sizes = std::array{
+    vk::DescriptorPoolSize{vk::DescriptorType::eUniformBufferDynamic, 1},
+    vk::DescriptorPoolSize{
+      vk::DescriptorType::eCombinedImageSampler, frame_count
+    },
   };
 
   // Allow 16 sets to be allocated from this pool
@@ -149,17 +150,49 @@ auto main() -> int {
     vk::DescriptorPoolCreateInfo().setPoolSizes(pool_sizes).setMaxSets(16);
   auto descriptor_pool = app.device->createDescriptorPoolUnique(pool_info);
 
+  using Pixel = std::array<std::byte, 4>;
+  static constexpr auto rgby_pixels_v = std::array{
+    Pixel{std::byte{0xff}, {}, {}, std::byte{0xff}},
+    Pixel{std::byte{}, std::byte{0xff}, {}, std::byte{0xff}},
+    Pixel{std::byte{}, {}, std::byte{0xff}, std::byte{0xff}},
+    Pixel{std::byte{0xff}, std::byte{0xff}, {}, std::byte{0xff}},
+  };
+  static constexpr auto rgby_bytes_v =
+    std::bit_cast<std::array<std::byte, sizeof(rgby_pixels_v)>>(rgby_pixels_v);
+  static constexpr auto rgby_bitmap_v = framework::vma::Bitmap{
+    .bytes = rgby_bytes_v,
+    .size = {2, 2},
+  };
+
+  auto command_block = app.create_command_block();
+
+  auto texture_info = framework::Texture::CreateInfo{
+    .device = *app.device,
+    .allocator = app.allocator.get(),
+    .queue_family = app.gpu.queue_family,
+    .command_block = std::move(command_block),
+    .bitmap = rgby_bitmap_v,
+    .sampler_cache = &*app.samplers,
+    .defragmenter = &*app.defragmenter,
+  };
+  // use Nearest filtering instead of Linear (interpolation).
+  texture_info.sampler.setMagFilter(vk::Filter::eNearest);
+  auto texture = framework::Texture(std::move(texture_info));
+
   static constexpr auto set_0_bindings_v = std::array{
-    layout_binding(0, vk::DescriptorType::eUniformBuffer),
+    layout_binding(0, vk::DescriptorType::eUniformBufferDynamic),
   };
 
-  static constexpr auto set_1_bindings_v = std::array{
-    layout_binding(0, vk::DescriptorType::eCombinedImageSampler),
+  // The texture's sampler is baked into the layout, shared through the
+  // cache with every texture using the same sampler info.
+  auto const set_1_bindings = std::array{
+    layout_binding(0, vk::DescriptorType::eCombinedImageSampler)
+      .setImmutableSamplers(texture.get_sampler().get()),
   };
 
   auto set_layout_cis = std::array<vk::DescriptorSetLayoutCreateInfo, 2>{
     vk::DescriptorSetLayoutCreateInfo().setBindings(set_0_bindings_v),
-    vk::DescriptorSetLayoutCreateInfo().setBindings(set_1_bindings_v),
+    vk::DescriptorSetLayoutCreateInfo().setBindings(set_1_bindings),
   };
 
   std::vector<vk::UniqueDescriptorSetLayout> m_set_layouts{};
@@ -177,14 +210,15 @@ auto main() -> int {
   auto m_pipeline_layout =
     app.device->createPipelineLayoutUnique(pipeline_layout_ci);
 
-  framework::Buffered<std::vector<vk::DescriptorSet>> m_descriptor_sets{};
-  for (auto &descriptor_sets : m_descriptor_sets) {
-    auto allocate_info = vk::DescriptorSetAllocateInfo()
-                           .setDescriptorPool(*descriptor_pool)
-                           .setSetLayouts(m_set_layout_views);
+  auto allocate_info = vk::DescriptorSetAllocateInfo()
+                         .setDescriptorPool(*descriptor_pool)
+                         .setSetLayouts(m_set_layout_views[0]);
+  auto const view_set = app.device->allocateDescriptorSets(allocate_info)[0];
 
-    descriptor_sets = app.device->allocateDescriptorSets(allocate_info);
-  }
+  auto const texture_layouts =
+    std::vector<vk::DescriptorSetLayout>(frame_count, m_set_layout_views[1]);
+  allocate_info.setSetLayouts(texture_layouts);
+  auto const texture_sets = app.device->allocateDescriptorSets(allocate_info);
 
   auto shader = create_shader(
     app,
@@ -193,33 +227,33 @@ auto main() -> int {
     m_set_layout_views
   );
 
-  using Pixel = std::array<std::byte, 4>;
-  static constexpr auto rgby_pixels_v = std::array{
-    Pixel{std::byte{0xff}, {}, {}, std::byte{0xff}},
-    Pixel{std::byte{}, std::byte{0xff}, {}, std::byte{0xff}},
-    Pixel{std::byte{}, {}, std::byte{0xff}, std::byte{0xff}},
-    Pixel{std::byte{0xff}, std::byte{0xff}, {}, std::byte{0xff}},
-  };
-  static constexpr auto rgby_bytes_v =
-    std::bit_cast<std::array<std::byte, sizeof(rgby_pixels_v)>>(rgby_pixels_v);
-  static constexpr auto rgby_bitmap_v = framework::vma::Bitmap{
-    .bytes = rgby_bytes_v,
-    .size = {2, 2},
-  };
-
-  auto command_block =
-    framework::CommandBlock{*app.device, app.queue, *app.cmd_block_pool};
-
-  auto texture_info = framework::Texture::CreateInfo{
-    .device = *app.device,
-    .allocator = app.allocator.get(),
-    .queue_family = app.gpu.queue_family,
-    .command_block = std::move(command_block),
-    .bitmap = rgby_bitmap_v,
+  // Bind the view ubo, once.
+  auto write = vk::WriteDescriptorSet{};
+  auto const view_ubo_info = app.uniforms->descriptor_info(sizeof(glm::mat4));
+  write.setBufferInfo(view_ubo_info)
+    .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+    .setDescriptorCount(1)
+    .setDstSet(view_set)
+    .setDstBinding(0);
+  app.device->updateDescriptorSets(write, {});
+
+  auto write_texture_set = [&app, &texture](vk::DescriptorSet const set) {
+    auto const image_info = texture.descriptor_info();
+    auto const write = vk::WriteDescriptorSet()
+                         .setImageInfo(image_info)
+                         .setDescriptorType(
+                           vk::DescriptorType::eCombinedImageSampler
+                         )
+                         .setDescriptorCount(1)
+                         .setDstSet(set)
+                         .setDstBinding(0);
+    app.device->updateDescriptorSets(write, {});
   };
-  // use Nearest filtering instead of Linear (interpolation).
-  texture_info.sampler.setMagFilter(vk::Filter::eNearest);
-  auto texture = framework::Texture(std::move(texture_info));
+  for (auto const set : texture_sets) write_texture_set(set);
+  // Defragmenter generation each texture set was written at.
+  auto texture_generations = std::vector<std::uint64_t>(
+    frame_count, app.defragmenter->get_generation()
+  );
 
   auto use_wireframe = false;
   framework::Transform view_transform{};
@@ -228,10 +262,11 @@ auto main() -> int {
                &shader,
                &vertex_buffer,
                &use_wireframe,
-               &view_ubo,
-               &m_descriptor_sets,
+               &view_set,
+               &texture_sets,
+               &texture_generations,
+               &write_texture_set,
                &m_pipeline_layout,
-               &texture,
                &view_transform](vk::CommandBuffer const command_buffer) {
     ImGui::SetNextWindowSize({200.0f, 100.0f}, ImGuiCond_Once);
     if (ImGui::Begin("Inspect")) {
@@ -268,43 +303,26 @@ auto main() -> int {
       glm::ortho(-half_size.x, half_size.x, -half_size.y, half_size.y);
     auto const mat_view = view_transform.view_matrix();
     auto const mat_vp = mat_projection * mat_view;
-    auto const bytes =
-      std::bit_cast<std::array<std::byte, sizeof(mat_vp)>>(mat_vp);
-
-    view_ubo.write_at(app.frame_index, bytes);
+    auto const view_offset = app.uniforms->push(mat_vp);
 
     shader.bind(command_buffer, app.framebuffer_size);
 
-    // Bind view ubo
-    auto writes = std::array<vk::WriteDescriptorSet, 2>{};
-    auto const &descriptor_set = m_descriptor_sets.at(app.frame_index);
-    auto const set0 = descriptor_set[0];
-    auto write = vk::WriteDescriptorSet{};
-    auto const view_ubo_info = view_ubo.descriptor_info_at(app.frame_index);
-    write.setBufferInfo(view_ubo_info)
-      .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-      .setDescriptorCount(1)
-      .setDstSet(set0)
-      .setDstBinding(0);
-    writes[0] = write;
-
-    auto const set1 = descriptor_set[1];
-    auto const image_info = texture.descriptor_info();
-    write.setImageInfo(image_info)
-      .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-      .setDescriptorCount(1)
-      .setDstSet(set1)
-      .setDstBinding(0);
-    writes[1] = write;
-
-    app.device->updateDescriptorSets(writes, {});
+    // This frame's previous submission has retired: its texture set can be
+    // pointed at the relocated texture.
+    auto const generation = app.defragmenter->get_generation();
+    auto const texture_set = texture_sets.at(app.frame_index);
+    if (texture_generations.at(app.frame_index) != generation) {
+      write_texture_set(texture_set);
+      texture_generations.at(app.frame_index) = generation;
+    }
 
+    auto const descriptor_sets = std::array{view_set, texture_set};
     command_buffer.bindDescriptorSets(
       vk::PipelineBindPoint::eGraphics,
       *m_pipeline_layout,
       0,
-      descriptor_set,
-      {}
+      descriptor_sets,
+      view_offset
     );
 
     // Single VBO at binding 0 at no offset
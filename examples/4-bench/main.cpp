@@ -0,0 +1,684 @@
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+import framework;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+// Headless benchmarks of the framework's resource paths:
+//   4-bench [uploads|direct-write|transients|parallel] [count]
+//   4-bench ktx
+//   4-bench decode [dir]  (default: assets/decode)
+// Results are printed, and written as JSON to $LVK_BENCH_OUTPUT if set.
+namespace {
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  constexpr auto rounds_v = 5;
+  // Frames of each frame loop, when not set from the environment.
+  constexpr auto default_warmup_v = 100uz;
+  constexpr auto default_frames_v = 500uz;
+
+  // Named results of a run, in insertion order.
+  struct Report {
+    std::vector<std::pair<std::string, double>> values;
+
+    void add(std::string name, double const value) {
+      std::println("  {}: {:.3f}", name, value);
+      values.emplace_back(std::move(name), value);
+    }
+
+    auto write_json(fs::path const &path) const -> bool {
+      auto file = std::ofstream{path};
+      if (!file.is_open()) {
+        std::println(
+          stderr, "Failed to open file: '{}'", path.generic_string()
+        );
+        return false;
+      }
+
+      file << "{\n";
+      for (auto i = 0uz; i < values.size(); ++i) {
+        auto const &[name, value] = values.at(i);
+        auto const separator = i + 1 < values.size() ? "," : "";
+        file << std::format("  \"{}\": {:.4f}{}\n", name, value, separator);
+      }
+      file << "}\n";
+
+      std::println("Wrote results to '{}'", path.generic_string());
+      return true;
+    }
+  };
+
+  // Median wall time of rounds_v calls to fn.
+  auto median(std::vector<Milliseconds> times) -> Milliseconds {
+    std::ranges::sort(times);
+    return times.at(times.size() / 2);
+  }
+
+  auto time_median(std::function<void()> const &fn) -> Milliseconds {
+    auto times = std::vector<Milliseconds>{};
+    for (auto i = 0; i < rounds_v; ++i) {
+      auto const start = Clock::now();
+      fn();
+      times.emplace_back(Clock::now() - start);
+    }
+    return median(std::move(times));
+  }
+
+  // count vertex buffers and count 128x128 textures, uploaded one
+  // submission per resource vs one batch for all, blocking or async.
+  void bench_uploads(
+    framework::Renderer &app, std::size_t const count, Report &report
+  ) {
+    static constexpr auto extent_v = 128;
+    static constexpr auto bytes_v = std::size_t{extent_v * extent_v * 4};
+
+    auto const data = std::vector<std::byte>(bytes_v, std::byte{0x7f});
+    auto const spans = std::array{std::span<std::byte const>{data}};
+    auto const bitmap = framework::vma::Bitmap{
+      .bytes = data,
+      .size = {extent_v, extent_v},
+    };
+
+    auto const buffer_info = framework::vma::BufferCreateInfo{
+      .allocator = app.allocator.get(),
+      .usage = vk::BufferUsageFlagBits::eVertexBuffer,
+      .queue_family = app.gpu.queue_family,
+      .direct_write = app.direct_write,
+    };
+    auto const image_info = framework::vma::ImageCreateInfo{
+      .allocator = app.allocator.get(),
+      .queue_family = app.gpu.queue_family,
+    };
+
+    auto const per_resource = time_median([&] {
+      auto buffers = std::vector<framework::vma::Buffer>{};
+      auto textures = std::vector<framework::Texture>{};
+      for (auto i = 0uz; i < count; ++i) {
+        buffers.push_back(framework::vma::create_device_buffer(
+          buffer_info, app.create_command_block(), spans
+        ));
+        textures.emplace_back(framework::Texture::CreateInfo{
+          .device = *app.device,
+          .allocator = app.allocator.get(),
+          .queue_family = app.gpu.queue_family,
+          .command_block = app.create_command_block(),
+          .bitmap = bitmap,
+        });
+      }
+    });
+
+    auto const batched = time_median([&] {
+      auto buffers = std::vector<framework::vma::Buffer>{};
+      auto textures = std::vector<framework::Texture>{};
+      auto batch = app.create_upload_batch();
+      for (auto i = 0uz; i < count; ++i) {
+        buffers.push_back(batch.add_buffer(buffer_info, spans));
+        textures.emplace_back(
+          *app.device, batch.add_image(image_info, bitmap)
+        );
+      }
+      batch.submit();
+    });
+
+    // Time until the render loop could continue, and until completion.
+    auto async_submits = std::vector<Milliseconds>{};
+    auto const async = time_median([&] {
+      auto const start = Clock::now();
+      auto buffers = std::vector<framework::vma::Buffer>{};
+      auto textures = std::vector<framework::Texture>{};
+      auto batch = app.create_upload_batch();
+      for (auto i = 0uz; i < count; ++i) {
+        buffers.push_back(batch.add_buffer(buffer_info, spans));
+        textures.emplace_back(
+          *app.device, batch.add_image(image_info, bitmap)
+        );
+      }
+      auto const ticket = app.submit_async(std::move(batch));
+      async_submits.emplace_back(Clock::now() - start);
+      if (!ticket.wait()) std::println(stderr, "Failed to wait for upload");
+    });
+
+    auto const resources = static_cast<double>(2 * count);
+    auto const megabytes =
+      resources * static_cast<double>(bytes_v) / (1024.0 * 1024.0);
+    std::println("uploads: {} buffers + {} textures", count, count);
+    report.add("uploads_count", resources);
+    report.add("uploads_per_resource_ms", per_resource.count());
+    report.add("uploads_batched_ms", batched.count());
+    report.add(
+      "uploads_per_resource_mb_s", megabytes / (per_resource.count() / 1e3)
+    );
+    report.add("uploads_batched_mb_s", megabytes / (batched.count() / 1e3));
+    report.add("uploads_speedup", per_resource / batched);
+    report.add(
+      "uploads_async_submit_ms", median(std::move(async_submits)).count()
+    );
+    report.add("uploads_async_complete_ms", async.count());
+  }
+
+  // count 256 KiB vertex buffers created with create_device_buffer(),
+  // written directly (host visible device local memory) vs through staging.
+  void bench_direct_write(
+    framework::Renderer &app, std::size_t const count, Report &report
+  ) {
+    static constexpr auto bytes_v = std::size_t{256 * 1024};
+
+    auto const data = std::vector<std::byte>(bytes_v, std::byte{0x7f});
+    auto const spans = std::array{std::span<std::byte const>{data}};
+    auto const upload_all = [&](bool const direct_write) {
+      auto const buffer_info = framework::vma::BufferCreateInfo{
+        .allocator = app.allocator.get(),
+        .usage = vk::BufferUsageFlagBits::eVertexBuffer,
+        .queue_family = app.gpu.queue_family,
+        .direct_write = direct_write,
+      };
+      return time_median([&] {
+        auto buffers = std::vector<framework::vma::Buffer>{};
+        for (auto i = 0uz; i < count; ++i) {
+          buffers.push_back(framework::vma::create_device_buffer(
+            buffer_info, app.create_command_block(), spans
+          ));
+        }
+      });
+    };
+
+    auto const detected = app.direct_write;
+    auto const staged = upload_all(false);
+    auto const direct = upload_all(true);
+
+    auto const megabytes =
+      static_cast<double>(count * bytes_v) / (1024.0 * 1024.0);
+    std::println("direct-write: {} buffers of 256 KiB", count);
+    // Without host visible device local memory both paths stage.
+    report.add("direct_write_detected", detected ? 1.0 : 0.0);
+    report.add("direct_write_staged_ms", staged.count());
+    report.add("direct_write_direct_ms", direct.count());
+    report.add("direct_write_staged_mb_s", megabytes / (staged.count() / 1e3));
+    report.add("direct_write_direct_mb_s", megabytes / (direct.count() / 1e3));
+    report.add("direct_write_speedup", staged / direct);
+  }
+
+  // Adds a bloom chain to graph: scene, bright pass, levels_v downsamples
+  // then upsamples (each also sampling its downsample), and a composite.
+  // Passes only clear, the chain's transient lifetimes are what matters.
+  void add_bloom_chain(framework::RenderGraph &graph) {
+    static constexpr auto extent_v = vk::Extent2D{1920, 1080};
+    static constexpr auto levels_v = 6uz;
+    static constexpr auto hdr_format_v = vk::Format::eR16G16B16A16Sfloat;
+    using framework::ResourceUsage;
+
+    auto const create_hdr = [&graph](vk::Extent2D const extent) {
+      return graph.create_image(framework::TransientImage{
+        .extent = extent,
+        .format = hdr_format_v,
+      });
+    };
+
+    auto const scene = create_hdr(extent_v);
+    graph.add_pass(framework::GraphPass{
+      .name = "scene",
+      .color_attachments = {framework::ColorAttachment{.image = scene}},
+    });
+
+    auto down = std::vector{create_hdr(extent_v)};
+    auto extents = std::vector{extent_v};
+    graph.add_pass(framework::GraphPass{
+      .name = "bright",
+      .color_attachments = {framework::ColorAttachment{.image = down.back()}},
+      .images = {framework::ImageUse{scene, ResourceUsage::Sampled}},
+    });
+
+    for (auto level = 1uz; level <= levels_v; ++level) {
+      auto const extent = vk::Extent2D{
+        std::max(extents.back().width / 2, 1u),
+        std::max(extents.back().height / 2, 1u),
+      };
+      auto const source = down.back();
+      down.push_back(create_hdr(extent));
+      extents.push_back(extent);
+      graph.add_pass(framework::GraphPass{
+        .name = "downsample",
+        .color_attachments = {framework::ColorAttachment{.image = down.back()}},
+        .images = {framework::ImageUse{source, ResourceUsage::Sampled}},
+      });
+    }
+
+    auto up = down.back();
+    for (auto level = levels_v; level-- > 1;) {
+      auto const source = up;
+      up = create_hdr(extents.at(level));
+      graph.add_pass(framework::GraphPass{
+        .name = "upsample",
+        .color_attachments = {framework::ColorAttachment{.image = up}},
+        .images =
+          {
+            framework::ImageUse{source, ResourceUsage::Sampled},
+            framework::ImageUse{down.at(level), ResourceUsage::Sampled},
+          },
+      });
+    }
+
+    auto const output = graph.create_image(framework::TransientImage{
+      .extent = extent_v,
+      .format = vk::Format::eR8G8B8A8Unorm,
+    });
+    graph.add_pass(framework::GraphPass{
+      .name = "composite",
+      .color_attachments = {framework::ColorAttachment{.image = output}},
+      .images =
+        {
+          framework::ImageUse{scene, ResourceUsage::Sampled},
+          framework::ImageUse{up, ResourceUsage::Sampled},
+        },
+      .has_side_effects = true,
+    });
+  }
+
+  // count frames of a 1080p bloom chain, with transients each in their own
+  // memory vs aliased by lifetime.
+  void bench_transients(
+    framework::Renderer &app, std::size_t const count, Report &report
+  ) {
+    auto const run = [&](bool const alias) {
+      auto graph = framework::RenderGraph{framework::RenderGraph::CreateInfo{
+        .device = *app.device,
+        .allocator = app.allocator.get(),
+        .queue_family = app.gpu.queue_family,
+        .buffering = app.frames_in_flight(),
+        .alias_transients = alias,
+      }};
+      auto const time = time_median([&] {
+        for (auto i = 0uz; i < count; ++i) {
+          auto command_block = framework::CommandBlock{
+            *app.device, app.queue, *app.cmd_block_pool
+          };
+          add_bloom_chain(graph);
+          graph.execute(command_block.get_command_buffer());
+          command_block.submit_and_wait();
+        }
+      });
+      return std::pair{graph.get_transient_stats(), time};
+    };
+
+    auto const [separate, separate_time] = run(false);
+    auto const [aliased, aliased_time] = run(true);
+
+    auto const to_mib = [](vk::DeviceSize const bytes) {
+      return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    };
+    auto const frames = static_cast<double>(count);
+    std::println(
+      "transients: bloom chain, {} images, {} frames", aliased.images, count
+    );
+    report.add("transients_images", static_cast<double>(aliased.images));
+    report.add(
+      "transients_lazy_images", static_cast<double>(aliased.lazy_images)
+    );
+    report.add(
+      "transients_separate_allocations",
+      static_cast<double>(separate.allocations)
+    );
+    report.add(
+      "transients_aliased_allocations",
+      static_cast<double>(aliased.allocations)
+    );
+    report.add("transients_separate_mib", to_mib(separate.allocated_bytes));
+    report.add("transients_aliased_mib", to_mib(aliased.allocated_bytes));
+    report.add("transients_saved_mib", to_mib(aliased.saved_bytes()));
+    report.add("transients_separate_frame_ms", separate_time.count() / frames);
+    report.add("transients_aliased_frame_ms", aliased_time.count() / frames);
+  }
+
+  // Writes a BC1 KTX2 file with a full mip chain, just what load_ktx2()
+  // reads. Blocks cycle through colour endpoints and index patterns.
+  void write_bc1_ktx2(fs::path const &path, std::uint32_t const extent) {
+    auto const level_count = static_cast<std::uint32_t>(std::bit_width(extent));
+    // identifier, header, supercompression global data offset and size.
+    static constexpr auto header_size_v = 12uz + 52 + 16;
+
+    auto levels = std::vector<std::vector<std::byte>>{};
+    for (auto level = 0u; level < level_count; ++level) {
+      auto const blocks = ((extent >> level) + 3) / 4;
+      auto &bytes = levels.emplace_back();
+      for (auto i = 0uz; i < std::size_t{blocks} * blocks; ++i) {
+        auto const c0 = static_cast<std::uint16_t>(0xf800 | (i * 37 & 0x7ff));
+        auto const c1 = static_cast<std::uint16_t>((i * 131) & 0x07ff);
+        auto const indices = static_cast<std::uint32_t>(i * 0x9e3779b9u);
+        for (auto const b : {c0 & 0xff, c0 >> 8, c1 & 0xff, c1 >> 8}) {
+          bytes.push_back(static_cast<std::byte>(b));
+        }
+        for (auto shift = 0; shift < 32; shift += 8) {
+          bytes.push_back(static_cast<std::byte>(indices >> shift));
+        }
+      }
+    }
+
+    auto const put = [](std::ofstream &file, auto const value) {
+      file.write(reinterpret_cast<char const *>(&value), sizeof(value));
+    };
+    auto file = std::ofstream{path, std::ios::binary};
+    file.write("\xabKTX 20\xbb\r\n\x1a\n", 12);
+    for (auto const field : {
+           static_cast<std::uint32_t>(vk::Format::eBc1RgbaUnormBlock),
+           1u, // type size
+           extent,
+           extent,
+           0u, // depth
+           0u, // layers
+           1u, // faces
+           level_count,
+           0u, // supercompression
+           0u, // dfd and kvd offsets and sizes: unused by load_ktx2().
+           0u,
+           0u,
+           0u,
+         }) {
+      put(file, field);
+    }
+    put(file, std::uint64_t{});
+    put(file, std::uint64_t{});
+    auto offset = std::uint64_t{header_size_v + 24 * levels.size()};
+    for (auto const &level : levels) {
+      put(file, offset);
+      put(file, std::uint64_t{level.size()});
+      put(file, std::uint64_t{level.size()});
+      offset += level.size();
+    }
+    for (auto const &level : levels) {
+      file.write(
+        reinterpret_cast<char const *>(level.data()),
+        static_cast<std::streamsize>(level.size())
+      );
+    }
+  }
+
+  // Vertex layout of assets/shader.vert: position at 0, color at 1.
+  struct Vertex {
+    glm::vec2 position{};
+    glm::vec3 color{1.0f};
+  };
+
+  constexpr auto vertex_attributes = std::array{
+    vk::VertexInputAttributeDescription2EXT{
+      0, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, position)
+    },
+    vk::VertexInputAttributeDescription2EXT{
+      1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color)
+    },
+  };
+
+  constexpr auto vertex_bindings = std::array{
+    vk::VertexInputBindingDescription2EXT{
+      0, sizeof(Vertex), vk::VertexInputRate::eVertex, 1
+    },
+  };
+
+  // count draw tasks of draws_per_task_v small triangles per frame, all
+  // recorded on this thread (Renderer::run()) vs each into a secondary
+  // command buffer on the recording threads (Renderer::run_parallel()).
+  // Each loop renders the frames set by LVK_BENCH_WARMUP/LVK_BENCH_FRAMES.
+  void bench_parallel(
+    framework::Renderer &app, std::size_t const count, Report &report
+  ) {
+    static constexpr auto draws_per_task_v = 64u;
+
+    auto const assets_dir = framework::locate_assets_dir();
+    auto const vertex_spirv =
+      framework::read_spir_v(assets_dir / "shader.vert.spv");
+    auto const fragment_spirv =
+      framework::read_spir_v(assets_dir / "shader.frag.spv");
+    static constexpr auto vertex_input = framework::ShaderVertexInput{
+      .attributes = vertex_attributes,
+      .bindings = vertex_bindings,
+    };
+    auto const shader = framework::ShaderProgram{
+      framework::ShaderProgram::CreateInfo{
+        .device = *app.device,
+        .vertex_spirv = vertex_spirv,
+        .fragment_spirv = fragment_spirv,
+        .vertex_input = vertex_input,
+        .set_layouts = {},
+      }
+    };
+
+    static constexpr auto vertices = std::array{
+      Vertex{.position = {-0.01f, -0.01f}, .color = {1.0f, 0.0f, 0.0f}},
+      Vertex{.position = {0.01f, -0.01f}, .color = {0.0f, 1.0f, 0.0f}},
+      Vertex{.position = {0.0f, 0.01f}, .color = {0.0f, 0.0f, 1.0f}},
+    };
+    auto vertex_buffer = framework::vma::create_buffer(
+      framework::vma::BufferCreateInfo{
+        .allocator = app.allocator.get(),
+        .usage = vk::BufferUsageFlagBits::eVertexBuffer,
+        .queue_family = app.gpu.queue_family,
+      },
+      framework::vma::BufferMemoryType::Host,
+      sizeof(vertices)
+    );
+    std::memcpy(vertex_buffer.get().mapped, vertices.data(), sizeof(vertices));
+
+    // One task's draws, binding its own state as secondaries don't
+    // inherit it.
+    auto const draw_task = [&](vk::CommandBuffer const command_buffer) {
+      shader.bind(command_buffer, app.framebuffer_size);
+      command_buffer.bindVertexBuffers(
+        0, vertex_buffer.get().buffer, vk::DeviceSize{}
+      );
+      for (auto i = 0u; i < draws_per_task_v; ++i) {
+        command_buffer.draw(3, 1, 0, 0);
+      }
+    };
+
+    auto const cpu_frame = [&app] {
+      return app.frame_stats.summarize(&framework::FrameSample::cpu_frame);
+    };
+
+    app.run([&](vk::CommandBuffer const command_buffer) {
+      for (auto i = 0uz; i < count; ++i) draw_task(command_buffer);
+    });
+    auto const single = cpu_frame();
+
+    app.run_parallel([&](std::vector<framework::DrawTask> &tasks) {
+      tasks.assign(count, draw_task);
+    });
+    auto const parallel = cpu_frame();
+
+    auto const threads = app.recorder->thread_count();
+    std::println(
+      "parallel: {} tasks of {} draws, {} recording threads",
+      count,
+      draws_per_task_v,
+      threads
+    );
+    report.add("parallel_tasks", static_cast<double>(count));
+    report.add("parallel_draws", static_cast<double>(count * draws_per_task_v));
+    report.add("parallel_threads", static_cast<double>(threads));
+    report.add("parallel_frames", static_cast<double>(app.frame_stats.frames));
+    report.add("parallel_single_cpu_frame_ms", single.mean);
+    report.add("parallel_single_cpu_frame_p99_ms", single.p99);
+    report.add("parallel_recorded_cpu_frame_ms", parallel.mean);
+    report.add("parallel_recorded_cpu_frame_p99_ms", parallel.p99);
+    if (parallel.mean > 0.0) {
+      report.add("parallel_speedup", single.mean / parallel.mean);
+    }
+  }
+
+  // A 2048x2048 BC1 KTX2 texture loaded and uploaded, kept block
+  // compressed vs decompressed to RGBA8 on the CPU (the fallback for
+  // devices without BC support).
+  void bench_ktx(framework::Renderer &app, Report &report) {
+    static constexpr auto extent_v = 2048u;
+
+    auto const path = fs::temp_directory_path() / "lvk-bench.ktx2";
+    write_bc1_ktx2(path, extent_v);
+
+    auto const image_info = framework::vma::ImageCreateInfo{
+      .allocator = app.allocator.get(),
+      .queue_family = app.gpu.queue_family,
+    };
+    struct Result {
+      bool decompressed{};
+      std::size_t bytes{};
+      Milliseconds time{};
+    };
+    auto const run = [&](bool const decompress) {
+      auto ret = Result{};
+      ret.time = time_median([&] {
+        auto const ktx = framework::load_ktx2(path, app.gpu.device, decompress);
+        auto batch = app.create_upload_batch();
+        auto const image = batch.add_image(image_info, ktx.get_levels());
+        batch.submit();
+        ret.decompressed = ktx.is_decompressed();
+        ret.bytes = ktx.size();
+      });
+      return ret;
+    };
+
+    auto const native = run(false);
+    auto const decompressed = run(true);
+    fs::remove(path);
+
+    auto const to_mib = [](std::size_t const bytes) {
+      return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    };
+    std::println("ktx: {}x{} BC1, full mip chain", extent_v, extent_v);
+    // Without BC support both runs decompress.
+    report.add("ktx_bc_sampled", native.decompressed ? 0.0 : 1.0);
+    report.add("ktx_native_mib", to_mib(native.bytes));
+    report.add("ktx_decompressed_mib", to_mib(decompressed.bytes));
+    report.add("ktx_native_ms", native.time.count());
+    report.add("ktx_decompressed_ms", decompressed.time.count());
+    report.add("ktx_decompress_cost", decompressed.time / native.time);
+  }
+
+  // every PNG / JPEG / QOI file under dir decoded and uploaded as textures,
+  // on one worker thread vs the default pool. Fails if there are none.
+  auto bench_decode(
+    framework::Renderer &app, fs::path const &dir, Report &report
+  ) -> bool {
+    if (!fs::is_directory(dir)) {
+      std::println(stderr, "No such directory: '{}'", dir.generic_string());
+      return false;
+    }
+    auto paths = std::vector<fs::path>{};
+    for (auto const &entry : fs::recursive_directory_iterator{dir}) {
+      auto const extension = entry.path().extension();
+      if (extension == ".png" || extension == ".jpg" ||
+          extension == ".jpeg" || extension == ".qoi") {
+        paths.push_back(entry.path());
+      }
+    }
+    if (paths.empty()) {
+      std::println(
+        stderr, "No PNG / JPEG / QOI files in '{}'", dir.generic_string()
+      );
+      return false;
+    }
+
+    auto const image_info = framework::vma::ImageCreateInfo{
+      .allocator = app.allocator.get(),
+      .queue_family = app.gpu.queue_family,
+    };
+    auto const run = [&](std::size_t const threads) {
+      auto thread_pool = framework::ThreadPool{threads};
+      auto loader = framework::TextureLoader{thread_pool};
+      auto const time = time_median([&] {
+        auto batch = app.create_upload_batch();
+        auto const images = loader.load(batch, image_info, paths);
+        batch.submit();
+      });
+      // per round: stats accumulate over every load().
+      auto const &stats = loader.get_stats();
+      auto const textures = static_cast<double>(stats.textures) / rounds_v;
+      auto const megabytes =
+        static_cast<double>(stats.decoded_bytes) / (1024.0 * 1024.0) / rounds_v;
+      auto const seconds = time.count() / 1e3;
+      return std::array{time.count(), textures / seconds, megabytes / seconds};
+    };
+
+    auto const threads = framework::ThreadPool::default_thread_count();
+    auto const single = run(1);
+    auto const pooled = run(threads);
+
+    std::println(
+      "decode: {} files in '{}', {} threads",
+      paths.size(),
+      dir.generic_string(),
+      threads
+    );
+    report.add("decode_files", static_cast<double>(paths.size()));
+    report.add("decode_threads", static_cast<double>(threads));
+    report.add("decode_single_ms", single[0]);
+    report.add("decode_single_textures_s", single[1]);
+    report.add("decode_single_mb_s", single[2]);
+    report.add("decode_pooled_ms", pooled[0]);
+    report.add("decode_pooled_textures_s", pooled[1]);
+    report.add("decode_pooled_mb_s", pooled[2]);
+    report.add("decode_speedup", single[0] / pooled[0]);
+    return true;
+  }
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+  auto const args = std::vector<std::string_view>(argv + 1, argv + argc);
+  auto const mode = args.empty() ? std::string_view{"uploads"} : args.at(0);
+  auto const count = args.size() > 1 && mode != "decode"
+    ? static_cast<std::size_t>(std::stoul(std::string{args.at(1)}))
+    : std::size_t{256};
+
+  auto create_info = framework::Renderer::CreateInfo::from_env();
+  create_info.headless = true;
+  // The report is written instead of the frame loops' stats.
+  create_info.stats_path.clear();
+  // Without LVK_BENCH_FRAMES, headless frame loops would stop after one.
+  if (create_info.max_frames <= 1 && create_info.max_duration <= 0s) {
+    create_info.warmup_frames = default_warmup_v;
+    create_info.max_frames = default_warmup_v + default_frames_v;
+  }
+  auto app = framework::Renderer(std::move(create_info));
+
+  auto report = Report{};
+  if (mode == "uploads") {
+    bench_uploads(app, count, report);
+  } else if (mode == "direct-write") {
+    bench_direct_write(app, count, report);
+  } else if (mode == "transients") {
+    bench_transients(app, count, report);
+  } else if (mode == "parallel") {
+    bench_parallel(app, count, report);
+  } else if (mode == "ktx") {
+    bench_ktx(app, report);
+  } else if (mode == "decode") {
+    // Defaults to the corpus committed with the assets.
+    auto const dir = args.size() > 1
+      ? fs::path{args.at(1)}
+      : framework::locate_assets_dir() / "decode";
+    if (!bench_decode(app, dir, report)) return EXIT_FAILURE;
+  } else {
+    std::println(stderr, "Unknown benchmark: '{}'", mode);
+    return EXIT_FAILURE;
+  }
+
+  if (auto const *path = std::getenv("LVK_BENCH_OUTPUT")) {
+    report.write_json(path);
+  }
+}
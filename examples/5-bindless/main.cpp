@@ -0,0 +1,322 @@
+#include "imgui.h"
+#include "glm/ext/matrix_clip_space.hpp"
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <print>
+#include <vector>
+
+import framework;
+
+namespace fs = std::filesystem;
+
+// Thousands of sprites, each sampling its own texture out of the renderer's
+// BindlessTable: descriptor sets are bound once per frame, and each draw
+// only pushes its sprite's offset, scale and texture index.
+namespace {
+  struct Vertex {
+    glm::vec2 position{};
+    glm::vec2 uv{};
+  };
+
+  // Per draw, matching the shaders' push constant block.
+  struct Sprite {
+    glm::vec2 offset{};
+    float scale{};
+    std::uint32_t texture_index{};
+  };
+
+  constexpr auto columns_v = 64;
+  constexpr auto rows_v = 32;
+  constexpr auto texture_count_v = std::size_t{columns_v * rows_v};
+  constexpr auto texture_extent_v = 8;
+  constexpr auto sprite_size_v = 16.0f;
+
+  // Two vertex attributes: position at 0, uv at 1.
+  constexpr auto vertex_attributes = std::array{
+    vk::VertexInputAttributeDescription2EXT{
+      0, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, position)
+    },
+    vk::VertexInputAttributeDescription2EXT{
+      1, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, uv)
+    },
+  };
+
+  constexpr auto vertex_bindings = std::array{
+    vk::VertexInputBindingDescription2EXT{
+      0, sizeof(Vertex), vk::VertexInputRate::eVertex, 1
+    },
+  };
+
+  constexpr auto push_constant_ranges = std::array{
+    vk::PushConstantRange{
+      vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+      0,
+      sizeof(Sprite),
+    },
+  };
+
+  template <typename T> [[nodiscard]] constexpr auto to_byte_array(T const &t) {
+    return std::bit_cast<std::array<std::byte, sizeof(T)>>(t);
+  }
+
+  auto create_shader(
+    framework::Renderer &app,
+    fs::path const &vertex_path,
+    fs::path const &fragment_path,
+    std::span<vk::DescriptorSetLayout const> set_layouts
+  ) -> framework::ShaderProgram {
+    auto const vertex_spirv = framework::read_spir_v(vertex_path);
+    auto const fragment_spirv = framework::read_spir_v(fragment_path);
+
+    static constexpr auto vertex_input = framework::ShaderVertexInput{
+      .attributes = vertex_attributes,
+      .bindings = vertex_bindings,
+    };
+
+    auto const shader_info = framework::ShaderProgram::CreateInfo{
+      .device = *app.device,
+      .vertex_spirv = vertex_spirv,
+      .fragment_spirv = fragment_spirv,
+      .vertex_input = vertex_input,
+      .set_layouts = set_layouts,
+      .push_constant_ranges = push_constant_ranges,
+    };
+
+    return framework::ShaderProgram(shader_info);
+  }
+
+  // Unit quad centred on the origin: 4 vertices, then 6 u32 indices.
+  auto create_vertex_buffer(framework::Renderer &app)
+    -> framework::vma::Buffer {
+    static constexpr auto vertices = std::array{
+      Vertex{.position = {-0.5f, -0.5f}, .uv = {0.0f, 1.0f}},
+      Vertex{.position = {0.5f, -0.5f}, .uv = {1.0f, 1.0f}},
+      Vertex{.position = {0.5f, 0.5f}, .uv = {1.0f, 0.0f}},
+      Vertex{.position = {-0.5f, 0.5f}, .uv = {0.0f, 0.0f}},
+    };
+    static constexpr auto indices = std::array{0u, 1u, 2u, 2u, 3u, 0u};
+
+    static constexpr auto vertices_bytes = to_byte_array(vertices);
+    static constexpr auto indices_bytes = to_byte_array(indices);
+    static constexpr auto total_bytes =
+      std::array<std::span<std::byte const>, 2>{
+        vertices_bytes,
+        indices_bytes,
+      };
+
+    auto const buffer_info = framework::vma::BufferCreateInfo{
+      .allocator = app.allocator.get(),
+      .usage = vk::BufferUsageFlagBits::eVertexBuffer |
+        vk::BufferUsageFlagBits::eIndexBuffer,
+      .queue_family = app.gpu.queue_family,
+      .direct_write = app.direct_write,
+    };
+
+    return framework::vma::create_device_buffer(
+      buffer_info, app.create_command_block(), total_bytes
+    );
+  }
+
+  // Checkerboard of a colour derived from index, and white.
+  auto create_bitmap_bytes(std::size_t const index) -> std::vector<std::byte> {
+    auto const colour = std::array{
+      static_cast<std::byte>(64 + (index * 37) % 192),
+      static_cast<std::byte>(64 + (index * 91) % 192),
+      static_cast<std::byte>(64 + (index * 53) % 192),
+    };
+    auto ret = std::vector<std::byte>{};
+    ret.reserve(texture_extent_v * texture_extent_v * 4);
+    for (auto y = 0; y < texture_extent_v; ++y) {
+      for (auto x = 0; x < texture_extent_v; ++x) {
+        auto const is_white = ((x / 2) + (y / 2)) % 2 == 0;
+        for (auto const channel : colour) {
+          ret.push_back(is_white ? std::byte{0xff} : channel);
+        }
+        ret.push_back(std::byte{0xff});
+      }
+    }
+    return ret;
+  }
+
+  // texture_count_v textures uploaded in one batch, each registered into
+  // the bindless table, sharing one sampler, and moved by defragmentation
+  // (LVK_DEFRAG).
+  auto create_textures(framework::Renderer &app)
+    -> std::vector<framework::Texture> {
+    auto const image_info = framework::vma::ImageCreateInfo{
+      .allocator = app.allocator.get(),
+      .queue_family = app.gpu.queue_family,
+    };
+    auto const sampler_info =
+      vk::SamplerCreateInfo()
+        .setMagFilter(vk::Filter::eNearest)
+        .setMinFilter(vk::Filter::eNearest)
+        .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+        .setMaxLod(VK_LOD_CLAMP_NONE);
+
+    // bitmaps must outlive the batch's submission.
+    auto bitmaps = std::vector<std::vector<std::byte>>{};
+    auto ret = std::vector<framework::Texture>{};
+    bitmaps.reserve(texture_count_v);
+    ret.reserve(texture_count_v);
+
+    auto batch = app.create_upload_batch();
+    for (auto i = 0uz; i < texture_count_v; ++i) {
+      auto const &bytes = bitmaps.emplace_back(create_bitmap_bytes(i));
+      auto const bitmap = framework::vma::Bitmap{
+        .bytes = bytes,
+        .size = {texture_extent_v, texture_extent_v},
+      };
+      ret.emplace_back(
+        *app.device,
+        batch.add_image(image_info, bitmap),
+        sampler_info,
+        &*app.samplers,
+        &*app.bindless,
+        &*app.defragmenter
+      );
+    }
+    batch.submit();
+
+    return ret;
+  }
+} // namespace
+
+auto main() -> int {
+  // TODO(teevik) Configurable
+  glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_X11);
+
+  auto assets_dir = framework::locate_assets_dir();
+  std::println("Using assets directory: {}", assets_dir.string());
+
+  auto app = framework::Renderer();
+  if (!app.bindless) {
+    std::println(stderr, "Descriptor indexing is not supported by the GPU");
+    return EXIT_FAILURE;
+  }
+
+  auto vertex_buffer = create_vertex_buffer(app);
+  // Not const: relocated by the defragmenter.
+  auto textures = create_textures(app);
+
+  // Set 0: the view ubo, pushed into the uniform arena every frame.
+  // Set 1: the bindless table, holding every texture.
+  auto const pool_size =
+    vk::DescriptorPoolSize{vk::DescriptorType::eUniformBufferDynamic, 1};
+  auto const pool_info =
+    vk::DescriptorPoolCreateInfo().setPoolSizes(pool_size).setMaxSets(1);
+  auto const descriptor_pool =
+    app.device->createDescriptorPoolUnique(pool_info);
+
+  static constexpr auto view_binding_v = vk::DescriptorSetLayoutBinding{
+    0,
+    vk::DescriptorType::eUniformBufferDynamic,
+    1,
+    vk::ShaderStageFlagBits::eAllGraphics,
+  };
+  auto const view_layout = app.device->createDescriptorSetLayoutUnique(
+    vk::DescriptorSetLayoutCreateInfo().setBindings(view_binding_v)
+  );
+  auto const set_layouts =
+    std::array{*view_layout, app.bindless->get_layout()};
+
+  auto const pipeline_layout =
+    app.device->createPipelineLayoutUnique(
+      vk::PipelineLayoutCreateInfo()
+        .setSetLayouts(set_layouts)
+        .setPushConstantRanges(push_constant_ranges)
+    );
+
+  auto const allocate_info = vk::DescriptorSetAllocateInfo()
+                               .setDescriptorPool(*descriptor_pool)
+                               .setSetLayouts(*view_layout);
+  auto const view_set = app.device->allocateDescriptorSets(allocate_info)[0];
+
+  auto const view_ubo_info = app.uniforms->descriptor_info(sizeof(glm::mat4));
+  auto const write = vk::WriteDescriptorSet()
+                       .setBufferInfo(view_ubo_info)
+                       .setDescriptorType(
+                         vk::DescriptorType::eUniformBufferDynamic
+                       )
+                       .setDstSet(view_set)
+                       .setDstBinding(0);
+  app.device->updateDescriptorSets(write, {});
+
+  auto shader = create_shader(
+    app,
+    assets_dir / "bindless.vert.spv",
+    assets_dir / "bindless.frag.spv",
+    set_layouts
+  );
+
+  // A grid of sprites, one per texture: texture indices are read per draw,
+  // as they change when textures are relocated.
+  auto sprites = std::vector<Sprite>{};
+  sprites.reserve(columns_v * rows_v);
+  for (auto y = 0; y < rows_v; ++y) {
+    for (auto x = 0; x < columns_v; ++x) {
+      auto const cell = glm::vec2(x - (columns_v / 2), y - (rows_v / 2));
+      sprites.push_back(Sprite{
+        .offset = (cell + 0.5f) * sprite_size_v,
+        .scale = sprite_size_v - 2.0f,
+      });
+    }
+  }
+
+  framework::Transform view_transform{};
+
+  auto draw = [&](vk::CommandBuffer const command_buffer) {
+    ImGui::SetNextWindowSize({250.0f, 100.0f}, ImGuiCond_Once);
+    if (ImGui::Begin("Inspect")) {
+      ImGui::Text("%zu sprites, %zu textures", sprites.size(), textures.size());
+      if (ImGui::TreeNode("View")) {
+        ImGui::DragFloat2("position", &view_transform.position.x);
+        ImGui::DragFloat("rotation", &view_transform.rotation);
+        ImGui::DragFloat2("scale", &view_transform.scale.x);
+        ImGui::TreePop();
+      }
+    }
+    ImGui::End();
+
+    auto const half_size = 0.5f * glm::vec2{app.framebuffer_size};
+    auto const mat_projection =
+      glm::ortho(-half_size.x, half_size.x, -half_size.y, half_size.y);
+    auto const mat_vp = mat_projection * view_transform.view_matrix();
+    auto const view_offset = app.uniforms->push(mat_vp);
+
+    shader.bind(command_buffer, app.framebuffer_size);
+
+    // Bound once for every sprite.
+    command_buffer.bindDescriptorSets(
+      vk::PipelineBindPoint::eGraphics,
+      *pipeline_layout,
+      0,
+      view_set,
+      view_offset
+    );
+    app.bindless->bind(command_buffer, *pipeline_layout, 1);
+
+    command_buffer.bindVertexBuffers(
+      0, vertex_buffer.get().buffer, vk::DeviceSize{}
+    );
+    command_buffer.bindIndexBuffer(
+      vertex_buffer.get().buffer, 4 * sizeof(Vertex), vk::IndexType::eUint32
+    );
+
+    for (auto i = 0uz; i < sprites.size(); ++i) {
+      auto sprite = sprites[i];
+      sprite.texture_index = *textures[i].get_bindless_index();
+      command_buffer.pushConstants<Sprite>(
+        *pipeline_layout, push_constant_ranges[0].stageFlags, 0, sprite
+      );
+      command_buffer.drawIndexed(6, 1, 0, 0, 0);
+    }
+  };
+
+  app.run(draw);
+}
@@ -6,6 +6,7 @@ module;
 #include <vector>
 
 export module framework:assets;
+import :trace;
 
 namespace fs = std::filesystem;
 
@@ -37,6 +38,7 @@ namespace framework {
   /// Read a SPIR-V file from disk
   export [[nodiscard]] auto read_spir_v(fs::path const &path)
     -> std::vector<std::uint32_t> {
+    auto const span = trace::Span{"read_spir_v"};
     // Open the file at the end, to get the total size.
     auto file = std::ifstream{path, std::ios::binary | std::ios::ate};
     if (!file.is_open()) {
@@ -0,0 +1,256 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+export module framework:bindless_table;
+import :scoped;
+
+namespace {
+  constexpr auto binding_flags_v =
+    vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+    vk::DescriptorBindingFlagBits::ePartiallyBound |
+    vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+} // namespace
+
+namespace framework {
+  struct BindlessTableCreateInfo {
+    vk::Device device;
+    // Size of the texture array (binding 0).
+    std::uint32_t max_textures{4096};
+    // Size of the storage buffer array (binding 1).
+    std::uint32_t max_buffers{1024};
+  };
+
+  /// One descriptor set holding every registered texture (binding 0, a
+  /// combined image sampler array) and storage buffer (binding 1): bind it
+  /// once per frame, then draws select their resources with an index, eg a
+  /// push constant, instead of binding sets. Slots are written with
+  /// update-after-bind, so registering never waits for frames in flight;
+  /// released slots are reused once the frames which may still read them
+  /// have retired (see seal() and collect()). Needs descriptor indexing
+  /// (Renderer::descriptor_indexing). Not thread-safe.
+  export class BindlessTable {
+  public:
+    using CreateInfo = BindlessTableCreateInfo;
+
+    /// Declares the arrays in GLSL (with GL_EXT_nonuniform_qualifier):
+    ///   layout(set = N, binding = 0) uniform sampler2D textures[];
+    ///   layout(set = N, binding = 1) buffer Buffers { ... } buffers[];
+    static constexpr std::uint32_t texture_binding_v{0};
+    static constexpr std::uint32_t buffer_binding_v{1};
+
+    explicit BindlessTable(CreateInfo const &create_info) :
+      device(create_info.device) {
+      auto const bindings = std::array{
+        vk::DescriptorSetLayoutBinding{
+          texture_binding_v,
+          vk::DescriptorType::eCombinedImageSampler,
+          create_info.max_textures,
+          vk::ShaderStageFlagBits::eAllGraphics,
+        },
+        vk::DescriptorSetLayoutBinding{
+          buffer_binding_v,
+          vk::DescriptorType::eStorageBuffer,
+          create_info.max_buffers,
+          vk::ShaderStageFlagBits::eAllGraphics,
+        },
+      };
+      auto const flags = std::array<vk::DescriptorBindingFlags, 2>{
+        binding_flags_v, binding_flags_v
+      };
+      auto const flags_info =
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo().setBindingFlags(flags);
+      auto const layout_info =
+        vk::DescriptorSetLayoutCreateInfo()
+          .setFlags(
+            vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool
+          )
+          .setBindings(bindings)
+          .setPNext(&flags_info);
+      layout = device.createDescriptorSetLayoutUnique(layout_info);
+
+      auto const pool_sizes = std::array{
+        vk::DescriptorPoolSize{
+          vk::DescriptorType::eCombinedImageSampler, create_info.max_textures
+        },
+        vk::DescriptorPoolSize{
+          vk::DescriptorType::eStorageBuffer, create_info.max_buffers
+        },
+      };
+      auto const pool_info =
+        vk::DescriptorPoolCreateInfo()
+          .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
+          .setPoolSizes(pool_sizes)
+          .setMaxSets(1);
+      pool = device.createDescriptorPoolUnique(pool_info);
+
+      auto const allocate_info = vk::DescriptorSetAllocateInfo()
+                                   .setDescriptorPool(*pool)
+                                   .setSetLayouts(*layout);
+      set = device.allocateDescriptorSets(allocate_info).front();
+
+      textures.capacity = create_info.max_textures;
+      buffers.capacity = create_info.max_buffers;
+    }
+
+    [[nodiscard]] auto get_layout() const -> vk::DescriptorSetLayout {
+      return *layout;
+    }
+
+    [[nodiscard]] auto get_set() const -> vk::DescriptorSet { return set; }
+
+    void bind(
+      vk::CommandBuffer const command_buffer,
+      vk::PipelineLayout const pipeline_layout,
+      std::uint32_t const set_index
+    ) const {
+      command_buffer.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics, pipeline_layout, set_index, set, {}
+      );
+    }
+
+    /// Writes image_info into a free texture slot, returns its index.
+    /// Throws if every slot is in use.
+    [[nodiscard]] auto add_texture(vk::DescriptorImageInfo const &image_info)
+      -> std::uint32_t {
+      auto const ret = textures.acquire();
+      auto const write =
+        vk::WriteDescriptorSet()
+          .setDstSet(set)
+          .setDstBinding(texture_binding_v)
+          .setDstArrayElement(ret)
+          .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+          .setImageInfo(image_info);
+      device.updateDescriptorSets(write, {});
+      return ret;
+    }
+
+    /// Writes buffer_info into a free buffer slot, returns its index.
+    /// Throws if every slot is in use.
+    [[nodiscard]] auto add_buffer(vk::DescriptorBufferInfo const &buffer_info)
+      -> std::uint32_t {
+      auto const ret = buffers.acquire();
+      auto const write =
+        vk::WriteDescriptorSet()
+          .setDstSet(set)
+          .setDstBinding(buffer_binding_v)
+          .setDstArrayElement(ret)
+          .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+          .setBufferInfo(buffer_info);
+      device.updateDescriptorSets(write, {});
+      return ret;
+    }
+
+    /// Frees a slot for reuse once the next sealed value has retired.
+    void remove_texture(std::uint32_t const index) {
+      textures.unsealed.push_back(index);
+    }
+
+    void remove_buffer(std::uint32_t const index) {
+      buffers.unsealed.push_back(index);
+    }
+
+    /// Slots removed since the last call may be read until value: call
+    /// with the value signalled by each frame's submission.
+    void seal(std::uint64_t const value) {
+      textures.seal(value);
+      buffers.seal(value);
+    }
+
+    /// Frees the slots no longer read by any submission, given the last
+    /// completed timeline value.
+    void collect(std::uint64_t const completed) {
+      textures.collect(completed);
+      buffers.collect(completed);
+    }
+
+    /// Number of texture slots in use (or waiting to be reused).
+    [[nodiscard]] auto texture_count() const -> std::uint32_t {
+      return textures.count();
+    }
+
+    [[nodiscard]] auto buffer_count() const -> std::uint32_t {
+      return buffers.count();
+    }
+
+  private:
+    // Indices of one binding's array: never handed out past capacity.
+    struct Slots {
+      struct Retired {
+        std::uint32_t index{};
+        std::uint64_t in_use_until{};
+      };
+
+      std::uint32_t capacity{};
+      std::uint32_t next{};
+      std::vector<std::uint32_t> free;
+      std::vector<std::uint32_t> unsealed;
+      std::vector<Retired> retired;
+
+      auto acquire() -> std::uint32_t {
+        if (!free.empty()) {
+          auto const ret = free.back();
+          free.pop_back();
+          return ret;
+        }
+        if (next == capacity) {
+          throw std::runtime_error{"Bindless Table is full"};
+        }
+        return next++;
+      }
+
+      void seal(std::uint64_t const value) {
+        for (auto const index : unsealed) {
+          retired.push_back(Retired{.index = index, .in_use_until = value});
+        }
+        unsealed.clear();
+      }
+
+      void collect(std::uint64_t const completed) {
+        std::erase_if(retired, [&](Retired const &slot) {
+          if (slot.in_use_until > completed) return false;
+          free.push_back(slot.index);
+          return true;
+        });
+      }
+
+      [[nodiscard]] auto count() const -> std::uint32_t {
+        return next - static_cast<std::uint32_t>(free.size());
+      }
+    };
+
+    vk::Device device;
+    vk::UniqueDescriptorSetLayout layout;
+    vk::UniqueDescriptorPool pool;
+    // Freed with the pool.
+    vk::DescriptorSet set;
+    Slots textures;
+    Slots buffers;
+  };
+
+  export struct RawBindlessSlot {
+    auto operator==(RawBindlessSlot const &rhs) const -> bool = default;
+
+    BindlessTable *table{};
+    std::uint32_t binding{};
+    std::uint32_t index{};
+  };
+
+  export struct BindlessSlotDeleter {
+    void operator()(RawBindlessSlot const &slot) const noexcept {
+      if (slot.binding == BindlessTable::buffer_binding_v) {
+        slot.table->remove_buffer(slot.index);
+      } else {
+        slot.table->remove_texture(slot.index);
+      }
+    }
+  };
+
+  /// A slot in a BindlessTable, removed on destruction.
+  export using BindlessSlot = Scoped<RawBindlessSlot, BindlessSlotDeleter>;
+} // namespace framework
@@ -1,21 +1,388 @@
 module;
 
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <chrono>
+#include <optional>
 #include <print>
+#include <span>
+#include <utility>
+#include <vector>
 
 export module framework:command_block;
+import :staging_ring;
+import :timeline;
+import :trace;
 
 using namespace std::chrono_literals;
 
 namespace framework {
+  /// A queue, its family, and a command pool for that family.
+  export struct QueueInfo {
+    vk::Queue queue;
+    std::uint32_t family{};
+    vk::CommandPool command_pool;
+  };
+
+  /// Completion of an asynchronous submission: a value on a Timeline.
+  /// Cheap to copy. Poll it, wait for it, or make another submission wait
+  /// for it with wait_info(). Default constructed tickets are complete.
+  export class UploadTicket {
+  public:
+    UploadTicket() = default;
+
+    explicit UploadTicket(Timeline const &timeline, std::uint64_t const value) :
+      timeline(&timeline),
+      value(value) {}
+
+    [[nodiscard]] auto get_value() const -> std::uint64_t {
+      return value;
+    }
+
+    [[nodiscard]] auto is_complete() const -> bool {
+      return !timeline || timeline->is_retired(value);
+    }
+
+    /// Blocks until complete, returns false on timeout.
+    [[nodiscard]] auto wait(std::chrono::nanoseconds const timeout = 30s) const
+      -> bool {
+      if (!timeline) return true;
+      return timeline->wait(value, static_cast<std::uint64_t>(timeout.count()));
+    }
+
+    /// Info to wait for completion before a submission executes stage.
+    [[nodiscard]] auto wait_info(
+      vk::PipelineStageFlags2 const stage =
+        vk::PipelineStageFlagBits2::eAllCommands
+    ) const -> vk::SemaphoreSubmitInfo {
+      if (!timeline) return {};
+      return timeline->wait_info(value, stage);
+    }
+
+  private:
+    Timeline const *timeline{};
+    std::uint64_t value{};
+  };
+
+  /// Owns the Command Buffers of an asynchronous submission until it has
+  /// executed: destroying one that is still incomplete blocks until it is.
+  export class PendingSubmission {
+  public:
+    PendingSubmission() = default;
+
+    explicit PendingSubmission(
+      UploadTicket const ticket,
+      vk::UniqueCommandBuffer command_buffer,
+      vk::UniqueCommandBuffer owner_command_buffer,
+      vk::UniqueSemaphore transferred
+    ) :
+      ticket(ticket),
+      command_buffer(std::move(command_buffer)),
+      owner_command_buffer(std::move(owner_command_buffer)),
+      transferred(std::move(transferred)) {}
+
+    PendingSubmission(PendingSubmission const &) = delete;
+    auto operator=(PendingSubmission const &) = delete;
+
+    PendingSubmission(PendingSubmission &&rhs) noexcept :
+      ticket(std::exchange(rhs.ticket, {})),
+      command_buffer(std::move(rhs.command_buffer)),
+      owner_command_buffer(std::move(rhs.owner_command_buffer)),
+      transferred(std::move(rhs.transferred)) {}
+
+    auto operator=(PendingSubmission &&rhs) noexcept -> PendingSubmission & {
+      if (&rhs != this) {
+        std::swap(ticket, rhs.ticket);
+        std::swap(command_buffer, rhs.command_buffer);
+        std::swap(owner_command_buffer, rhs.owner_command_buffer);
+        std::swap(transferred, rhs.transferred);
+      }
+      return *this;
+    }
+
+    ~PendingSubmission() {
+      if (!ticket.wait()) {
+        std::println(stderr, "Failed to wait for Command Buffer");
+      }
+    }
+
+    [[nodiscard]] auto get_ticket() const -> UploadTicket {
+      return ticket;
+    }
+
+    [[nodiscard]] auto is_complete() const -> bool {
+      return ticket.is_complete();
+    }
+
+  private:
+    UploadTicket ticket;
+    vk::UniqueCommandBuffer command_buffer;
+    vk::UniqueCommandBuffer owner_command_buffer;
+    vk::UniqueSemaphore transferred;
+  };
+
   export class CommandBlock {
   public:
+    /// staging is required for uploads (see stage()).
     explicit CommandBlock(
       const vk::Device device,
       const vk::Queue queue,
-      const vk::CommandPool command_pool
-    ) : device(device), queue(queue) {
+      const vk::CommandPool command_pool,
+      StagingRing *staging = nullptr
+    ) :
+      device(device),
+      queue(queue),
+      command_pool(command_pool),
+      staging(staging) {
+      command_buffer = begin(command_pool);
+    }
+
+    /// Records on a dedicated transfer queue. Resources written there are
+    /// handed over to the graphics queue with transfer_ownership(), whose
+    /// acquire half is recorded into get_owner_command_buffer().
+    explicit CommandBlock(
+      const vk::Device device,
+      QueueInfo const &transfer,
+      QueueInfo const &graphics,
+      StagingRing *staging = nullptr
+    ) :
+      device(device),
+      queue(transfer.queue),
+      command_pool(transfer.command_pool),
+      staging(staging),
+      owner_queue(graphics.queue),
+      owner_command_pool(graphics.command_pool),
+      src_family(transfer.family),
+      dst_family(graphics.family) {
+      command_buffer = begin(command_pool);
+      if (transfer.family != graphics.family) {
+        owner_command_buffer = begin(owner_command_pool);
+      } else {
+        // Same family: no ownership transfers, a single submission.
+        queue = graphics.queue;
+        command_pool = graphics.command_pool;
+      }
+    }
+
+    [[nodiscard]] auto get_command_buffer() const -> vk::CommandBuffer {
+      return *command_buffer;
+    }
+
+    /// Command Buffer that executes on the queue owning the resources
+    /// afterwards, after get_command_buffer() has completed.
+    /// Same as get_command_buffer() without a separate transfer queue.
+    [[nodiscard]] auto get_owner_command_buffer() const -> vk::CommandBuffer {
+      return owner_command_buffer ? *owner_command_buffer : *command_buffer;
+    }
+
+    [[nodiscard]] auto is_cross_queue() const -> bool {
+      return static_cast<bool>(owner_command_buffer);
+    }
+
+    [[nodiscard]] auto has_staging() const -> bool {
+      return staging != nullptr;
+    }
+
+    /// Allocates staging memory for up to size bytes, in a multiple of
+    /// granularity (eg an image row) unless size is smaller. Returns less
+    /// than size when it exceeds the staging ring: callers upload in chunks.
+    /// Submits the commands recorded so far (see flush()) if the ring is
+    /// full.
+    [[nodiscard]] auto stage(
+      vk::DeviceSize const size,
+      vk::DeviceSize const alignment,
+      vk::DeviceSize const granularity = 1
+    ) -> StagingAllocation {
+      if (!staging) {
+        throw std::runtime_error{"Command Block has no Staging Ring"};
+      }
+
+      auto const max_size = staging->capacity() / granularity * granularity;
+      if (max_size == 0) {
+        throw std::runtime_error{"Staging Ring too small for upload"};
+      }
+
+      auto const chunk = std::min(size, max_size);
+      if (auto ret = staging->allocate(chunk, alignment)) return *ret;
+
+      flush();
+      if (auto ret = staging->allocate(chunk, alignment)) return *ret;
+
+      throw std::runtime_error{"Failed to allocate Staging memory"};
+    }
+
+    /// Allocates size bytes of staging memory without submitting anything,
+    /// or returns nullopt if the ring has no room until flush(): eg to hand
+    /// out memory other threads write into before the next submission.
+    [[nodiscard]] auto try_stage(
+      vk::DeviceSize const size, vk::DeviceSize const alignment
+    ) -> std::optional<StagingAllocation> {
+      if (!staging) {
+        throw std::runtime_error{"Command Block has no Staging Ring"};
+      }
+      return staging->allocate(size, alignment);
+    }
+
+    /// Submits the commands recorded so far and waits for them, then keeps
+    /// recording into new command buffers. Frees up the staging ring.
+    void flush() {
+      submit_and_wait();
+      command_buffer = begin(command_pool);
+      if (owner_command_pool && dst_family != src_family) {
+        owner_command_buffer = begin(owner_command_pool);
+      }
+    }
+
+    /// Records barrier as a release on the transfer queue and a matching
+    /// acquire on the owner queue. The barrier describes the dependency as
+    /// if both sides were on one queue: src is the transfer, dst the
+    /// eventual consumer. Recorded as-is when not cross-queue.
+    void transfer_ownership(vk::ImageMemoryBarrier2 barrier) const {
+      record_transfer(barrier);
+    }
+
+    void transfer_ownership(vk::BufferMemoryBarrier2 barrier) const {
+      record_transfer(barrier);
+    }
+
+    /// Batched transfer_ownership(): one release and one acquire dependency
+    /// for all barriers.
+    void transfer_ownership(
+      std::span<vk::ImageMemoryBarrier2 const> image_barriers,
+      std::span<vk::BufferMemoryBarrier2 const> buffer_barriers
+    ) const {
+      if (image_barriers.empty() && buffer_barriers.empty()) return;
+
+      // records copies of all barriers, each adjusted by fn.
+      auto const record = [&](vk::CommandBuffer const cb, auto const fn) {
+        auto images = std::vector<vk::ImageMemoryBarrier2>(
+          image_barriers.begin(), image_barriers.end()
+        );
+        auto buffers = std::vector<vk::BufferMemoryBarrier2>(
+          buffer_barriers.begin(), buffer_barriers.end()
+        );
+        for (auto &barrier : images) fn(barrier);
+        for (auto &barrier : buffers) fn(barrier);
+        auto dependency_info = vk::DependencyInfo()
+                                 .setImageMemoryBarriers(images)
+                                 .setBufferMemoryBarriers(buffers);
+        cb.pipelineBarrier2(dependency_info);
+      };
+
+      if (!owner_command_buffer) {
+        record(*command_buffer, [](auto &barrier) {
+          barrier.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+        });
+        return;
+      }
+
+      // Release and acquire, as in record_transfer().
+      record(*command_buffer, [this](auto &barrier) {
+        barrier.setSrcQueueFamilyIndex(src_family)
+          .setDstQueueFamilyIndex(dst_family)
+          .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+          .setDstAccessMask(vk::AccessFlagBits2::eNone);
+      });
+      record(*owner_command_buffer, [this](auto &barrier) {
+        barrier.setSrcQueueFamilyIndex(src_family)
+          .setDstQueueFamilyIndex(dst_family)
+          .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+          .setSrcAccessMask(vk::AccessFlagBits2::eNone);
+      });
+    }
+
+    /// Submits without blocking. Staging memory is reclaimed, and the
+    /// returned Command Buffers can be released, once its ticket completes.
+    /// Requires a staging ring, whose timeline tracks completion.
+    [[nodiscard]] auto submit() -> PendingSubmission {
+      if (!staging) {
+        throw std::runtime_error{"Command Block has no Staging Ring"};
+      }
+      if (!command_buffer) return {};
+      auto const span = trace::Span{"CommandBlock::submit"};
+
+      // The last submission signals the staging ring's timeline, whose
+      // memory is reclaimed once the value is reached.
+      auto &timeline = staging->get_timeline();
+      auto const value = timeline.next_value();
+      staging->retire(value);
+      auto transferred = submit_batches(timeline.signal_info(value), {});
+
+      return PendingSubmission{
+        UploadTicket{timeline, value},
+        std::move(command_buffer),
+        std::move(owner_command_buffer),
+        std::move(transferred),
+      };
+    }
+
+    void submit_and_wait() {
+      if (!command_buffer) return;
+      auto const span = trace::Span{"CommandBlock::submit_and_wait"};
+
+      if (staging) {
+        auto const pending = submit();
+        if (!pending.get_ticket().wait(30s)) {
+          std::println(stderr, "Failed to submit Command Buffer");
+        }
+        return;
+      }
+
+      auto fence = device.createFenceUnique({});
+      auto const transferred = submit_batches({}, *fence);
+      wait(*fence);
+
+      // Free the command buffers.
+      command_buffer.reset();
+      owner_command_buffer.reset();
+    }
+
+  private:
+    // ends recording and submits, signalling signal_info (if any) and fence
+    // with the last submission. Returns the semaphore between the transfer
+    // and owner queue submissions, if cross-queue.
+    auto submit_batches(
+      std::optional<vk::SemaphoreSubmitInfo> const &signal_info,
+      vk::Fence const fence
+    ) const -> vk::UniqueSemaphore {
+      command_buffer->end();
+      if (owner_command_buffer) owner_command_buffer->end();
+
+      auto const command_buffer_info =
+        vk::CommandBufferSubmitInfo{*command_buffer};
+      auto submit_info =
+        vk::SubmitInfo2KHR().setCommandBufferInfos(command_buffer_info);
+
+      if (!owner_command_buffer) {
+        if (signal_info) submit_info.setSignalSemaphoreInfos(*signal_info);
+        queue.submit2(submit_info, fence);
+        return {};
+      }
+
+      // Transfer queue signals, owner queue waits before acquiring.
+      auto transferred = device.createSemaphoreUnique({});
+      auto const transferred_info =
+        vk::SemaphoreSubmitInfo()
+          .setSemaphore(*transferred)
+          .setStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+      submit_info.setSignalSemaphoreInfos(transferred_info);
+      queue.submit2(submit_info);
+
+      auto const owner_command_buffer_info =
+        vk::CommandBufferSubmitInfo{*owner_command_buffer};
+      auto owner_submit_info =
+        vk::SubmitInfo2KHR()
+          .setCommandBufferInfos(owner_command_buffer_info)
+          .setWaitSemaphoreInfos(transferred_info);
+      if (signal_info) owner_submit_info.setSignalSemaphoreInfos(*signal_info);
+      owner_queue.submit2(owner_submit_info, fence);
+
+      return transferred;
+    }
+
+    [[nodiscard]] auto begin(vk::CommandPool const command_pool) const
+      -> vk::UniqueCommandBuffer {
       // Allocate a UniqueCommandBuffer which will free the underlying command
       // buffer from its owning pool on destruction.
       auto allocate_info = vk::CommandBufferAllocateInfo()
@@ -26,48 +393,81 @@ namespace framework {
       // All the current VulkanHPP functions for UniqueCommandBuffer allocation
       // return vectors.
       auto command_buffers = device.allocateCommandBuffersUnique(allocate_info);
-      command_buffer = std::move(command_buffers.front());
+      auto ret = std::move(command_buffers.front());
 
       // Start recording commands before returning.
       auto begin_info = vk::CommandBufferBeginInfo().setFlags(
         vk::CommandBufferUsageFlagBits::eOneTimeSubmit
       );
 
-      command_buffer->begin(begin_info);
+      ret->begin(begin_info);
+      return ret;
     }
 
-    [[nodiscard]] auto get_command_buffer() const -> vk::CommandBuffer {
-      return *command_buffer;
-    }
+    template <typename Barrier>
+    void record_transfer(Barrier barrier) const {
+      if (!owner_command_buffer) {
+        barrier.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+          .setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+        record_barrier(*command_buffer, barrier);
+        return;
+      }
 
-    void submit_and_wait() {
-      if (!command_buffer) return;
+      barrier.setSrcQueueFamilyIndex(src_family)
+        .setDstQueueFamilyIndex(dst_family);
 
-      // end recording and submit.
-      command_buffer->end();
-      auto const command_buffer_info =
-        vk::CommandBufferSubmitInfo{*command_buffer};
-      auto submit_info =
-        vk::SubmitInfo2KHR().setCommandBufferInfos(command_buffer_info);
+      // Release: the destination scope is ignored on the source queue.
+      auto release = barrier;
+      release.setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+        .setDstAccessMask(vk::AccessFlagBits2::eNone);
+      record_barrier(*command_buffer, release);
 
-      auto fence = device.createFenceUnique({});
-      queue.submit2(submit_info, *fence);
+      // Acquire: the source scope is covered by the semaphore wait.
+      auto acquire = barrier;
+      acquire.setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+        .setSrcAccessMask(vk::AccessFlagBits2::eNone);
+      record_barrier(*owner_command_buffer, acquire);
+    }
+
+    static void record_barrier(
+      vk::CommandBuffer const command_buffer,
+      vk::ImageMemoryBarrier2 const &barrier
+    ) {
+      auto dependency_info =
+        vk::DependencyInfo().setImageMemoryBarriers(barrier);
+      command_buffer.pipelineBarrier2(dependency_info);
+    }
+
+    static void record_barrier(
+      vk::CommandBuffer const command_buffer,
+      vk::BufferMemoryBarrier2 const &barrier
+    ) {
+      auto dependency_info =
+        vk::DependencyInfo().setBufferMemoryBarriers(barrier);
+      command_buffer.pipelineBarrier2(dependency_info);
+    }
 
+    void wait(vk::Fence const fence) const {
       // Wait for submit fence to be signaled.
       static constexpr auto timeout =
         static_cast<std::uint64_t>(std::chrono::nanoseconds(30s).count());
 
-      auto const result = device.waitForFences(*fence, vk::True, timeout);
+      auto const result = device.waitForFences(fence, vk::True, timeout);
       if (result != vk::Result::eSuccess)
         std::println(stderr, "Failed to submit Command Buffer");
-
-      // Free the command buffer.
-      command_buffer.reset();
     }
 
-  private:
     vk::Device device;
     vk::Queue queue;
+    vk::CommandPool command_pool;
     vk::UniqueCommandBuffer command_buffer;
+    StagingRing *staging{};
+
+    // Only used when transferring on a separate queue family.
+    vk::Queue owner_queue;
+    vk::CommandPool owner_command_pool;
+    std::uint32_t src_family{};
+    std::uint32_t dst_family{};
+    vk::UniqueCommandBuffer owner_command_buffer;
   };
 } // namespace framework
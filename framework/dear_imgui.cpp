@@ -3,9 +3,11 @@ module;
 #include <GLFW/glfw3.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
+#include <glm/glm.hpp>
 #include <glm/gtc/color_space.hpp>
 #include <glm/mat4x4.hpp>
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <imgui.h>
 
 export module framework:dear_imgui;
@@ -14,7 +16,9 @@ import :resource_buffering;
 
 namespace framework {
   struct DearImGuiCreateInfo {
+    // Null when rendering headless: display_size is used instead.
     GLFWwindow *window{};
+    glm::ivec2 display_size{};
     std::uint32_t api_version{};
     vk::Instance instance;
     vk::PhysicalDevice physical_device;
@@ -23,6 +27,7 @@ namespace framework {
     vk::Queue queue;
     vk::Format color_format{}; // single color attachment.
     vk::SampleCountFlagBits samples{};
+    std::size_t buffering{resource_buffering};
   };
 
   export class DearImGui {
@@ -43,9 +48,11 @@ namespace framework {
         create_info.api_version, load_vk_func, &instance
       );
 
-      if (!ImGui_ImplGlfw_InitForVulkan(create_info.window, true)) {
+      if (create_info.window != nullptr &&
+          !ImGui_ImplGlfw_InitForVulkan(create_info.window, true)) {
         throw std::runtime_error{"Failed to initialize Dear ImGui"};
       }
+      display_size = create_info.display_size;
 
       auto pipline_rendering_info =
         vk::PipelineRenderingCreateInfo()
@@ -62,7 +69,9 @@ namespace framework {
         .DescriptorPool = {},
         .RenderPass = {},
         .MinImageCount = 2,
-        .ImageCount = static_cast<std::uint32_t>(resource_buffering),
+        // Dear ImGui requires at least MinImageCount sets of frame buffers.
+        .ImageCount =
+          static_cast<std::uint32_t>(std::max(create_info.buffering, 2uz)),
         .MSAASamples = static_cast<VkSampleCountFlagBits>(create_info.samples),
         .PipelineCache = {},
         .Subpass = {},
@@ -97,7 +106,14 @@ namespace framework {
     void new_frame() {
       if (state == State::Begun) end_frame();
 
-      ImGui_ImplGlfw_NewFrame();
+      if (has_platform_backend()) {
+        ImGui_ImplGlfw_NewFrame();
+      } else {
+        // No window to query: feed the display size directly.
+        ImGui::GetIO().DisplaySize =
+          ImVec2{static_cast<float>(display_size.x),
+                 static_cast<float>(display_size.y)};
+      }
       ImGui_ImplVulkan_NewFrame();
       ImGui::NewFrame();
       state = State::Begun;
@@ -120,17 +136,23 @@ namespace framework {
   private:
     enum class State : std::int8_t { Ended, Begun };
 
+    [[nodiscard]] static auto has_platform_backend() -> bool {
+      return ImGui::GetIO().BackendPlatformUserData != nullptr;
+    }
+
+    // The device must be idle (or done with Dear ImGui's resources): the
+    // owner waits once at teardown rather than every resource on its own.
     struct Deleter {
-      void operator()(vk::Device device) const {
-        device.waitIdle();
+      void operator()(vk::Device /*device*/) const {
         ImGui_ImplVulkan_DestroyFontsTexture();
         ImGui_ImplVulkan_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
+        if (has_platform_backend()) ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
       }
     };
 
     State state{};
+    glm::ivec2 display_size{};
 
     Scoped<vk::Device, Deleter> device;
   };
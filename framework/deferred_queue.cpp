@@ -0,0 +1,88 @@
+module;
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+export module framework:deferred_queue;
+
+namespace framework {
+  /// Keeps resources replaced or dropped while the GPU may still use them,
+  /// and destroys them once the timeline value of the last submission using
+  /// them has been signalled: teardown and hot-swapping never wait on the
+  /// device. Holds anything movable (vma::Buffer, vma::Image, Texture,
+  /// ShaderProgram, vk::Unique* handles...). Not thread-safe.
+  export class DeferredQueue {
+  public:
+    /// Destroys resource once the next sealed value has retired: use for
+    /// resources used by the frame being recorded, or by any before it.
+    template <std::movable Type> void defer(Type resource) {
+      unsealed.push_back(make_holder(std::move(resource)));
+    }
+
+    /// Destroys resource once in_use_until has retired.
+    template <std::movable Type>
+    void defer(Type resource, std::uint64_t const in_use_until) {
+      entries.push_back(Entry{
+        .resource = make_holder(std::move(resource)),
+        .in_use_until = in_use_until,
+      });
+    }
+
+    /// Resources deferred since the last call are in use until value: call
+    /// with the value signalled by each frame's submission.
+    void seal(std::uint64_t const value) {
+      for (auto &resource : unsealed) {
+        entries.push_back(Entry{
+          .resource = std::move(resource),
+          .in_use_until = value,
+        });
+      }
+      unsealed.clear();
+    }
+
+    /// Destroys the resources no longer in use by any submission, given the
+    /// last completed timeline value.
+    void collect(std::uint64_t const completed) {
+      std::erase_if(entries, [completed](Entry const &entry) {
+        return entry.in_use_until <= completed;
+      });
+    }
+
+    /// Number of resources waiting to be destroyed.
+    [[nodiscard]] auto size() const -> std::size_t {
+      return entries.size() + unsealed.size();
+    }
+
+  private:
+    struct Holder {
+      Holder() = default;
+      Holder(Holder const &) = delete;
+      auto operator=(Holder const &) = delete;
+      virtual ~Holder() = default;
+    };
+
+    template <typename Type> struct TypedHolder : Holder {
+      explicit TypedHolder(Type t) : value(std::move(t)) {}
+
+      Type value;
+    };
+
+    struct Entry {
+      std::unique_ptr<Holder> resource;
+      std::uint64_t in_use_until{};
+    };
+
+    template <typename Type>
+    [[nodiscard]] static auto make_holder(Type resource)
+      -> std::unique_ptr<Holder> {
+      return std::make_unique<TypedHolder<Type>>(std::move(resource));
+    }
+
+    std::vector<Entry> entries;
+    std::vector<std::unique_ptr<Holder>> unsealed;
+  };
+} // namespace framework
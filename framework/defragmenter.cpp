@@ -0,0 +1,534 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <print>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+#include <vk_mem_alloc.h>
+
+export module framework:defragmenter;
+import :command_block;
+import :scoped;
+import :staging_ring;
+import :timeline;
+import :vma;
+
+using namespace std::chrono_literals;
+
+namespace framework {
+  struct DefragmenterCreateInfo {
+    vk::Device device;
+    VmaAllocator allocator;
+    // Copies are recorded into Command Buffers from command_pool and
+    // submitted on queue, tracked on staging's timeline.
+    vk::Queue queue;
+    vk::CommandPool command_pool;
+    StagingRing *staging;
+    // Bound on each pass: the most bytes / allocations moved per pass.
+    vk::DeviceSize max_bytes_per_pass{16 * 1024 * 1024};
+    std::uint32_t max_allocations_per_pass{64};
+  };
+
+  /// Result of one defragmentation pass.
+  export struct DefragmentationPass {
+    std::uint32_t allocations_moved{};
+    vk::DeviceSize bytes_moved{};
+    // Device memory released by the pass (blocks emptied by the moves).
+    vk::DeviceSize bytes_reclaimed{};
+  };
+
+  /// A sampled image the Defragmenter can move to new memory: implemented by
+  /// Texture, which tracks itself (see TextureCreateInfo::defragmenter).
+  export class RelocatableImage {
+  public:
+    [[nodiscard]] virtual auto get_image() const -> vma::RawImage const & = 0;
+
+    /// Points at new_image, a copy of the image bound to its allocation's
+    /// new memory. Returns the previous image and view, to destroy once the
+    /// device no longer uses them.
+    [[nodiscard]] virtual auto relocate(vk::Image new_image)
+      -> std::pair<vk::Image, vk::UniqueImageView> = 0;
+
+  protected:
+    RelocatableImage() = default;
+    RelocatableImage(RelocatableImage const &) = default;
+    RelocatableImage(RelocatableImage &&) = default;
+    auto operator=(RelocatableImage const &) -> RelocatableImage & = default;
+    auto operator=(RelocatableImage &&) -> RelocatableImage & = default;
+    ~RelocatableImage() = default;
+  };
+
+  export class Defragmenter;
+
+  export struct RawDefragmentTracking {
+    auto operator==(RawDefragmentTracking const &rhs) const -> bool = default;
+
+    Defragmenter *defragmenter{};
+    vma::Buffer *buffer{};
+  };
+
+  export struct DefragmentTrackingDeleter {
+    void operator()(RawDefragmentTracking const &tracking) const noexcept;
+  };
+
+  /// Keeps a Buffer tracked by a Defragmenter, untracks it on destruction.
+  export using DefragmentTracking =
+    Scoped<RawDefragmentTracking, DefragmentTrackingDeleter>;
+
+  /// Incrementally compacts the allocations of tracked Buffers and Textures
+  /// with VMA's defragmentation passes, a bounded amount per step(), without
+  /// blocking: a pass's copies run asynchronously, tracked resources are
+  /// then pointed at their copies (Texture views are recreated), and the
+  /// previous ones destroyed once frames using them have retired.
+  /// Host-mapped Buffers are never moved: their mapped pointers would go
+  /// stale. Descriptors written once must be rewritten when
+  /// get_generation() changes.
+  export class Defragmenter {
+  public:
+    using CreateInfo = DefragmenterCreateInfo;
+
+    explicit Defragmenter(CreateInfo const &create_info) :
+      create_info(create_info),
+      timeline(&create_info.staging->get_timeline()) {}
+
+    Defragmenter(Defragmenter const &) = delete;
+    auto operator=(Defragmenter const &) = delete;
+    Defragmenter(Defragmenter &&) = delete;
+    auto operator=(Defragmenter &&) = delete;
+
+    ~Defragmenter() {
+      finish_pass();
+      end_defragmentation();
+    }
+
+    /// Tracks buffer until the result is destroyed: declare it after the
+    /// buffer, which must stay at the same address meanwhile.
+    [[nodiscard]] auto track(vma::Buffer &buffer) -> DefragmentTracking {
+      auto const allocation = buffer.get().allocation;
+      if (allocation == nullptr) return {};
+      tracked[allocation] = Tracked{.buffer = &buffer};
+      return RawDefragmentTracking{.defragmenter = this, .buffer = &buffer};
+    }
+
+    /// Tracks image, or points its tracking at a new address (after image
+    /// has been moved), including in a pass in progress.
+    void track(RelocatableImage &image) {
+      auto const allocation = image.get_image().allocation;
+      if (allocation == nullptr) return;
+      tracked[allocation] = Tracked{.image = &image};
+      for (auto &move : moves) {
+        if (move.allocation == allocation) move.tracked.image = &image;
+      }
+    }
+
+    /// Call before destroying a tracked buffer or image. If a pass in
+    /// progress includes it, takes it over (leaving it empty) and destroys
+    /// it once the pass has ended, instead of waiting for the pass.
+    void untrack(vma::Buffer &buffer) {
+      if (release(buffer.get().allocation)) {
+        adopted_buffers.push_back(std::move(buffer));
+      }
+    }
+
+    void untrack(vma::Image &image) {
+      if (release(image.get().allocation)) {
+        adopted_images.push_back(std::move(image));
+      }
+    }
+
+    /// Advances defragmentation without blocking, call once per frame.
+    /// Returns the pass that completed during this call, if any.
+    auto step() -> std::optional<DefragmentationPass> {
+      switch (state) {
+        case State::Idle:
+          begin_pass();
+          return {};
+        case State::Copying:
+          if (!pending.is_complete()) return {};
+          relocate();
+          return {};
+        case State::Releasing:
+          if (!timeline->is_retired(release_after)) return {};
+          return end_pass();
+        default:
+          return {};
+      }
+    }
+
+    /// Incremented whenever tracked resources have been relocated.
+    [[nodiscard]] auto get_generation() const -> std::uint64_t {
+      return generation;
+    }
+
+  private:
+    enum class State : std::int8_t { Idle, Copying, Releasing };
+
+    struct Tracked {
+      vma::Buffer *buffer{};
+      RelocatableImage *image{};
+    };
+
+    struct Move {
+      VmaAllocation allocation{};
+      Tracked tracked;
+      vk::Buffer new_buffer;
+      vk::Image new_image;
+    };
+
+    // Handles replaced by relocate(), destroyed by end_pass().
+    struct Retired {
+      vk::Buffer buffer;
+      vk::Image image;
+      vk::UniqueImageView view;
+    };
+
+    void begin_pass() {
+      auto const allocator = create_info.allocator;
+      if (!context) {
+        auto info = VmaDefragmentationInfo{};
+        info.maxBytesPerPass = create_info.max_bytes_per_pass;
+        info.maxAllocationsPerPass = create_info.max_allocations_per_pass;
+        if (vmaBeginDefragmentation(allocator, &info, &context) !=
+            VK_SUCCESS) {
+          std::println(stderr, "Failed to begin defragmentation");
+          return;
+        }
+      }
+
+      pass_info = {};
+      auto const result =
+        vmaBeginDefragmentationPass(allocator, context, &pass_info);
+      // Nothing (left) to move.
+      if (result == VK_SUCCESS) {
+        end_defragmentation();
+        return;
+      }
+      if (result != VK_INCOMPLETE) {
+        std::println(stderr, "Failed to begin defragmentation pass");
+        end_defragmentation();
+        return;
+      }
+
+      auto command_block = CommandBlock{
+        create_info.device,
+        create_info.queue,
+        create_info.command_pool,
+        create_info.staging,
+      };
+      auto const command_buffer = command_block.get_command_buffer();
+
+      for (auto i = 0u; i < pass_info.moveCount; ++i) {
+        auto &move = pass_info.pMoves[i];
+        auto const it = tracked.find(move.srcAllocation);
+        // Only tracked resources can be pointed at their new memory, and
+        // host-mapped buffers are written through their old mapping.
+        if (it == tracked.end() ||
+            (it->second.buffer && it->second.buffer->get().mapped)) {
+          move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+          continue;
+        }
+
+        auto const &target = it->second;
+        if (target.buffer) {
+          moves.push_back(copy_buffer(command_buffer, *target.buffer, move));
+        } else {
+          moves.push_back(copy_image(command_buffer, *target.image, move));
+        }
+
+        auto info = VmaAllocationInfo{};
+        vmaGetAllocationInfo(allocator, move.srcAllocation, &info);
+        bytes_moved += info.size;
+      }
+
+      // Everything was ignored: nothing to copy.
+      if (moves.empty()) {
+        state = State::Releasing;
+        release_after = 0;
+        return;
+      }
+
+      // Buffer copies are read by later submissions after relocate().
+      auto const copied =
+        vk::MemoryBarrier2()
+          .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+          .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+          .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+          .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead);
+      command_buffer.pipelineBarrier2(
+        vk::DependencyInfo().setMemoryBarriers(copied)
+      );
+
+      pending = command_block.submit();
+      state = State::Copying;
+    }
+
+    [[nodiscard]] auto copy_buffer(
+      vk::CommandBuffer const command_buffer,
+      vma::Buffer &buffer,
+      VmaDefragmentationMove const &move
+    ) const -> Move {
+      auto const &raw = buffer.get();
+      auto const buffer_info =
+        vk::BufferCreateInfo().setSize(raw.size).setUsage(raw.usage);
+      auto const ret = create_info.device.createBuffer(buffer_info);
+      vmaBindBufferMemory(create_info.allocator, move.dstTmpAllocation, ret);
+
+      auto const region = vk::BufferCopy2().setSize(raw.size);
+      auto const copy_info = vk::CopyBufferInfo2()
+                               .setSrcBuffer(raw.buffer)
+                               .setDstBuffer(ret)
+                               .setRegions(region);
+      command_buffer.copyBuffer2(copy_info);
+
+      return Move{
+        .allocation = move.srcAllocation,
+        .tracked = {.buffer = &buffer},
+        .new_buffer = ret,
+      };
+    }
+
+    // Copies a sampled image, leaving both in ShaderReadOnlyOptimal: frames
+    // keep sampling the source until relocate().
+    [[nodiscard]] auto copy_image(
+      vk::CommandBuffer const command_buffer,
+      RelocatableImage &image,
+      VmaDefragmentationMove const &move
+    ) const -> Move {
+      auto const &raw = image.get_image();
+      auto const image_info =
+        vk::ImageCreateInfo()
+          .setImageType(vk::ImageType::e2D)
+          .setExtent({raw.extent.width, raw.extent.height, 1})
+          .setFormat(raw.format)
+          .setUsage(raw.usage)
+          .setArrayLayers(1)
+          .setMipLevels(raw.levels)
+          .setSamples(vk::SampleCountFlagBits::e1)
+          .setTiling(vk::ImageTiling::eOptimal)
+          .setInitialLayout(vk::ImageLayout::eUndefined);
+      auto const ret = create_info.device.createImage(image_info);
+      vmaBindImageMemory(create_info.allocator, move.dstTmpAllocation, ret);
+
+      auto const subresource_range =
+        vk::ImageSubresourceRange()
+          .setAspectMask(vk::ImageAspectFlagBits::eColor)
+          .setLayerCount(1)
+          .setLevelCount(raw.levels);
+      auto const read_only = vk::ImageLayout::eShaderReadOnlyOptimal;
+      auto const to_transfer = std::array{
+        vk::ImageMemoryBarrier2()
+          .setImage(raw.image)
+          .setSubresourceRange(subresource_range)
+          .setOldLayout(read_only)
+          .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+          // Only sampled: no writes to make available.
+          .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+          .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+          .setDstStageMask(vk::PipelineStageFlagBits2::eCopy)
+          .setDstAccessMask(vk::AccessFlagBits2::eTransferRead),
+        vk::ImageMemoryBarrier2()
+          .setImage(ret)
+          .setSubresourceRange(subresource_range)
+          .setOldLayout(vk::ImageLayout::eUndefined)
+          .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+          .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+          .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+          .setDstStageMask(vk::PipelineStageFlagBits2::eCopy)
+          .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite),
+      };
+      command_buffer.pipelineBarrier2(
+        vk::DependencyInfo().setImageMemoryBarriers(to_transfer)
+      );
+
+      auto regions = std::vector<vk::ImageCopy2>{};
+      for (auto level = 0u; level < raw.levels; ++level) {
+        auto const layers = vk::ImageSubresourceLayers()
+                              .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                              .setMipLevel(level)
+                              .setLayerCount(1);
+        regions.push_back(
+          vk::ImageCopy2()
+            .setSrcSubresource(layers)
+            .setDstSubresource(layers)
+            .setExtent({
+              std::max(raw.extent.width >> level, 1u),
+              std::max(raw.extent.height >> level, 1u),
+              1,
+            })
+        );
+      }
+      auto const copy_info =
+        vk::CopyImageInfo2()
+          .setSrcImage(raw.image)
+          .setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+          .setDstImage(ret)
+          .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+          .setRegions(regions);
+      command_buffer.copyImage2(copy_info);
+
+      auto to_read_only = to_transfer;
+      for (auto &barrier : to_read_only) {
+        barrier.setOldLayout(barrier.newLayout)
+          .setNewLayout(read_only)
+          .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+          .setSrcAccessMask(barrier.dstAccessMask)
+          .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+          .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead);
+      }
+      command_buffer.pipelineBarrier2(
+        vk::DependencyInfo().setImageMemoryBarriers(to_read_only)
+      );
+
+      return Move{
+        .allocation = move.srcAllocation,
+        .tracked = {.image = &image},
+        .new_image = ret,
+      };
+    }
+
+    // untracks allocation, returns whether the pass in progress includes it:
+    // it must then not be freed until the pass has ended. A move not
+    // relocated to yet is dropped, leaving it in place.
+    [[nodiscard]] auto release(VmaAllocation const allocation) -> bool {
+      if (tracked.erase(allocation) == 0 || state == State::Idle) {
+        return false;
+      }
+      auto pass_moves = std::span{pass_info.pMoves, pass_info.moveCount};
+      auto const pass_move =
+        std::ranges::find(pass_moves, allocation, [](auto const &move) {
+          return move.srcAllocation;
+        });
+      if (pass_move == pass_moves.end()) return false;
+
+      auto const move = std::ranges::find(moves, allocation, &Move::allocation);
+      if (state == State::Copying && move != moves.end()) {
+        pass_move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        // The copy may still be running: destroyed with the pass.
+        retired.push_back(
+          Retired{.buffer = move->new_buffer, .image = move->new_image}
+        );
+        auto info = VmaAllocationInfo{};
+        vmaGetAllocationInfo(create_info.allocator, allocation, &info);
+        bytes_moved -= info.size;
+        moves.erase(move);
+      }
+      return true;
+    }
+
+    // points tracked resources at their copies, the previous handles are
+    // released once the frames submitted until now have retired.
+    void relocate() {
+      for (auto const &move : moves) {
+        if (auto *buffer = move.tracked.buffer) {
+          auto &raw = buffer->get();
+          retired.push_back(Retired{.buffer = raw.buffer});
+          raw.buffer = move.new_buffer;
+        } else {
+          auto [image, view] = move.tracked.image->relocate(move.new_image);
+          retired.push_back(Retired{.image = image, .view = std::move(view)});
+        }
+      }
+      ++generation;
+
+      pending = {};
+      release_after = timeline->submitted_value();
+      state = State::Releasing;
+    }
+
+    auto end_pass() -> DefragmentationPass {
+      for (auto &handles : retired) {
+        // Views before the images they were created from.
+        handles.view.reset();
+        if (handles.buffer) create_info.device.destroyBuffer(handles.buffer);
+        if (handles.image) create_info.device.destroyImage(handles.image);
+      }
+      retired.clear();
+
+      auto const allocator = create_info.allocator;
+      auto const blocks_before = get_block_bytes();
+      auto const result =
+        vmaEndDefragmentationPass(allocator, context, &pass_info);
+      // Freed only now that their allocations are out of the pass.
+      adopted_buffers.clear();
+      adopted_images.clear();
+
+      auto const ret = DefragmentationPass{
+        .allocations_moved = static_cast<std::uint32_t>(moves.size()),
+        .bytes_moved = bytes_moved,
+        .bytes_reclaimed = blocks_before - get_block_bytes(),
+      };
+      moves.clear();
+      bytes_moved = 0;
+      state = State::Idle;
+
+      if (result != VK_INCOMPLETE) end_defragmentation();
+      return ret;
+    }
+
+    // completes a pass in progress, blocking.
+    void finish_pass() {
+      if (state == State::Idle) return;
+      if (state == State::Copying) {
+        if (!pending.get_ticket().wait(30s)) {
+          std::println(stderr, "Failed to wait for defragmentation copies");
+        }
+        relocate();
+      }
+      static constexpr auto timeout_v =
+        static_cast<std::uint64_t>(std::chrono::nanoseconds{30s}.count());
+      if (!timeline->wait(release_after, timeout_v)) {
+        std::println(stderr, "Failed to wait for Render Timeline");
+      }
+      std::ignore = end_pass();
+    }
+
+    void end_defragmentation() {
+      if (!context) return;
+      auto stats = VmaDefragmentationStats{};
+      vmaEndDefragmentation(create_info.allocator, context, &stats);
+      context = {};
+    }
+
+    [[nodiscard]] auto get_block_bytes() const -> vk::DeviceSize {
+      VkPhysicalDeviceMemoryProperties const *properties{};
+      vmaGetMemoryProperties(create_info.allocator, &properties);
+      auto budgets = std::vector<VmaBudget>(properties->memoryHeapCount);
+      vmaGetHeapBudgets(create_info.allocator, budgets.data());
+
+      auto ret = vk::DeviceSize{};
+      for (auto const &budget : budgets) ret += budget.statistics.blockBytes;
+      return ret;
+    }
+
+    CreateInfo create_info;
+    Timeline *timeline{};
+    std::unordered_map<VmaAllocation, Tracked> tracked;
+
+    State state{State::Idle};
+    VmaDefragmentationContext context{};
+    VmaDefragmentationPassMoveInfo pass_info{};
+    std::vector<Move> moves;
+    vk::DeviceSize bytes_moved{};
+    PendingSubmission pending;
+    std::vector<Retired> retired;
+    // Tracked resources destroyed during the pass (see untrack()).
+    std::vector<vma::Buffer> adopted_buffers;
+    std::vector<vma::Image> adopted_images;
+    std::uint64_t release_after{};
+    std::uint64_t generation{};
+  };
+
+  void DefragmentTrackingDeleter::operator()(
+    RawDefragmentTracking const &tracking
+  ) const noexcept {
+    tracking.defragmenter->untrack(*tracking.buffer);
+  }
+} // namespace framework
@@ -2,20 +2,31 @@ module;
 
 #include <vulkan/vulkan.hpp>
 #include <cstdint>
+#include <utility>
 #include <vk_mem_alloc.h>
 
 export module framework:descriptor_buffer;
+import :deferred_queue;
 import :resource_buffering;
 import :vma;
 
 namespace framework {
   export class DescriptorBuffer {
   public:
+    /// Buffers outgrown by write_at() are handed to deferred (if not null)
+    /// instead of being destroyed while a frame may still read them.
     explicit DescriptorBuffer(
       VmaAllocator allocator,
       std::uint32_t const queue_family,
-      vk::BufferUsageFlags const usage
-    ) : allocator(allocator), queue_family(queue_family), usage(usage) {
+      vk::BufferUsageFlags const usage,
+      std::size_t const buffering,
+      DeferredQueue *deferred = nullptr
+    ) :
+      allocator(allocator),
+      queue_family(queue_family),
+      usage(usage),
+      deferred(deferred),
+      buffers(buffering) {
       // Ensure buffers are created and can be bound after returning
       for (auto &buffer : buffers) {
         write_to(buffer, {});
@@ -45,7 +56,7 @@ namespace framework {
       vk::DeviceSize size{};
     };
 
-    void write_to(Buffer &out, std::span<std::byte const> bytes) const {
+    void write_to(Buffer &out, std::span<std::byte const> bytes) {
       static constexpr auto blank_byte = std::array{std::byte{}};
       // Fallback to an empty byte if bytes is empty
       if (bytes.empty()) {
@@ -61,9 +72,11 @@ namespace framework {
           .queue_family = queue_family,
         };
 
-        out.buffer = vma::create_buffer(
-          buffer_info, vma::BufferMemoryType::Host, out.size
+        auto old = std::exchange(
+          out.buffer,
+          vma::create_buffer(buffer_info, vma::BufferMemoryType::Host, out.size)
         );
+        if (deferred != nullptr) deferred->defer(std::move(old));
       }
       std::memcpy(out.buffer.get().mapped, bytes.data(), bytes.size());
     };
@@ -71,6 +84,7 @@ namespace framework {
     VmaAllocator allocator{};
     std::uint32_t queue_family{};
     vk::BufferUsageFlags usage;
+    DeferredQueue *deferred{};
     Buffered<Buffer> buffers{};
   };
 } // namespace framework
@@ -0,0 +1,186 @@
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string_view>
+#include <vector>
+
+export module framework:frame_stats;
+
+namespace fs = std::filesystem;
+
+namespace framework {
+  using Seconds = std::chrono::duration<double>;
+
+  /// CPU timings of one frame of a Renderer::run loop.
+  export struct FrameSample {
+    // Whole frame, from the start of the loop iteration to after present.
+    Seconds cpu_frame{};
+    // Waiting for the virtual frame's previous submission to retire.
+    Seconds wait{};
+    // Acquiring the render target (Swapchain image).
+    Seconds acquire{};
+    // Submitting the command buffer and presenting.
+    Seconds submit{};
+  };
+
+  /// Distribution of one FrameSample member, in milliseconds.
+  export struct FrameTimeSummary {
+    double mean{};
+    double p50{};
+    double p90{};
+    double p99{};
+    double max{};
+  };
+
+  /// Frame throughput and latency accumulated over a Renderer::run loop.
+  export struct FrameStats {
+    std::uint64_t frames{};
+    Seconds elapsed{};
+
+    // Time from the start of a frame on the CPU until it was observed as
+    // retired by the GPU (an upper bound when it retired early).
+    Seconds total_latency{};
+    std::uint64_t latency_samples{};
+    // Average time from acquiring a Swapchain image until it was queued for
+    // present (0 when headless).
+    Seconds present_latency{};
+
+    // Frames rendered before samples were recorded (and elapsed started).
+    std::uint64_t warmup_frames{};
+    std::vector<FrameSample> samples;
+
+    void add_latency(Seconds const latency) {
+      total_latency += latency;
+      ++latency_samples;
+    }
+
+    [[nodiscard]] auto average_frame_time() const -> Seconds {
+      if (frames == 0) return {};
+      return elapsed / static_cast<double>(frames);
+    }
+
+    [[nodiscard]] auto frames_per_second() const -> double {
+      if (elapsed <= Seconds{}) return 0.0;
+      return static_cast<double>(frames) / elapsed.count();
+    }
+
+    [[nodiscard]] auto average_latency() const -> Seconds {
+      if (latency_samples == 0) return {};
+      return total_latency / static_cast<double>(latency_samples);
+    }
+
+    /// Nearest-rank percentiles of member over all samples.
+    [[nodiscard]] auto summarize(Seconds FrameSample::*member) const
+      -> FrameTimeSummary {
+      if (samples.empty()) return {};
+
+      auto values = std::vector<double>{};
+      values.reserve(samples.size());
+      for (auto const &sample : samples) {
+        values.push_back((sample.*member).count() * 1000.0);
+      }
+      std::ranges::sort(values);
+
+      auto const percentile = [&values](double const p) {
+        auto const rank = static_cast<std::size_t>(
+          p * static_cast<double>(values.size() - 1) + 0.5
+        );
+        return values.at(rank);
+      };
+
+      auto sum = 0.0;
+      for (auto const value : values) sum += value;
+
+      return FrameTimeSummary{
+        .mean = sum / static_cast<double>(values.size()),
+        .p50 = percentile(0.5),
+        .p90 = percentile(0.9),
+        .p99 = percentile(0.99),
+        .max = values.back(),
+      };
+    }
+
+    void print(std::size_t const frames_in_flight) const {
+      std::println(
+        "[lvk] {} frame(s) in flight: {} frames, {:.3f} ms/frame ({:.1f} "
+        "fps), latency {:.3f} ms, acquire to present {:.3f} ms",
+        frames_in_flight,
+        frames,
+        average_frame_time().count() * 1000.0,
+        frames_per_second(),
+        average_latency().count() * 1000.0,
+        present_latency.count() * 1000.0
+      );
+
+      if (samples.empty()) return;
+      auto const cpu_frame = summarize(&FrameSample::cpu_frame);
+      std::println(
+        "[lvk] cpu frame ms: p50 {:.3f}, p90 {:.3f}, p99 {:.3f}, max {:.3f}",
+        cpu_frame.p50,
+        cpu_frame.p90,
+        cpu_frame.p99,
+        cpu_frame.max
+      );
+    }
+
+    /// Writes throughput and the distribution of every sampled timing as
+    /// JSON, for comparing runs on the same host.
+    auto write_json(
+      fs::path const &path,
+      std::size_t const frames_in_flight,
+      std::string_view const device_name
+    ) const -> bool {
+      auto file = std::ofstream{path};
+      if (!file.is_open()) {
+        std::println(
+          stderr, "Failed to open file: '{}'", path.generic_string()
+        );
+        return false;
+      }
+
+      auto const to_json = [this](Seconds FrameSample::*member) {
+        auto const summary = summarize(member);
+        return std::format(
+          R"({{"mean": {:.4f}, "p50": {:.4f}, "p90": {:.4f}, )"
+          R"("p99": {:.4f}, "max": {:.4f}}})",
+          summary.mean,
+          summary.p50,
+          summary.p90,
+          summary.p99,
+          summary.max
+        );
+      };
+
+      file << "{\n"
+           << std::format("  \"device\": \"{}\",\n", device_name)
+           << std::format("  \"frames_in_flight\": {},\n", frames_in_flight)
+           << std::format("  \"warmup_frames\": {},\n", warmup_frames)
+           << std::format("  \"frames\": {},\n", frames)
+           << std::format("  \"elapsed_s\": {:.6f},\n", elapsed.count())
+           << std::format("  \"fps\": {:.3f},\n", frames_per_second())
+           << std::format(
+                "  \"latency_ms\": {:.4f},\n", average_latency().count() * 1e3
+              )
+           << std::format(
+                "  \"cpu_frame_ms\": {},\n", to_json(&FrameSample::cpu_frame)
+              )
+           << std::format("  \"wait_ms\": {},\n", to_json(&FrameSample::wait))
+           << std::format(
+                "  \"acquire_ms\": {},\n", to_json(&FrameSample::acquire)
+              )
+           << std::format(
+                "  \"submit_ms\": {}\n", to_json(&FrameSample::submit)
+              )
+           << "}\n";
+
+      std::println("[lvk] Wrote frame stats to '{}'", path.generic_string());
+      return true;
+    }
+  };
+} // namespace framework
@@ -2,6 +2,7 @@ module;
 
 #include <vulkan/vulkan.hpp>
 #include <algorithm>
+#include <optional>
 #include <ranges>
 
 export module framework:gpu;
@@ -14,8 +15,12 @@ namespace framework {
     vk::PhysicalDeviceProperties properties;
     vk::PhysicalDeviceFeatures features;
     uint32_t queue_family{};
+    // Dedicated transfer-only family (usually backed by DMA engines), if any.
+    std::optional<std::uint32_t> transfer_queue_family;
   };
 
+  /// Pass a null surface to select a GPU for headless rendering, without
+  /// Swapchain or presentation support.
   export [[nodiscard]] auto get_suitable_gpu(
     vk::Instance instance, vk::SurfaceKHR surface
   ) -> Gpu {
@@ -44,11 +49,28 @@ namespace framework {
       return false;
     };
 
+    auto const set_transfer_queue_family = [](Gpu &out_gpu) {
+      // Graphics and compute families implicitly support transfers: only
+      // families that can't do either are dedicated to transfers.
+      static constexpr auto excluded_v =
+        vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute;
+      for (auto const [index, family] :
+           std::views::enumerate(out_gpu.device.getQueueFamilyProperties())) {
+        if ((family.queueFlags & vk::QueueFlagBits::eTransfer) &&
+            !(family.queueFlags & excluded_v)) {
+          out_gpu.transfer_queue_family = static_cast<std::uint32_t>(index);
+          return;
+        }
+      }
+    };
+
     auto const can_present = [surface](Gpu const &gpu) {
       return gpu.device.getSurfaceSupportKHR(gpu.queue_family, surface) ==
         vk::True;
     };
 
+    auto const headless = !surface;
+
     std::optional<Gpu> fallback;
 
     for (auto const &device : instance.enumeratePhysicalDevices()) {
@@ -59,9 +81,10 @@ namespace framework {
       };
 
       if (gpu.properties.apiVersion < vk_version) continue;
-      if (!supports_swapchain(gpu)) continue;
+      if (!headless && !supports_swapchain(gpu)) continue;
       if (!set_queue_family(gpu)) continue;
-      if (!can_present(gpu)) continue;
+      if (!headless && !can_present(gpu)) continue;
+      set_transfer_queue_family(gpu);
 
       if (gpu.properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) {
         return gpu;
@@ -0,0 +1,265 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <imgui.h>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module framework:gpu_profiler;
+import :gpu;
+import :resource_buffering;
+
+namespace framework {
+  struct GpuProfilerCreateInfo {
+    vk::Device device;
+    Gpu const &gpu;
+    std::size_t buffering{resource_buffering};
+    // Maximum number of scopes recorded per frame.
+    std::uint32_t max_scopes{64};
+  };
+
+  /// Measures GPU time of named scopes with timestamp queries.
+  /// Each virtual frame has its own query pool, read back only after that
+  /// frame has retired, so collecting results never stalls.
+  export class GpuProfiler {
+  public:
+    using CreateInfo = GpuProfilerCreateInfo;
+
+    /// Number of frames each rolling average spans.
+    static constexpr std::size_t average_frames_v{64};
+
+    struct Result {
+      std::string name;
+      double last_ms{};
+      double average_ms{};
+    };
+
+    /// Writes a timestamp on construction and destruction.
+    class Scope {
+    public:
+      Scope(Scope const &) = delete;
+      auto operator=(Scope const &) = delete;
+      Scope(Scope &&) = delete;
+      auto operator=(Scope &&) = delete;
+
+      Scope(
+        vk::CommandBuffer const command_buffer,
+        vk::QueryPool const pool,
+        std::optional<std::uint32_t> const begin_query
+      ) :
+        command_buffer(command_buffer), pool(pool), begin_query(begin_query) {
+        if (!begin_query) return;
+        command_buffer.writeTimestamp2(
+          vk::PipelineStageFlagBits2::eAllCommands, pool, *begin_query
+        );
+      }
+
+      ~Scope() {
+        if (!begin_query) return;
+        command_buffer.writeTimestamp2(
+          vk::PipelineStageFlagBits2::eAllCommands, pool, *begin_query + 1
+        );
+      }
+
+    private:
+      vk::CommandBuffer command_buffer;
+      vk::QueryPool pool;
+      std::optional<std::uint32_t> begin_query;
+    };
+
+    explicit GpuProfiler(CreateInfo const &create_info) :
+      device(create_info.device),
+      max_scopes(create_info.max_scopes),
+      frames(create_info.buffering) {
+      auto const &limits = create_info.gpu.properties.limits;
+      auto const families = create_info.gpu.device.getQueueFamilyProperties();
+      auto const valid_bits =
+        families.at(create_info.gpu.queue_family).timestampValidBits;
+
+      if (valid_bits == 0 || limits.timestampComputeAndGraphics == vk::False) {
+        std::println("[lvk] GPU timestamps not supported, profiler disabled");
+        return;
+      }
+
+      timestamp_period_ms = limits.timestampPeriod / 1'000'000.0;
+      timestamp_mask = valid_bits >= 64 ? ~std::uint64_t{}
+                                        : (std::uint64_t{1} << valid_bits) - 1;
+
+      // Two queries (begin and end) per scope.
+      auto const pool_info = vk::QueryPoolCreateInfo()
+                               .setQueryType(vk::QueryType::eTimestamp)
+                               .setQueryCount(2 * max_scopes);
+      for (auto &frame : frames) {
+        frame.pool = device.createQueryPoolUnique(pool_info);
+      }
+    }
+
+    [[nodiscard]] auto is_enabled() const -> bool {
+      return timestamp_period_ms > 0.0;
+    }
+
+    /// Collects the results last recorded for the virtual frame at
+    /// frame_index (which must have retired), and resets its queries.
+    /// Must be recorded before any scope of the frame.
+    void begin_frame(
+      vk::CommandBuffer const command_buffer, std::size_t const frame_index
+    ) {
+      if (!is_enabled()) return;
+
+      auto lock = std::scoped_lock{mutex};
+      current = &frames.at(frame_index);
+      collect(*current);
+
+      command_buffer.resetQueryPool(*current->pool, 0, 2 * max_scopes);
+    }
+
+    /// Starts a named scope, ended when the returned Scope is destroyed.
+    /// name must outlive the frame (eg a string literal). Safe to call from
+    /// worker threads recording secondary command buffers.
+    [[nodiscard]] auto scope(
+      vk::CommandBuffer const command_buffer, std::string_view const name
+    ) -> Scope {
+      if (!is_enabled()) return Scope{command_buffer, {}, {}};
+
+      auto lock = std::scoped_lock{mutex};
+      if (current == nullptr || current->scopes.size() >= max_scopes) {
+        return Scope{command_buffer, {}, {}};
+      }
+
+      auto const begin_query =
+        static_cast<std::uint32_t>(2 * current->scopes.size());
+      current->scopes.push_back(name);
+      return Scope{command_buffer, *current->pool, begin_query};
+    }
+
+    /// Results in order of first appearance.
+    [[nodiscard]] auto get_results() const -> std::span<Result const> {
+      return results;
+    }
+
+    void draw_overlay() const {
+      ImGui::SetNextWindowSize({300.0f, 0.0f}, ImGuiCond_Once);
+      if (ImGui::Begin("GPU Profiler")) {
+        if (!is_enabled()) {
+          ImGui::TextUnformatted("Timestamps not supported");
+        } else if (ImGui::BeginTable("scopes", 3)) {
+          ImGui::TableSetupColumn("scope");
+          ImGui::TableSetupColumn("last (ms)");
+          ImGui::TableSetupColumn("avg (ms)");
+          ImGui::TableHeadersRow();
+
+          for (auto const &result : results) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(result.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", result.last_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", result.average_ms);
+          }
+
+          ImGui::EndTable();
+        }
+      }
+      ImGui::End();
+    }
+
+  private:
+    struct Frame {
+      vk::UniqueQueryPool pool;
+      // Names of the scopes recorded, scope i uses queries 2i and 2i+1.
+      std::vector<std::string_view> scopes;
+    };
+
+    struct Samples {
+      std::array<double, average_frames_v> values{};
+      std::size_t count{};
+      std::size_t next{};
+      double sum{};
+
+      void push(double const value) {
+        sum += value - values.at(next);
+        values.at(next) = value;
+        next = (next + 1) % values.size();
+        count = std::min(count + 1, values.size());
+      }
+
+      [[nodiscard]] auto average() const -> double {
+        return count == 0 ? 0.0 : sum / static_cast<double>(count);
+      }
+    };
+
+    void collect(Frame &frame) {
+      if (frame.scopes.empty()) return;
+
+      auto const query_count =
+        static_cast<std::uint32_t>(2 * frame.scopes.size());
+      timestamps.resize(query_count);
+
+      auto const result = device.getQueryPoolResults(
+        *frame.pool,
+        0,
+        query_count,
+        std::span{timestamps}.size_bytes(),
+        timestamps.data(),
+        sizeof(std::uint64_t),
+        vk::QueryResultFlagBits::e64
+      );
+
+      if (result == vk::Result::eSuccess) {
+        for (auto const [index, name] : std::views::enumerate(frame.scopes)) {
+          auto const query = 2 * static_cast<std::size_t>(index);
+          auto const begin = timestamps.at(query) & timestamp_mask;
+          auto const end = timestamps.at(query + 1) & timestamp_mask;
+          auto const ticks = (end - begin) & timestamp_mask;
+          add_sample(name, static_cast<double>(ticks) * timestamp_period_ms);
+        }
+      }
+
+      frame.scopes.clear();
+    }
+
+    void add_sample(std::string_view const name, double const ms) {
+      auto const is_match = [name](Result const &result) {
+        return result.name == name;
+      };
+
+      auto const it = std::ranges::find_if(results, is_match);
+      auto const index =
+        static_cast<std::size_t>(std::distance(results.begin(), it));
+      if (it == results.end()) {
+        results.push_back(Result{.name = std::string{name}});
+        samples.emplace_back();
+      }
+
+      auto &sample = samples.at(index);
+      sample.push(ms);
+      results.at(index).last_ms = ms;
+      results.at(index).average_ms = sample.average();
+    }
+
+    vk::Device device;
+    std::uint32_t max_scopes{};
+    // 0 when timestamps are not supported.
+    double timestamp_period_ms{};
+    std::uint64_t timestamp_mask{};
+
+    std::mutex mutex;
+    Buffered<Frame> frames;
+    Frame *current{};
+
+    std::vector<std::uint64_t> timestamps;
+    std::vector<Result> results;
+    std::vector<Samples> samples;
+  };
+} // namespace framework
@@ -0,0 +1,1140 @@
+module;
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+export module framework:image_decode;
+
+namespace {
+  constexpr auto png_signature_v = std::array<std::uint8_t, 8>{
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+  };
+  constexpr auto qoi_magic_v = std::string_view{"qoif"};
+  constexpr auto qoi_header_size_v = 14uz;
+  // SOI, then the first segment's marker.
+  constexpr auto jpeg_signature_v =
+    std::array<std::uint8_t, 3>{0xff, 0xd8, 0xff};
+
+  [[nodiscard]] auto read_be16(std::span<std::byte const> bytes)
+    -> std::uint32_t {
+    return (std::to_integer<std::uint32_t>(bytes[0]) << 8) |
+      std::to_integer<std::uint32_t>(bytes[1]);
+  }
+
+  [[nodiscard]] auto read_be32(std::span<std::byte const> bytes)
+    -> std::uint32_t {
+    auto ret = std::uint32_t{};
+    for (auto i = 0uz; i < 4; ++i) {
+      ret = (ret << 8) | std::to_integer<std::uint32_t>(bytes[i]);
+    }
+    return ret;
+  }
+
+  // CRC-32 (ISO 3309) of PNG chunks, one table entry per byte value.
+  constexpr auto crc_table_v = [] {
+    auto ret = std::array<std::uint32_t, 256>{};
+    for (auto n = 0u; n < ret.size(); ++n) {
+      auto c = n;
+      for (auto k = 0; k < 8; ++k) {
+        c = (c & 1) != 0 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      ret.at(n) = c;
+    }
+    return ret;
+  }();
+
+  [[nodiscard]] auto crc32(std::span<std::byte const> bytes) -> std::uint32_t {
+    auto ret = 0xffffffffu;
+    for (auto const byte : bytes) {
+      auto const index = (ret ^ std::to_integer<std::uint32_t>(byte)) & 0xff;
+      ret = crc_table_v.at(index) ^ (ret >> 8);
+    }
+    return ret ^ 0xffffffffu;
+  }
+
+  // Checksum of zlib streams (RFC 1950).
+  [[nodiscard]] auto adler32(std::span<std::byte const> bytes)
+    -> std::uint32_t {
+    static constexpr auto modulo_v = 65521u;
+    // Largest run of bytes before the sums can overflow 32 bits.
+    static constexpr auto run_v = 5552uz;
+    auto a = 1u;
+    auto b = 0u;
+    while (!bytes.empty()) {
+      auto const run = bytes.first(std::min(bytes.size(), run_v));
+      for (auto const byte : run) {
+        a += std::to_integer<std::uint32_t>(byte);
+        b += a;
+      }
+      a %= modulo_v;
+      b %= modulo_v;
+      bytes = bytes.subspan(run.size());
+    }
+    return (b << 16) | a;
+  }
+
+  [[nodiscard]] auto starts_with(
+    std::span<std::byte const> bytes, std::span<std::uint8_t const> prefix
+  ) -> bool {
+    return bytes.size() >= prefix.size() &&
+      std::memcmp(bytes.data(), prefix.data(), prefix.size()) == 0;
+  }
+
+  [[nodiscard]] auto is_qoi(std::span<std::byte const> bytes) -> bool {
+    return bytes.size() >= qoi_header_size_v &&
+      std::memcmp(bytes.data(), qoi_magic_v.data(), qoi_magic_v.size()) == 0;
+  }
+
+  // DEFLATE (RFC 1951) decoder, after zlib's puff.
+  class Inflater {
+  public:
+    explicit Inflater(
+      std::span<std::byte const> input, std::span<std::byte> output
+    ) :
+      input(input),
+      output(output) {}
+
+    // Returns the number of bytes written.
+    auto inflate() -> std::size_t {
+      auto last = false;
+      while (!last) {
+        last = bits(1) == 1;
+        switch (bits(2)) {
+          case 0:
+            stored();
+            break;
+          case 1:
+            fixed();
+            break;
+          case 2:
+            dynamic();
+            break;
+          default:
+            fail();
+        }
+      }
+      return out_pos;
+    }
+
+  private:
+    static constexpr auto max_bits_v = 15uz;
+    static constexpr auto max_literals_v = 288uz;
+    static constexpr auto max_distances_v = 30uz;
+
+    struct Huffman {
+      std::array<std::uint16_t, max_bits_v + 1> counts{};
+      std::array<std::uint16_t, max_literals_v> symbols{};
+
+      explicit Huffman(std::span<std::uint8_t const> lengths) {
+        for (auto const length : lengths) ++counts.at(length);
+        counts[0] = 0;
+
+        auto offsets = std::array<std::uint16_t, max_bits_v + 1>{};
+        for (auto len = 1uz; len < max_bits_v; ++len) {
+          offsets.at(len + 1) =
+            static_cast<std::uint16_t>(offsets.at(len) + counts.at(len));
+        }
+        for (auto symbol = 0uz; symbol < lengths.size(); ++symbol) {
+          if (lengths[symbol] == 0) continue;
+          symbols.at(offsets.at(lengths[symbol])++) =
+            static_cast<std::uint16_t>(symbol);
+        }
+      }
+    };
+
+    [[noreturn]] static void fail() {
+      throw std::runtime_error{"Invalid deflate stream"};
+    }
+
+    auto bits(std::uint32_t const count) -> std::uint32_t {
+      while (bit_count < count) {
+        if (in_pos >= input.size()) fail();
+        bit_buffer |= std::to_integer<std::uint32_t>(input[in_pos++])
+          << bit_count;
+        bit_count += 8;
+      }
+      auto const ret = bit_buffer & ((1u << count) - 1);
+      bit_buffer >>= count;
+      bit_count -= count;
+      return ret;
+    }
+
+    auto decode(Huffman const &huffman) -> std::uint32_t {
+      auto code = 0u;
+      auto first = 0u;
+      auto index = 0u;
+      for (auto len = 1uz; len <= max_bits_v; ++len) {
+        code |= bits(1);
+        auto const count = std::uint32_t{huffman.counts.at(len)};
+        if (code - first < count) {
+          return huffman.symbols.at(index + code - first);
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+      }
+      fail();
+    }
+
+    void put(std::byte const value) {
+      if (out_pos >= output.size()) fail();
+      output[out_pos++] = value;
+    }
+
+    void stored() {
+      bit_buffer = 0;
+      bit_count = 0;
+      if (in_pos + 4 > input.size()) fail();
+      auto const length = std::to_integer<std::uint32_t>(input[in_pos]) |
+        (std::to_integer<std::uint32_t>(input[in_pos + 1]) << 8);
+      in_pos += 4;
+      if (in_pos + length > input.size()) fail();
+      if (out_pos + length > output.size()) fail();
+      std::memcpy(output.data() + out_pos, input.data() + in_pos, length);
+      in_pos += length;
+      out_pos += length;
+    }
+
+    void codes(Huffman const &literals, Huffman const &distances) {
+      static constexpr auto length_base_v = std::array<std::uint16_t, 29>{
+        3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+      };
+      static constexpr auto length_extra_v = std::array<std::uint8_t, 29>{
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+        2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+      };
+      static constexpr auto distance_base_v = std::array<std::uint16_t, 30>{
+        1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+        33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+        1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577
+      };
+      static constexpr auto distance_extra_v = std::array<std::uint8_t, 30>{
+        0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+      };
+
+      while (true) {
+        auto const symbol = decode(literals);
+        if (symbol < 256) {
+          put(static_cast<std::byte>(symbol));
+          continue;
+        }
+        if (symbol == 256) return;
+
+        auto const length_index = symbol - 257;
+        if (length_index >= length_base_v.size()) fail();
+        auto const length = length_base_v.at(length_index) +
+          bits(length_extra_v.at(length_index));
+
+        auto const distance_index = decode(distances);
+        if (distance_index >= distance_base_v.size()) fail();
+        auto const distance = distance_base_v.at(distance_index) +
+          bits(distance_extra_v.at(distance_index));
+        if (distance > out_pos) fail();
+
+        // Byte by byte: the copy may overlap what it writes.
+        for (auto i = 0u; i < length; ++i) put(output[out_pos - distance]);
+      }
+    }
+
+    void fixed() {
+      static auto const tables = [] {
+        auto lengths = std::array<std::uint8_t, max_literals_v>{};
+        for (auto i = 0uz; i < lengths.size(); ++i) {
+          lengths.at(i) = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        }
+        auto distances = std::array<std::uint8_t, max_distances_v>{};
+        distances.fill(5);
+        return std::pair{Huffman{lengths}, Huffman{distances}};
+      }();
+      codes(tables.first, tables.second);
+    }
+
+    void dynamic() {
+      static constexpr auto order_v = std::array<std::uint8_t, 19>{
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+      };
+
+      auto const literal_count = bits(5) + 257;
+      auto const distance_count = bits(5) + 1;
+      auto const code_count = bits(4) + 4;
+      if (literal_count > 286 || distance_count > max_distances_v) fail();
+
+      auto code_lengths = std::array<std::uint8_t, 19>{};
+      for (auto i = 0u; i < code_count; ++i) {
+        code_lengths.at(order_v.at(i)) = static_cast<std::uint8_t>(bits(3));
+      }
+      auto const code_huffman = Huffman{code_lengths};
+
+      auto lengths =
+        std::array<std::uint8_t, max_literals_v + max_distances_v>{};
+      auto const total = literal_count + distance_count;
+      for (auto i = 0u; i < total;) {
+        auto const symbol = decode(code_huffman);
+        if (symbol < 16) {
+          lengths.at(i++) = static_cast<std::uint8_t>(symbol);
+          continue;
+        }
+
+        auto value = std::uint8_t{};
+        auto repeat = 0u;
+        if (symbol == 16) {
+          if (i == 0) fail();
+          value = lengths.at(i - 1);
+          repeat = 3 + bits(2);
+        } else if (symbol == 17) {
+          repeat = 3 + bits(3);
+        } else {
+          repeat = 11 + bits(7);
+        }
+        if (i + repeat > total) fail();
+        while (repeat-- > 0) lengths.at(i++) = value;
+      }
+
+      auto const all = std::span{lengths};
+      codes(
+        Huffman{all.first(literal_count)},
+        Huffman{all.subspan(literal_count, distance_count)}
+      );
+    }
+
+    std::span<std::byte const> input;
+    std::span<std::byte> output;
+    std::size_t in_pos{};
+    std::size_t out_pos{};
+    std::uint32_t bit_buffer{};
+    std::uint32_t bit_count{};
+  };
+
+  struct PngHeader {
+    glm::ivec2 size{};
+    std::uint32_t bit_depth{};
+    std::uint32_t colour_type{};
+    std::uint32_t interlace{};
+  };
+
+  [[nodiscard]] auto read_png_header(std::span<std::byte const> bytes)
+    -> std::optional<PngHeader> {
+    // Signature, then IHDR: length, type, width, height, depth, type, ...
+    if (!starts_with(bytes, png_signature_v) || bytes.size() < 29) return {};
+    auto const ihdr = bytes.subspan(16);
+    return PngHeader{
+      .size = {
+        static_cast<int>(read_be32(ihdr)),
+        static_cast<int>(read_be32(ihdr.subspan(4))),
+      },
+      .bit_depth = std::to_integer<std::uint32_t>(ihdr[8]),
+      .colour_type = std::to_integer<std::uint32_t>(ihdr[9]),
+      .interlace = std::to_integer<std::uint32_t>(ihdr[12]),
+    };
+  }
+
+  [[nodiscard]] auto get_png_channels(std::uint32_t const colour_type)
+    -> std::size_t {
+    switch (colour_type) {
+      case 0:
+        return 1; // grey
+      case 2:
+        return 3; // RGB
+      case 3:
+        return 1; // palette index
+      case 4:
+        return 2; // grey, alpha
+      case 6:
+        return 4; // RGBA
+      default:
+        return 0;
+    }
+  }
+
+  [[nodiscard]] constexpr auto paeth(int const a, int const b, int const c)
+    -> int {
+    auto const p = a + b - c;
+    auto const pa = std::abs(p - a);
+    auto const pb = std::abs(p - b);
+    auto const pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+  }
+
+  void decode_png(
+    std::span<std::byte const> bytes,
+    std::span<std::byte> rgba,
+    std::vector<std::byte> &scratch
+  ) {
+    auto const header = read_png_header(bytes);
+    if (!header) throw std::runtime_error{"Invalid PNG"};
+    auto const channels = get_png_channels(header->colour_type);
+    if (header->bit_depth != 8 || channels == 0 || header->interlace != 0) {
+      throw std::runtime_error{
+        "Unsupported PNG: only 8 bit, non-interlaced images are"
+      };
+    }
+
+    auto const width = static_cast<std::size_t>(header->size.x);
+    auto const height = static_cast<std::size_t>(header->size.y);
+    auto const row_size = width * channels;
+
+    // Concatenated IDAT data, then the filtered rows inflated from it.
+    auto const filtered_size = height * (1 + row_size);
+    scratch.clear();
+    auto palette = std::array<std::array<std::byte, 4>, 256>{};
+    for (auto offset = png_signature_v.size(); offset + 12 <= bytes.size();) {
+      auto const length = std::size_t{read_be32(bytes.subspan(offset))};
+      auto const type = bytes.subspan(offset + 4, 4);
+      if (offset + 12 + length > bytes.size()) {
+        throw std::runtime_error{"Truncated PNG"};
+      }
+      auto const data = bytes.subspan(offset + 8, length);
+      auto const crc = read_be32(bytes.subspan(offset + 8 + length));
+      if (crc32(bytes.subspan(offset + 4, 4 + length)) != crc) {
+        throw std::runtime_error{"Corrupt PNG: chunk CRC mismatch"};
+      }
+      auto const is_type = [&](std::string_view const name) {
+        return std::memcmp(type.data(), name.data(), 4) == 0;
+      };
+
+      if (is_type("IDAT")) {
+        scratch.insert(scratch.end(), data.begin(), data.end());
+      } else if (is_type("PLTE")) {
+        for (auto i = 0uz; i < std::min(length / 3, palette.size()); ++i) {
+          palette.at(i) = {data[3 * i], data[3 * i + 1], data[3 * i + 2]};
+          palette.at(i)[3] = std::byte{0xff};
+        }
+      } else if (is_type("tRNS") && header->colour_type == 3) {
+        for (auto i = 0uz; i < std::min(length, palette.size()); ++i) {
+          palette.at(i)[3] = data[i];
+        }
+      } else if (is_type("IEND")) {
+        break;
+      }
+      offset += 12 + length;
+    }
+
+    // A zlib stream: a 2 byte header (deflate, no preset dictionary), raw
+    // deflate, then the Adler-32 of the inflated data.
+    auto const compressed_size = scratch.size();
+    if (compressed_size < 6) throw std::runtime_error{"Invalid PNG data"};
+    auto const cmf = std::to_integer<std::uint32_t>(scratch[0]);
+    auto const flg = std::to_integer<std::uint32_t>(scratch[1]);
+    if ((cmf & 0xf) != 8 || ((cmf << 8) | flg) % 31 != 0 ||
+        (flg & 0x20) != 0) {
+      throw std::runtime_error{"Invalid PNG data"};
+    }
+    auto const adler =
+      read_be32(std::span{scratch}.subspan(compressed_size - 4));
+    scratch.resize(compressed_size + filtered_size);
+    auto const compressed =
+      std::span<std::byte const>{scratch}.subspan(2, compressed_size - 6);
+    auto const filtered = std::span{scratch}.subspan(compressed_size);
+    if (Inflater{compressed, filtered}.inflate() != filtered_size) {
+      throw std::runtime_error{"Truncated PNG data"};
+    }
+    if (adler32(filtered) != adler) {
+      throw std::runtime_error{"Corrupt PNG: data checksum mismatch"};
+    }
+
+    // Unfilter each row in place, then expand it to RGBA.
+    auto previous = std::span<std::byte const>{};
+    for (auto y = 0uz; y < height; ++y) {
+      auto const filter = std::to_integer<int>(filtered[y * (1 + row_size)]);
+      auto const row = filtered.subspan(y * (1 + row_size) + 1, row_size);
+      for (auto x = 0uz; x < row_size; ++x) {
+        auto const a = x >= channels ? std::to_integer<int>(row[x - channels])
+                                     : 0;
+        auto const b =
+          previous.empty() ? 0 : std::to_integer<int>(previous[x]);
+        auto const c = previous.empty() || x < channels
+          ? 0
+          : std::to_integer<int>(previous[x - channels]);
+        auto const predictor = [&] {
+          switch (filter) {
+            case 0:
+              return 0;
+            case 1:
+              return a;
+            case 2:
+              return b;
+            case 3:
+              return (a + b) / 2;
+            case 4:
+              return paeth(a, b, c);
+            default:
+              throw std::runtime_error{"Invalid PNG filter"};
+          }
+        }();
+        row[x] =
+          static_cast<std::byte>(std::to_integer<int>(row[x]) + predictor);
+      }
+      previous = row;
+
+      auto const out = rgba.subspan(y * width * 4, width * 4);
+      for (auto x = 0uz; x < width; ++x) {
+        auto const texel = row.subspan(x * channels, channels);
+        auto *dst = out.data() + x * 4;
+        switch (header->colour_type) {
+          case 0:
+            dst[0] = dst[1] = dst[2] = texel[0];
+            dst[3] = std::byte{0xff};
+            break;
+          case 2:
+            std::memcpy(dst, texel.data(), 3);
+            dst[3] = std::byte{0xff};
+            break;
+          case 3:
+            std::memcpy(
+              dst, palette.at(std::to_integer<std::size_t>(texel[0])).data(), 4
+            );
+            break;
+          case 4:
+            dst[0] = dst[1] = dst[2] = texel[0];
+            dst[3] = texel[1];
+            break;
+          default:
+            std::memcpy(dst, texel.data(), 4);
+            break;
+        }
+      }
+    }
+  }
+
+  // https://qoiformat.org/qoi-specification.pdf
+  void decode_qoi(std::span<std::byte const> bytes, std::span<std::byte> rgba) {
+    using Pixel = std::array<std::uint8_t, 4>;
+    auto index = std::array<Pixel, 64>{};
+    auto pixel = Pixel{0, 0, 0, 0xff};
+
+    auto next = [&, pos = qoi_header_size_v]() mutable {
+      if (pos >= bytes.size()) throw std::runtime_error{"Truncated QOI"};
+      return std::to_integer<std::uint8_t>(bytes[pos++]);
+    };
+
+    auto run = 0u;
+    for (auto offset = 0uz; offset < rgba.size(); offset += 4) {
+      if (run > 0) {
+        --run;
+      } else {
+        auto const op = next();
+        if (op == 0xfe) {
+          pixel[0] = next();
+          pixel[1] = next();
+          pixel[2] = next();
+        } else if (op == 0xff) {
+          pixel = {next(), next(), next(), next()};
+        } else {
+          auto const tag = op >> 6;
+          auto const value = op & 0x3f;
+          if (tag == 0) {
+            pixel = index.at(value);
+          } else if (tag == 1) {
+            pixel[0] += static_cast<std::uint8_t>(((value >> 4) & 0x3) - 2);
+            pixel[1] += static_cast<std::uint8_t>(((value >> 2) & 0x3) - 2);
+            pixel[2] += static_cast<std::uint8_t>((value & 0x3) - 2);
+          } else if (tag == 2) {
+            auto const dg = value - 32;
+            auto const rb = next();
+            pixel[0] += static_cast<std::uint8_t>(dg - 8 + (rb >> 4));
+            pixel[1] += static_cast<std::uint8_t>(dg);
+            pixel[2] += static_cast<std::uint8_t>(dg - 8 + (rb & 0xf));
+          } else {
+            run = static_cast<std::uint32_t>(value);
+          }
+        }
+        auto const hash =
+          (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+        index.at(static_cast<std::size_t>(hash)) = pixel;
+      }
+      std::memcpy(rgba.data() + offset, pixel.data(), 4);
+    }
+  }
+
+  // Start Of Frame markers: SOF0 (baseline) to SOF15, but DHT, JPG, DAC.
+  [[nodiscard]] constexpr auto is_jpeg_frame(std::uint32_t const marker)
+    -> bool {
+    return marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 &&
+      marker != 0xc8 && marker != 0xcc;
+  }
+
+  // Size of a JPEG image from its frame header: the segments before it are
+  // skipped, so bytes must extend past it. nullopt if not (yet) found.
+  [[nodiscard]] auto read_jpeg_size(std::span<std::byte const> bytes)
+    -> std::optional<glm::ivec2> {
+    if (!starts_with(bytes, jpeg_signature_v)) return {};
+    for (auto offset = 2uz; offset + 4 <= bytes.size();) {
+      if (bytes[offset] != std::byte{0xff}) return {};
+      auto const marker = std::to_integer<std::uint32_t>(bytes[offset + 1]);
+      // Fill bytes before a marker.
+      if (marker == 0xff) {
+        ++offset;
+        continue;
+      }
+      auto const length = read_be16(bytes.subspan(offset + 2));
+      if (is_jpeg_frame(marker)) {
+        // Length, precision, then height and width.
+        if (offset + 9 > bytes.size()) return {};
+        return glm::ivec2{
+          static_cast<int>(read_be16(bytes.subspan(offset + 7))),
+          static_cast<int>(read_be16(bytes.subspan(offset + 5))),
+        };
+      }
+      if (length < 2 || marker == 0xda || marker == 0xd9) return {};
+      offset += 2 + length;
+    }
+    return {};
+  }
+
+  // Baseline JPEG (ITU T.81: sequential, Huffman coded, 8 bit) decoder, for
+  // greyscale and YCbCr (JFIF) or RGB (Adobe) images with any subsampling
+  // and restart intervals. Decoded components are kept in scratch, then
+  // upsampled (nearest) and converted to RGBA.
+  class JpegDecoder {
+  public:
+    explicit JpegDecoder(
+      std::span<std::byte const> bytes,
+      std::span<std::byte> rgba,
+      std::vector<std::byte> &scratch
+    ) :
+      bytes(bytes),
+      rgba(rgba),
+      scratch(&scratch) {}
+
+    void decode() {
+      pos = 2;
+      while (true) {
+        auto const marker = next_marker();
+        if (marker == 0xd9) break;
+        if (is_jpeg_frame(marker)) {
+          if (marker != 0xc0 && marker != 0xc1) {
+            throw std::runtime_error{
+              "Unsupported JPEG: only baseline images are"
+            };
+          }
+          read_frame(segment());
+        } else if (marker == 0xc4) {
+          read_huffman_tables(segment());
+        } else if (marker == 0xdb) {
+          read_quant_tables(segment());
+        } else if (marker == 0xdd) {
+          auto const data = segment();
+          if (data.size() < 2) fail();
+          restart_interval = read_be16(data);
+        } else if (marker == 0xee) {
+          read_adobe(segment());
+        } else if (marker == 0xda) {
+          read_scan(segment());
+          decode_scan();
+        } else if (marker >= 0xd0 && marker <= 0xd7) {
+          // Stray restart marker, no segment.
+        } else {
+          std::ignore = segment();
+        }
+      }
+      if (!has_frame) fail();
+      convert();
+    }
+
+  private:
+    static constexpr auto max_components_v = 3uz;
+
+    // Canonical Huffman codes, decoded as in T.81 F.2.2.3.
+    struct HuffmanTable {
+      std::array<std::uint8_t, 256> values{};
+      // Largest code of each length, -1 if none.
+      std::array<std::int32_t, 17> max_code{};
+      // values index of a code of each length: code + offset.
+      std::array<std::int32_t, 17> offset{};
+      bool defined{};
+    };
+
+    struct Component {
+      std::uint32_t id{};
+      std::uint32_t h{};
+      std::uint32_t v{};
+      std::uint32_t quant{};
+      std::uint32_t dc_table{};
+      std::uint32_t ac_table{};
+      std::int32_t dc_prediction{};
+      // Blocks covering the component, without MCU padding.
+      std::size_t blocks_x{};
+      std::size_t blocks_y{};
+      // Plane in scratch, padded to whole MCUs.
+      std::size_t offset{};
+      std::size_t stride{};
+    };
+
+    [[noreturn]] static void fail() {
+      throw std::runtime_error{"Invalid JPEG"};
+    }
+
+    // Skips to the next marker (after entropy coded data, or fill bytes).
+    auto next_marker() -> std::uint32_t {
+      while (pos + 1 < bytes.size()) {
+        auto const marker = std::to_integer<std::uint32_t>(bytes[pos + 1]);
+        if (bytes[pos] == std::byte{0xff} && marker != 0 && marker != 0xff) {
+          pos += 2;
+          return marker;
+        }
+        ++pos;
+      }
+      throw std::runtime_error{"Truncated JPEG"};
+    }
+
+    // The current marker's segment, without its length.
+    auto segment() -> std::span<std::byte const> {
+      if (pos + 2 > bytes.size()) throw std::runtime_error{"Truncated JPEG"};
+      auto const length = std::size_t{read_be16(bytes.subspan(pos))};
+      if (length < 2 || pos + length > bytes.size()) {
+        throw std::runtime_error{"Truncated JPEG"};
+      }
+      auto const ret = bytes.subspan(pos + 2, length - 2);
+      pos += length;
+      return ret;
+    }
+
+    void read_frame(std::span<std::byte const> data) {
+      if (has_frame || data.size() < 6) fail();
+      if (std::to_integer<std::uint32_t>(data[0]) != 8) {
+        throw std::runtime_error{"Unsupported JPEG: only 8 bit images are"};
+      }
+      height = read_be16(data.subspan(1));
+      width = read_be16(data.subspan(3));
+      component_count = std::to_integer<std::size_t>(data[5]);
+      if (component_count != 1 && component_count != 3) {
+        throw std::runtime_error{
+          "Unsupported JPEG: only greyscale and colour images are"
+        };
+      }
+      if (width == 0 || height == 0) fail();
+      if (rgba.size() != std::size_t{width} * height * 4) fail();
+      if (data.size() < 6 + 3 * component_count) fail();
+
+      for (auto i = 0uz; i < component_count; ++i) {
+        auto &component = components.at(i);
+        auto const info = data.subspan(6 + 3 * i, 3);
+        component.id = std::to_integer<std::uint32_t>(info[0]);
+        component.h = std::to_integer<std::uint32_t>(info[1]) >> 4;
+        component.v = std::to_integer<std::uint32_t>(info[1]) & 0xf;
+        component.quant = std::to_integer<std::uint32_t>(info[2]);
+        if (component.h == 0 || component.h > 4 || component.v == 0 ||
+            component.v > 4 || component.quant > 3) {
+          fail();
+        }
+        max_h = std::max(max_h, component.h);
+        max_v = std::max(max_v, component.v);
+      }
+
+      mcus_x = (width + 8 * max_h - 1) / (8 * max_h);
+      mcus_y = (height + 8 * max_v - 1) / (8 * max_v);
+      auto size = 0uz;
+      for (auto i = 0uz; i < component_count; ++i) {
+        auto &component = components.at(i);
+        auto const component_width =
+          (std::size_t{width} * component.h + max_h - 1) / max_h;
+        auto const component_height =
+          (std::size_t{height} * component.v + max_v - 1) / max_v;
+        component.blocks_x = (component_width + 7) / 8;
+        component.blocks_y = (component_height + 7) / 8;
+        component.offset = size;
+        component.stride = mcus_x * component.h * 8;
+        size += component.stride * mcus_y * component.v * 8;
+      }
+      scratch->assign(size, std::byte{});
+      has_frame = true;
+    }
+
+    void read_huffman_tables(std::span<std::byte const> data) {
+      while (!data.empty()) {
+        if (data.size() < 17) fail();
+        auto const info = std::to_integer<std::uint32_t>(data[0]);
+        auto const table_class = info >> 4;
+        auto const index = info & 0xf;
+        if (table_class > 1 || index > 3) fail();
+        auto &table = huffman_tables.at(table_class * 4 + index);
+
+        auto total = 0uz;
+        auto code = 0;
+        for (auto length = 1uz; length <= 16; ++length) {
+          auto const count = std::to_integer<int>(data[length]);
+          table.offset.at(length) = static_cast<std::int32_t>(total) - code;
+          code += count;
+          total += static_cast<std::size_t>(count);
+          table.max_code.at(length) = count > 0 ? code - 1 : -1;
+          code <<= 1;
+        }
+        if (total > table.values.size() || data.size() < 17 + total) fail();
+        for (auto i = 0uz; i < total; ++i) {
+          table.values.at(i) = std::to_integer<std::uint8_t>(data[17 + i]);
+        }
+        table.defined = true;
+        data = data.subspan(17 + total);
+      }
+    }
+
+    void read_quant_tables(std::span<std::byte const> data) {
+      while (!data.empty()) {
+        auto const info = std::to_integer<std::uint32_t>(data[0]);
+        auto const is_16_bit = (info >> 4) != 0;
+        auto const index = info & 0xf;
+        auto const size = 1 + (is_16_bit ? 128uz : 64uz);
+        if (index > 3 || data.size() < size) fail();
+        auto &table = quant_tables.at(index);
+        for (auto i = 0uz; i < 64; ++i) {
+          table.at(i) = is_16_bit
+            ? static_cast<std::int32_t>(read_be16(data.subspan(1 + 2 * i)))
+            : std::to_integer<std::int32_t>(data[1 + i]);
+        }
+        data = data.subspan(size);
+      }
+    }
+
+    // APP14: transform 0 means the components are RGB, not YCbCr.
+    void read_adobe(std::span<std::byte const> data) {
+      static constexpr auto adobe_v = std::string_view{"Adobe"};
+      if (data.size() < 12 ||
+          std::memcmp(data.data(), adobe_v.data(), adobe_v.size()) != 0) {
+        return;
+      }
+      is_rgb = std::to_integer<std::uint32_t>(data[11]) == 0;
+    }
+
+    void read_scan(std::span<std::byte const> data) {
+      if (!has_frame || data.empty()) fail();
+      scan_count = std::to_integer<std::size_t>(data[0]);
+      if (scan_count == 0 || scan_count > component_count ||
+          data.size() < 1 + 2 * scan_count) {
+        fail();
+      }
+      for (auto i = 0uz; i < scan_count; ++i) {
+        auto const id = std::to_integer<std::uint32_t>(data[1 + 2 * i]);
+        auto const tables = std::to_integer<std::uint32_t>(data[2 + 2 * i]);
+        auto const frame = std::span{components}.first(component_count);
+        auto const it = std::ranges::find(frame, id, &Component::id);
+        if (it == frame.end()) fail();
+        it->dc_table = tables >> 4;
+        it->ac_table = 4 + (tables & 0xf);
+        if (it->dc_table > 3 || it->ac_table > 7 ||
+            !huffman_tables.at(it->dc_table).defined ||
+            !huffman_tables.at(it->ac_table).defined) {
+          fail();
+        }
+        scan.at(i) = &*it;
+      }
+    }
+
+    void decode_scan() {
+      reset_decoder();
+      auto units = 0u;
+      auto const restart = [&] {
+        if (restart_interval == 0 || units == 0 ||
+            units % restart_interval != 0) {
+          return;
+        }
+        // Skip the RSTn marker the bit reader stopped at.
+        if (at_marker && pos + 1 < bytes.size() &&
+            (std::to_integer<std::uint32_t>(bytes[pos + 1]) & 0xf8) == 0xd0) {
+          pos += 2;
+        }
+        reset_decoder();
+      };
+
+      // A single component is not interleaved: its blocks are in raster
+      // order, without MCU padding.
+      if (scan_count == 1) {
+        auto &component = *scan.at(0);
+        for (auto y = 0uz; y < component.blocks_y; ++y) {
+          for (auto x = 0uz; x < component.blocks_x; ++x) {
+            restart();
+            decode_block(component, x, y);
+            ++units;
+          }
+        }
+        return;
+      }
+
+      for (auto mcu_y = 0uz; mcu_y < mcus_y; ++mcu_y) {
+        for (auto mcu_x = 0uz; mcu_x < mcus_x; ++mcu_x) {
+          restart();
+          for (auto i = 0uz; i < scan_count; ++i) {
+            auto &component = *scan.at(i);
+            for (auto v = 0uz; v < component.v; ++v) {
+              for (auto h = 0uz; h < component.h; ++h) {
+                decode_block(
+                  component, mcu_x * component.h + h, mcu_y * component.v + v
+                );
+              }
+            }
+          }
+          ++units;
+        }
+      }
+    }
+
+    void reset_decoder() {
+      bit_buffer = 0;
+      bit_count = 0;
+      at_marker = false;
+      for (auto &component : components) component.dc_prediction = 0;
+    }
+
+    // Keeps at least 25 bits buffered, MSB first: stuffed zero bytes are
+    // skipped, and zeros fed in once a marker (or the end) is reached.
+    void fill() {
+      while (bit_count <= 24) {
+        auto byte = 0u;
+        if (!at_marker && pos < bytes.size()) {
+          byte = std::to_integer<std::uint32_t>(bytes[pos]);
+          if (byte != 0xff) {
+            ++pos;
+          } else if (pos + 1 < bytes.size() && bytes[pos + 1] == std::byte{}) {
+            pos += 2;
+          } else {
+            at_marker = true;
+            byte = 0;
+          }
+        }
+        bit_buffer |= byte << (24 - bit_count);
+        bit_count += 8;
+      }
+    }
+
+    auto bits(std::uint32_t const count) -> std::uint32_t {
+      if (count == 0) return 0;
+      fill();
+      auto const ret = bit_buffer >> (32 - count);
+      bit_buffer <<= count;
+      bit_count -= count;
+      return ret;
+    }
+
+    auto decode(HuffmanTable const &table) -> std::uint32_t {
+      auto code = 0;
+      for (auto length = 1uz; length <= 16; ++length) {
+        code = (code << 1) | static_cast<int>(bits(1));
+        if (code <= table.max_code.at(length)) {
+          auto const index = code + table.offset.at(length);
+          return table.values.at(static_cast<std::size_t>(index));
+        }
+      }
+      fail();
+    }
+
+    // A coefficient of size bits (T.81 F.2.2.1).
+    auto receive_extend(std::uint32_t const size) -> std::int32_t {
+      if (size > 16) fail();
+      auto const value = static_cast<std::int32_t>(bits(size));
+      if (size == 0) return 0;
+      return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+    }
+
+    void decode_block(
+      Component &component, std::size_t const x, std::size_t const y
+    ) {
+      // Zig-zag position => natural (row major) position.
+      static constexpr auto natural_v = std::array<std::uint8_t, 64>{
+        0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+      };
+
+      auto const &quant = quant_tables.at(component.quant);
+      auto coefficients = std::array<float, 64>{};
+
+      component.dc_prediction +=
+        receive_extend(decode(huffman_tables.at(component.dc_table)));
+      coefficients[0] = static_cast<float>(component.dc_prediction * quant[0]);
+
+      auto const &ac_table = huffman_tables.at(component.ac_table);
+      for (auto k = 1uz; k < 64;) {
+        auto const symbol = decode(ac_table);
+        auto const run = symbol >> 4;
+        auto const size = symbol & 0xf;
+        if (size == 0) {
+          // End of block, or a run of 16 zeros.
+          if (run != 15) break;
+          k += 16;
+          continue;
+        }
+        k += run;
+        if (k > 63) fail();
+        coefficients.at(natural_v.at(k)) =
+          static_cast<float>(receive_extend(size) * quant.at(k));
+        ++k;
+      }
+
+      auto const out = std::span{*scratch}.subspan(
+        component.offset + y * 8 * component.stride + x * 8
+      );
+      idct(coefficients, out, component.stride);
+    }
+
+    // Separable float IDCT, level shifted into 8 bit samples.
+    static void idct(
+      std::array<float, 64> const &in,
+      std::span<std::byte> out,
+      std::size_t const stride
+    ) {
+      // C(u) / 2 * cos((2x + 1) * u * pi / 16), at [x * 8 + u].
+      static auto const basis_v = [] {
+        auto ret = std::array<float, 64>{};
+        for (auto x = 0uz; x < 8; ++x) {
+          for (auto u = 0uz; u < 8; ++u) {
+            auto const scale = u == 0 ? std::sqrt(0.5) : 1.0;
+            auto const angle = static_cast<double>((2 * x + 1) * u) *
+              3.14159265358979323846 / 16.0;
+            ret.at(x * 8 + u) =
+              static_cast<float>(0.5 * scale * std::cos(angle));
+          }
+        }
+        return ret;
+      }();
+
+      auto rows = std::array<float, 64>{};
+      for (auto v = 0uz; v < 8; ++v) {
+        for (auto x = 0uz; x < 8; ++x) {
+          auto sum = 0.0f;
+          for (auto u = 0uz; u < 8; ++u) {
+            sum += basis_v[x * 8 + u] * in[v * 8 + u];
+          }
+          rows[v * 8 + x] = sum;
+        }
+      }
+      for (auto y = 0uz; y < 8; ++y) {
+        for (auto x = 0uz; x < 8; ++x) {
+          auto sum = 128.0f;
+          for (auto v = 0uz; v < 8; ++v) {
+            sum += basis_v[y * 8 + v] * rows[v * 8 + x];
+          }
+          out[y * stride + x] =
+            static_cast<std::byte>(std::clamp(std::lround(sum), 0l, 255l));
+        }
+      }
+    }
+
+    void convert() const {
+      auto const rgb = is_rgb ||
+        (components[0].id == 'R' && components[1].id == 'G' &&
+         components[2].id == 'B');
+      auto const sample = [&](Component const &component, std::size_t x,
+                              std::size_t y) {
+        x = x * component.h / max_h;
+        y = y * component.v / max_v;
+        return std::to_integer<int>(
+          (*scratch)[component.offset + y * component.stride + x]
+        );
+      };
+      auto const to_byte = [](float const value) {
+        return static_cast<std::byte>(std::clamp(std::lround(value), 0l, 255l));
+      };
+
+      for (auto y = 0uz; y < height; ++y) {
+        for (auto x = 0uz; x < width; ++x) {
+          auto *dst = rgba.data() + (y * width + x) * 4;
+          dst[3] = std::byte{0xff};
+          auto const c0 = sample(components[0], x, y);
+          if (component_count == 1) {
+            dst[0] = dst[1] = dst[2] = static_cast<std::byte>(c0);
+            continue;
+          }
+          auto const c1 = sample(components[1], x, y);
+          auto const c2 = sample(components[2], x, y);
+          if (rgb) {
+            dst[0] = static_cast<std::byte>(c0);
+            dst[1] = static_cast<std::byte>(c1);
+            dst[2] = static_cast<std::byte>(c2);
+            continue;
+          }
+          // JFIF YCbCr => RGB.
+          auto const luma = static_cast<float>(c0);
+          auto const cb = static_cast<float>(c1 - 128);
+          auto const cr = static_cast<float>(c2 - 128);
+          dst[0] = to_byte(luma + 1.402f * cr);
+          dst[1] = to_byte(luma - 0.344136f * cb - 0.714136f * cr);
+          dst[2] = to_byte(luma + 1.772f * cb);
+        }
+      }
+    }
+
+    std::span<std::byte const> bytes;
+    std::span<std::byte> rgba;
+    std::vector<std::byte> *scratch{};
+    std::size_t pos{};
+
+    std::array<HuffmanTable, 8> huffman_tables{};
+    std::array<std::array<std::int32_t, 64>, 4> quant_tables{};
+    std::uint32_t restart_interval{};
+    bool is_rgb{};
+
+    bool has_frame{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::size_t component_count{};
+    std::array<Component, max_components_v> components{};
+    std::uint32_t max_h{1};
+    std::uint32_t max_v{1};
+    std::size_t mcus_x{};
+    std::size_t mcus_y{};
+
+    std::array<Component *, max_components_v> scan{};
+    std::size_t scan_count{};
+    std::uint32_t bit_buffer{};
+    std::uint32_t bit_count{};
+    bool at_marker{};
+  };
+} // namespace
+
+namespace framework {
+  /// Size of a PNG or QOI image from (at least) the first 32 bytes of its
+  /// file, or of a JPEG image from the bytes up to its frame header, or
+  /// nullopt if none (yet). Decoded images are RGBA8: 4 bytes per texel.
+  export [[nodiscard]] auto read_image_size(std::span<std::byte const> bytes)
+    -> std::optional<glm::ivec2> {
+    if (auto const header = read_png_header(bytes)) return header->size;
+    if (is_qoi(bytes)) {
+      return glm::ivec2{
+        static_cast<int>(read_be32(bytes.subspan(4))),
+        static_cast<int>(read_be32(bytes.subspan(8))),
+      };
+    }
+    return read_jpeg_size(bytes);
+  }
+
+  /// Decodes a whole PNG (8 bit, non-interlaced), baseline JPEG or QOI file
+  /// into rgba, eg mapped staging memory, sized from read_image_size().
+  /// scratch holds intermediate data (PNG, JPEG), reuse it across calls on
+  /// a thread. Throws on invalid or unsupported files.
+  export void decode_image(
+    std::span<std::byte const> bytes,
+    std::span<std::byte> rgba,
+    std::vector<std::byte> &scratch
+  ) {
+    auto const size = read_image_size(bytes);
+    if (!size || size->x <= 0 || size->y <= 0) {
+      throw std::runtime_error{"Unsupported image format"};
+    }
+    if (rgba.size() != static_cast<std::size_t>(size->x) * size->y * 4) {
+      throw std::runtime_error{"Image size mismatch"};
+    }
+
+    if (is_qoi(bytes)) {
+      decode_qoi(bytes, rgba);
+    } else if (starts_with(bytes, jpeg_signature_v)) {
+      JpegDecoder{bytes, rgba, scratch}.decode();
+    } else {
+      decode_png(bytes, rgba, scratch);
+    }
+  }
+} // namespace framework
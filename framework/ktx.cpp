@@ -0,0 +1,465 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_format_traits.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <print>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module framework:ktx;
+import :trace;
+import :upload;
+
+namespace fs = std::filesystem;
+
+namespace {
+  constexpr auto identifier_v = std::array<std::uint8_t, 12>{
+    0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'
+  };
+
+  // Header and index following the identifier, up to the supercompression
+  // global data (unused): 64 bit fields from there are read separately.
+  struct Header {
+    std::uint32_t vk_format;
+    std::uint32_t type_size;
+    std::uint32_t pixel_width;
+    std::uint32_t pixel_height;
+    std::uint32_t pixel_depth;
+    std::uint32_t layer_count;
+    std::uint32_t face_count;
+    std::uint32_t level_count;
+    std::uint32_t supercompression_scheme;
+    std::uint32_t dfd_byte_offset;
+    std::uint32_t dfd_byte_length;
+    std::uint32_t kvd_byte_offset;
+    std::uint32_t kvd_byte_length;
+  };
+
+  struct LevelIndex {
+    std::uint64_t byte_offset;
+    std::uint64_t byte_length;
+    std::uint64_t uncompressed_byte_length;
+  };
+
+  static_assert(sizeof(Header) == 52);
+  static_assert(sizeof(LevelIndex) == 24);
+
+  // After the header and the supercompression global data offset and size.
+  constexpr auto level_index_offset_v =
+    identifier_v.size() + sizeof(Header) + 2 * sizeof(std::uint64_t);
+
+  template <typename Type>
+  [[nodiscard]] auto read_at(
+    std::span<std::byte const> bytes, std::size_t const offset
+  ) -> Type {
+    if (offset + sizeof(Type) > bytes.size()) {
+      throw std::runtime_error{"Truncated KTX2 file"};
+    }
+    auto ret = Type{};
+    std::memcpy(&ret, bytes.data() + offset, sizeof(Type));
+    return ret;
+  }
+
+  using Rgba = std::array<std::uint8_t, 4>;
+  using Block = std::array<Rgba, 16>;
+
+  [[nodiscard]] auto read_u16(std::span<std::byte const> bytes)
+    -> std::uint16_t {
+    return static_cast<std::uint16_t>(
+      std::to_integer<unsigned>(bytes[0]) |
+      (std::to_integer<unsigned>(bytes[1]) << 8)
+    );
+  }
+
+  [[nodiscard]] auto read_u64(std::span<std::byte const> bytes)
+    -> std::uint64_t {
+    auto ret = std::uint64_t{};
+    for (auto i = 8uz; i-- > 0;) {
+      ret = (ret << 8) | std::to_integer<std::uint64_t>(bytes[i]);
+    }
+    return ret;
+  }
+
+  // Colour half of BC1-3: two RGB565 endpoints and 2 bit indices. BC1 has
+  // a 3 colour mode (c0 <= c1) whose 4th colour is black, transparent with
+  // alpha.
+  void decode_colour(
+    std::span<std::byte const> block,
+    Block &out,
+    bool const three_colour_mode,
+    bool const alpha
+  ) {
+    auto const expand = [](std::uint16_t const c) {
+      auto const r = (c >> 11) & 0x1f;
+      auto const g = (c >> 5) & 0x3f;
+      auto const b = c & 0x1f;
+      return Rgba{
+        static_cast<std::uint8_t>((r << 3) | (r >> 2)),
+        static_cast<std::uint8_t>((g << 2) | (g >> 4)),
+        static_cast<std::uint8_t>((b << 3) | (b >> 2)),
+        0xff,
+      };
+    };
+    auto const mix = [](Rgba const &a, Rgba const &b, int wa, int wb) {
+      auto ret = Rgba{0, 0, 0, 0xff};
+      for (auto c = 0uz; c < 3; ++c) {
+        ret.at(c) =
+          static_cast<std::uint8_t>((wa * a.at(c) + wb * b.at(c)) / (wa + wb));
+      }
+      return ret;
+    };
+
+    auto const c0 = read_u16(block);
+    auto const c1 = read_u16(block.subspan(2));
+    auto palette = std::array{expand(c0), expand(c1), Rgba{}, Rgba{}};
+    if (c0 > c1 || !three_colour_mode) {
+      palette[2] = mix(palette[0], palette[1], 2, 1);
+      palette[3] = mix(palette[0], palette[1], 1, 2);
+    } else {
+      palette[2] = mix(palette[0], palette[1], 1, 1);
+      palette[3] = Rgba{0, 0, 0, static_cast<std::uint8_t>(alpha ? 0 : 0xff)};
+    }
+
+    for (auto i = 0uz; i < out.size(); ++i) {
+      auto const byte = std::to_integer<unsigned>(block[4 + i / 4]);
+      out.at(i) = palette.at((byte >> (2 * (i % 4))) & 0x3);
+    }
+  }
+
+  // BC4 (and the alpha half of BC3): two 8 bit endpoints, 3 bit indices.
+  void decode_channel(
+    std::span<std::byte const> block, Block &out, std::size_t const channel
+  ) {
+    auto const e0 = std::to_integer<int>(block[0]);
+    auto const e1 = std::to_integer<int>(block[1]);
+    auto palette = std::array<int, 8>{e0, e1};
+    if (e0 > e1) {
+      for (auto i = 1; i < 7; ++i) {
+        palette.at(static_cast<std::size_t>(i + 1)) =
+          ((7 - i) * e0 + i * e1) / 7;
+      }
+    } else {
+      for (auto i = 1; i < 5; ++i) {
+        palette.at(static_cast<std::size_t>(i + 1)) =
+          ((5 - i) * e0 + i * e1) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 0xff;
+    }
+
+    // 48 bits of indices follow the endpoints.
+    auto const indices = read_u64(block) >> 16;
+    for (auto i = 0uz; i < out.size(); ++i) {
+      auto const index = (indices >> (3 * i)) & 0x7;
+      out.at(i).at(channel) = static_cast<std::uint8_t>(palette.at(index));
+    }
+  }
+
+  // BC2 alpha: 4 bits per texel.
+  void decode_explicit_alpha(std::span<std::byte const> block, Block &out) {
+    auto const alphas = read_u64(block);
+    for (auto i = 0uz; i < out.size(); ++i) {
+      auto const alpha = (alphas >> (4 * i)) & 0xf;
+      out.at(i)[3] = static_cast<std::uint8_t>(alpha * 17);
+    }
+  }
+
+  // Block compressed formats decompress_level() handles, and the RGBA8
+  // format they decompress to. Single and dual channel formats decompress
+  // to (r, 0, 0, 1) and (r, g, 0, 1), as they would sample.
+  [[nodiscard]] auto get_decompressed_format(vk::Format const format)
+    -> std::optional<vk::Format> {
+    using enum vk::Format;
+    switch (format) {
+      case eBc1RgbUnormBlock:
+      case eBc1RgbaUnormBlock:
+      case eBc2UnormBlock:
+      case eBc3UnormBlock:
+      case eBc4UnormBlock:
+      case eBc5UnormBlock:
+        return eR8G8B8A8Unorm;
+      case eBc1RgbSrgbBlock:
+      case eBc1RgbaSrgbBlock:
+      case eBc2SrgbBlock:
+      case eBc3SrgbBlock:
+        return eR8G8B8A8Srgb;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  void decode_block(
+    vk::Format const format, std::span<std::byte const> block, Block &out
+  ) {
+    using enum vk::Format;
+    switch (format) {
+      case eBc1RgbUnormBlock:
+      case eBc1RgbSrgbBlock:
+        decode_colour(block, out, true, false);
+        break;
+      case eBc1RgbaUnormBlock:
+      case eBc1RgbaSrgbBlock:
+        decode_colour(block, out, true, true);
+        break;
+      case eBc2UnormBlock:
+      case eBc2SrgbBlock:
+        decode_colour(block.subspan(8), out, false, false);
+        decode_explicit_alpha(block, out);
+        break;
+      case eBc3UnormBlock:
+      case eBc3SrgbBlock:
+        decode_colour(block.subspan(8), out, false, false);
+        decode_channel(block, out, 3);
+        break;
+      case eBc4UnormBlock:
+        out.fill(Rgba{0, 0, 0, 0xff});
+        decode_channel(block, out, 0);
+        break;
+      case eBc5UnormBlock:
+        out.fill(Rgba{0, 0, 0, 0xff});
+        decode_channel(block, out, 0);
+        decode_channel(block.subspan(8), out, 1);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Decompresses a level of 4x4 blocks to RGBA8.
+  [[nodiscard]] auto decompress_level(
+    vk::Format const format,
+    std::span<std::byte const> bytes,
+    vk::Extent2D const extent
+  ) -> std::vector<std::byte> {
+    auto const block_size = std::size_t{vk::blockSize(format)};
+    auto const blocks_x = (extent.width + 3) / 4;
+    auto const blocks_y = (extent.height + 3) / 4;
+
+    auto ret =
+      std::vector<std::byte>(std::size_t{extent.width} * extent.height * 4);
+    auto block = Block{};
+    for (auto by = 0u; by < blocks_y; ++by) {
+      for (auto bx = 0u; bx < blocks_x; ++bx) {
+        auto const index = std::size_t{by} * blocks_x + bx;
+        decode_block(format, bytes.subspan(index * block_size), block);
+
+        // Blocks on the edges may extend past the image.
+        for (auto y = 0u; y < 4 && by * 4 + y < extent.height; ++y) {
+          for (auto x = 0u; x < 4 && bx * 4 + x < extent.width; ++x) {
+            auto const offset =
+              (std::size_t{by * 4 + y} * extent.width + bx * 4 + x) * 4;
+            std::memcpy(ret.data() + offset, block.at(y * 4 + x).data(), 4);
+          }
+        }
+      }
+    }
+    return ret;
+  }
+
+  [[nodiscard]] auto get_level_extent(
+    vk::Extent2D const extent, std::uint32_t const level
+  ) -> vk::Extent2D {
+    return {
+      std::max(extent.width >> level, 1u),
+      std::max(extent.height >> level, 1u),
+    };
+  }
+
+  // Bytes of a level, from its format's block size and extent.
+  [[nodiscard]] auto get_level_size(
+    vk::Format const format, vk::Extent2D const extent
+  ) -> std::size_t {
+    auto const block_extent = vk::blockExtent(format);
+    auto const blocks_x =
+      (extent.width + block_extent[0] - 1) / block_extent[0];
+    auto const blocks_y =
+      (extent.height + block_extent[1] - 1) / block_extent[1];
+    return std::size_t{blocks_x} * blocks_y * vk::blockSize(format);
+  }
+
+  // Sampling from optimal tiling images of format, and uploading to them.
+  [[nodiscard]] auto can_sample(
+    vk::PhysicalDevice const physical_device, vk::Format const format
+  ) -> bool {
+    static constexpr auto features_v =
+      vk::FormatFeatureFlagBits::eSampledImage |
+      vk::FormatFeatureFlagBits::eTransferDst;
+    auto const properties = physical_device.getFormatProperties(format);
+    return (properties.optimalTilingFeatures & features_v) == features_v;
+  }
+} // namespace
+
+namespace framework {
+  /// A 2D KTX2 texture read into memory, ready for upload with
+  /// vma::UploadBatch::add_image(). Levels are kept as stored in the file
+  /// (eg BC7, ASTC) when the device can sample their format, else
+  /// decompressed to RGBA8 on the CPU (BC1-BC5 only).
+  export class Ktx2Image {
+  public:
+    explicit Ktx2Image(
+      vk::Format const file_format,
+      vk::Format const format,
+      vk::Extent2D const extent,
+      std::vector<std::vector<std::byte>> levels
+    ) :
+      file_format(file_format),
+      format(format),
+      extent(extent),
+      levels(std::move(levels)) {}
+
+    [[nodiscard]] auto get_levels() const -> vma::ImageLevels {
+      auto ret = vma::ImageLevels{.format = format, .extent = extent};
+      for (auto const &level : levels) ret.levels.emplace_back(level);
+      return ret;
+    }
+
+    /// Format of the file, compressed if not decompressed.
+    [[nodiscard]] auto get_file_format() const -> vk::Format {
+      return file_format;
+    }
+
+    [[nodiscard]] auto is_decompressed() const -> bool {
+      return format != file_format;
+    }
+
+    /// Bytes uploaded for all levels.
+    [[nodiscard]] auto size() const -> std::size_t {
+      auto ret = 0uz;
+      for (auto const &level : levels) ret += level.size();
+      return ret;
+    }
+
+  private:
+    vk::Format file_format{};
+    vk::Format format{};
+    vk::Extent2D extent;
+    // Largest first.
+    std::vector<std::vector<std::byte>> levels;
+  };
+
+  /// Reads a KTX2 file, choosing the format to upload its levels in: as
+  /// stored if physical_device supports it (see getFormatProperties()),
+  /// else RGBA8 when it can be decompressed. Only 2D textures without
+  /// supercompression (Basis Universal, Zstandard) are supported.
+  /// decompress forces the RGBA8 path, eg to compare both.
+  export [[nodiscard]] auto load_ktx2(
+    fs::path const &path,
+    vk::PhysicalDevice const physical_device,
+    bool const decompress = false
+  ) -> Ktx2Image {
+    auto const span = trace::Span{"load_ktx2"};
+    auto const fail = [&path](std::string_view const reason) {
+      return std::runtime_error{
+        std::format("Failed to load '{}': {}", path.generic_string(), reason)
+      };
+    };
+
+    auto file = std::ifstream{path, std::ios::binary | std::ios::ate};
+    if (!file.is_open()) {
+      throw std::runtime_error{
+        std::format("Failed to open file: '{}'", path.generic_string())
+      };
+    }
+    auto const size = file.tellg();
+    auto bytes = std::vector<std::byte>(static_cast<std::size_t>(size));
+    file.seekg({}, std::ios::beg);
+    void *data = bytes.data();
+    file.read(static_cast<char *>(data), size);
+
+    auto const is_ktx2 = bytes.size() >= identifier_v.size() &&
+      std::memcmp(bytes.data(), identifier_v.data(), identifier_v.size()) == 0;
+    if (!is_ktx2) throw fail("not a KTX2 file");
+
+    auto const header = read_at<Header>(bytes, identifier_v.size());
+    if (header.supercompression_scheme != 0) {
+      throw fail("supercompression is not supported");
+    }
+    if (header.pixel_depth > 1 || header.layer_count > 1 ||
+        header.face_count != 1 || header.pixel_width == 0 ||
+        header.pixel_height == 0) {
+      throw fail("only 2D textures are supported");
+    }
+    if (header.vk_format == VK_FORMAT_UNDEFINED) {
+      throw fail("Basis Universal textures are not supported");
+    }
+
+    auto const file_format = static_cast<vk::Format>(header.vk_format);
+    auto const extent = vk::Extent2D{header.pixel_width, header.pixel_height};
+    // Unknown to Vulkan-Hpp (or not a format at all): its levels can't be
+    // sized.
+    if (vk::blockSize(file_format) == 0) {
+      throw fail(std::format("unknown format {}", header.vk_format));
+    }
+    // A full mip chain ends at 1x1, and keeps level shifts below 32 bits.
+    auto const max_levels = static_cast<std::uint32_t>(
+      std::bit_width(std::max(extent.width, extent.height))
+    );
+    if (header.level_count > max_levels) {
+      throw fail(std::format(
+        "{} levels, at most {} for {}x{}",
+        header.level_count,
+        max_levels,
+        extent.width,
+        extent.height
+      ));
+    }
+
+    auto format = file_format;
+    if (decompress || !can_sample(physical_device, file_format)) {
+      auto const decompressed = get_decompressed_format(file_format);
+      if (!decompressed) {
+        throw fail(std::format(
+          "{} is not supported by the device, and can't be decompressed",
+          vk::to_string(file_format)
+        ));
+      }
+      format = *decompressed;
+    }
+
+    // A level count of 0 asks for mip-maps to be generated: load level 0.
+    auto const level_count = std::max(header.level_count, 1u);
+    auto levels = std::vector<std::vector<std::byte>>{};
+    for (auto level = 0u; level < level_count; ++level) {
+      auto const index = read_at<LevelIndex>(
+        bytes, level_index_offset_v + level * sizeof(LevelIndex)
+      );
+      auto const level_extent = get_level_extent(extent, level);
+      auto const level_size = get_level_size(file_format, level_extent);
+      // Checked without summing: a crafted offset could wrap around.
+      if (index.byte_length < level_size || index.byte_offset > bytes.size() ||
+          level_size > bytes.size() - index.byte_offset) {
+        throw fail(std::format("truncated level {}", level));
+      }
+
+      auto const level_bytes =
+        std::span{bytes}.subspan(index.byte_offset, level_size);
+      if (format != file_format) {
+        levels.push_back(
+          decompress_level(file_format, level_bytes, level_extent)
+        );
+      } else {
+        levels.emplace_back(level_bytes.begin(), level_bytes.end());
+      }
+    }
+
+    std::println(
+      "[lvk] Loaded '{}' [{}x{}, {} levels] as {}",
+      path.filename().generic_string(),
+      extent.width,
+      extent.height,
+      levels.size(),
+      vk::to_string(format)
+    );
+    return Ktx2Image{file_format, format, extent, std::move(levels)};
+  }
+} // namespace framework
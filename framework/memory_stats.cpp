@@ -0,0 +1,179 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <imgui.h>
+#include <print>
+#include <vector>
+#include <vk_mem_alloc.h>
+
+export module framework:memory_stats;
+import :vma;
+
+namespace fs = std::filesystem;
+
+namespace {
+  constexpr auto to_mib(vk::DeviceSize const bytes) -> double {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+  }
+} // namespace
+
+namespace framework {
+  /// Budget and usage of one memory heap. usage and budget come from
+  /// VK_EXT_memory_budget when enabled (else VMA estimates them), and
+  /// include other processes; the rest is this allocator's.
+  export struct HeapStats {
+    vk::DeviceSize size{};
+    vk::DeviceSize budget{};
+    vk::DeviceSize usage{};
+    // Bytes of device memory blocks allocated, and of allocations in them:
+    // the difference is free space (fragmentation when blocks stay).
+    vk::DeviceSize block_bytes{};
+    vk::DeviceSize allocation_bytes{};
+    std::uint32_t block_count{};
+    std::uint32_t allocation_count{};
+    bool device_local{};
+  };
+
+  export struct MemoryStats {
+    std::vector<HeapStats> heaps;
+    // Indexed by vma::MemoryTag.
+    std::array<vma::TagUsage, vma::memory_tag_count_v> tags{};
+
+    void print() const {
+      for (auto i = 0uz; i < heaps.size(); ++i) {
+        auto const &heap = heaps.at(i);
+        std::println(
+          "[lvk] heap {}{}: {:.1f} / {:.1f} MiB, blocks {:.1f} MiB ({}), "
+          "allocations {:.1f} MiB ({})",
+          i,
+          heap.device_local ? " (device)" : "",
+          to_mib(heap.usage),
+          to_mib(heap.budget),
+          to_mib(heap.block_bytes),
+          heap.block_count,
+          to_mib(heap.allocation_bytes),
+          heap.allocation_count
+        );
+      }
+      for (auto i = 0uz; i < tags.size(); ++i) {
+        auto const &tag = tags.at(i);
+        if (tag.count == 0) continue;
+        std::println(
+          "[lvk] {}: {:.1f} MiB ({})",
+          vma::to_string(static_cast<vma::MemoryTag>(i)),
+          to_mib(tag.bytes),
+          tag.count
+        );
+      }
+    }
+  };
+
+  export [[nodiscard]] auto get_memory_stats(VmaAllocator const allocator)
+    -> MemoryStats {
+    auto ret = MemoryStats{};
+
+    VkPhysicalDeviceMemoryProperties const *properties{};
+    vmaGetMemoryProperties(allocator, &properties);
+
+    auto budgets = std::vector<VmaBudget>(properties->memoryHeapCount);
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    for (auto i = 0u; i < properties->memoryHeapCount; ++i) {
+      auto const &heap = properties->memoryHeaps[i];
+      auto const &budget = budgets.at(i);
+      ret.heaps.push_back(HeapStats{
+        .size = heap.size,
+        .budget = budget.budget,
+        .usage = budget.usage,
+        .block_bytes = budget.statistics.blockBytes,
+        .allocation_bytes = budget.statistics.allocationBytes,
+        .block_count = budget.statistics.blockCount,
+        .allocation_count = budget.statistics.allocationCount,
+        .device_local = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+      });
+    }
+
+    for (auto i = 0uz; i < ret.tags.size(); ++i) {
+      ret.tags.at(i) =
+        vma::get_tag_usage(allocator, static_cast<vma::MemoryTag>(i));
+    }
+
+    return ret;
+  }
+
+  /// Writes VMA's detailed statistics (every block and allocation) as JSON.
+  export auto write_memory_json(
+    VmaAllocator const allocator, fs::path const &path
+  ) -> bool {
+    auto file = std::ofstream{path};
+    if (!file.is_open()) {
+      std::println(stderr, "Failed to open file: '{}'", path.generic_string());
+      return false;
+    }
+
+    char *stats{};
+    vmaBuildStatsString(allocator, &stats, VK_TRUE);
+    file << stats;
+    vmaFreeStatsString(allocator, stats);
+
+    std::println("[lvk] Wrote memory stats to '{}'", path.generic_string());
+    return true;
+  }
+
+  export void draw_memory_panel(MemoryStats const &stats) {
+    ImGui::SetNextWindowSize({420.0f, 0.0f}, ImGuiCond_Once);
+    if (ImGui::Begin("Memory")) {
+      if (ImGui::BeginTable("heaps", 5)) {
+        ImGui::TableSetupColumn("heap");
+        ImGui::TableSetupColumn("usage / budget (MiB)");
+        ImGui::TableSetupColumn("blocks (MiB)");
+        ImGui::TableSetupColumn("allocs (MiB)");
+        ImGui::TableSetupColumn("count");
+        ImGui::TableHeadersRow();
+
+        for (auto i = 0uz; i < stats.heaps.size(); ++i) {
+          auto const &heap = stats.heaps.at(i);
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          ImGui::Text("%zu%s", i, heap.device_local ? " (device)" : "");
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f / %.1f", to_mib(heap.usage), to_mib(heap.budget));
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f", to_mib(heap.block_bytes));
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f", to_mib(heap.allocation_bytes));
+          ImGui::TableNextColumn();
+          ImGui::Text("%u", heap.allocation_count);
+        }
+        ImGui::EndTable();
+      }
+
+      ImGui::Separator();
+
+      if (ImGui::BeginTable("tags", 3)) {
+        ImGui::TableSetupColumn("tag");
+        ImGui::TableSetupColumn("MiB");
+        ImGui::TableSetupColumn("count");
+        ImGui::TableHeadersRow();
+
+        for (auto i = 0uz; i < stats.tags.size(); ++i) {
+          auto const &tag = stats.tags.at(i);
+          auto const name = vma::to_string(static_cast<vma::MemoryTag>(i));
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          ImGui::TextUnformatted(name.data(), name.data() + name.size());
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f", to_mib(tag.bytes));
+          ImGui::TableNextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(tag.count));
+        }
+        ImGui::EndTable();
+      }
+    }
+    ImGui::End();
+  }
+} // namespace framework
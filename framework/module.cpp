@@ -3,15 +3,34 @@ export module framework;
 export import :assets;
 export import :command_block;
 export import :dear_imgui;
+export import :deferred_queue;
+export import :frame_stats;
 export import :resource_buffering;
 export import :scoped;
 export import :gpu;
+export import :gpu_profiler;
 export import :scoped_waiter;
+export import :staging_ring;
+export import :timeline;
+export import :trace;
 export import :shader_program;
 export import :window;
 export import :vma;
+export import :memory_stats;
+export import :upload;
 export import :swapchain;
+export import :offscreen;
 export import :descriptor_buffer;
+export import :uniform_arena;
+export import :bindless_table;
+export import :sampler_cache;
 export import :texture;
+export import :image_decode;
+export import :texture_loader;
+export import :ktx;
+export import :defragmenter;
+export import :thread_pool;
+export import :parallel_recorder;
+export import :render_graph;
 export import :transform;
 export import :renderer;
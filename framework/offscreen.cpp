@@ -0,0 +1,188 @@
+module;
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <vector>
+#include <vk_mem_alloc.h>
+
+export module framework:offscreen;
+import :command_block;
+import :swapchain;
+import :vma;
+
+namespace fs = std::filesystem;
+
+namespace {
+  // Color image with 1 layer and 1 mip-level.
+  constexpr auto subresource_range = [] {
+    return vk::ImageSubresourceRange()
+      .setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setLayerCount(1)
+      .setLevelCount(1);
+  }();
+} // namespace
+
+namespace framework {
+  /// Pixels copied back from an OffscreenTarget.
+  export struct Readback {
+    // Tightly packed rows of RGBA8 texels.
+    std::vector<std::byte> bytes;
+    glm::ivec2 size{};
+    vk::Format format{};
+  };
+
+  /// Writes the RGB channels of a Readback to a binary PPM file.
+  export auto write_ppm(fs::path const &path, Readback const &readback)
+    -> bool {
+    if (readback.bytes.empty()) return false;
+
+    auto file = std::ofstream{path, std::ios::binary};
+    if (!file.is_open()) {
+      std::println(stderr, "Failed to open file: '{}'", path.generic_string());
+      return false;
+    }
+
+    file << std::format("P6\n{} {}\n255\n", readback.size.x, readback.size.y);
+    for (auto i = 0uz; i + 3 < readback.bytes.size(); i += 4) {
+      file.write(reinterpret_cast<char const *>(&readback.bytes[i]), 3);
+    }
+
+    return true;
+  }
+
+  /// VMA-allocated color image rendered into instead of Swapchain images,
+  /// for running without a window or display.
+  export class OffscreenTarget {
+  public:
+    static constexpr auto format_v = vk::Format::eR8G8B8A8Srgb;
+
+    explicit OffscreenTarget(
+      vk::Device const device,
+      VmaAllocator const allocator,
+      std::uint32_t const queue_family,
+      glm::ivec2 const size
+    ) : allocator(allocator), queue_family(queue_family) {
+      auto const usize = glm::uvec2{size};
+      extent = vk::Extent2D{usize.x, usize.y};
+
+      auto const image_info = vma::ImageCreateInfo{
+        .allocator = allocator,
+        .queue_family = queue_family,
+      };
+      // Rendered into, then copied out for readback.
+      auto const usage = vk::ImageUsageFlagBits::eColorAttachment |
+        vk::ImageUsageFlagBits::eTransferSrc;
+
+      image = vma::create_image(image_info, usage, 1, format_v, extent);
+      if (!image.get().image) {
+        throw std::runtime_error{"Failed to create Offscreen Image"};
+      }
+
+      auto image_view_info = vk::ImageViewCreateInfo()
+                               .setImage(image.get().image)
+                               .setViewType(vk::ImageViewType::e2D)
+                               .setFormat(format_v)
+                               .setSubresourceRange(subresource_range);
+      image_view = device.createImageViewUnique(image_view_info);
+
+      std::println("[lvk] Offscreen [{}x{}]", size.x, size.y);
+    }
+
+    [[nodiscard]]
+    auto get_size() const -> glm::ivec2 {
+      return {extent.width, extent.height};
+    }
+
+    [[nodiscard]]
+    auto get_format() const -> vk::Format {
+      return format_v;
+    }
+
+    [[nodiscard]]
+    auto acquire() const -> RenderTarget {
+      return RenderTarget{
+        .image = image.get().image,
+        .image_view = *image_view,
+        .extent = extent,
+      };
+    }
+
+    [[nodiscard]]
+    auto base_barrier() const -> vk::ImageMemoryBarrier2 {
+      // fill up the parts common to all barriers.
+      auto barrier = vk::ImageMemoryBarrier2()
+                       .setImage(image.get().image)
+                       .setSubresourceRange(subresource_range)
+                       .setSrcQueueFamilyIndex(queue_family)
+                       .setDstQueueFamilyIndex(queue_family);
+
+      return barrier;
+    }
+
+    /// Copies the image (expected in TransferSrcOptimal layout) into host
+    /// memory. Commands submitted earlier on the same queue are ordered
+    /// before the copy by the barrier recorded at the end of each frame.
+    [[nodiscard]]
+    auto read_back(CommandBlock command_block) const -> Readback {
+      auto const size = vk::DeviceSize{extent.width} * extent.height * 4;
+
+      auto const buffer_info = vma::BufferCreateInfo{
+        .allocator = allocator,
+        .usage = vk::BufferUsageFlagBits::eTransferDst,
+        .queue_family = queue_family,
+      };
+      auto const readback_buffer =
+        vma::create_buffer(buffer_info, vma::BufferMemoryType::Readback, size);
+      if (!readback_buffer.get().buffer) return {};
+
+      auto subresource_layers = vk::ImageSubresourceLayers()
+                                  .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                                  .setLayerCount(1);
+      auto image_buffer_copy =
+        vk::BufferImageCopy2()
+          .setImageSubresource(subresource_layers)
+          .setImageExtent(vk::Extent3D{extent.width, extent.height, 1});
+      auto copy_info = vk::CopyImageToBufferInfo2()
+                         .setSrcImage(image.get().image)
+                         .setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+                         .setDstBuffer(readback_buffer.get().buffer)
+                         .setRegions(image_buffer_copy);
+      command_block.get_command_buffer().copyImageToBuffer2(copy_info);
+
+      // Make the copied bytes visible to host reads.
+      auto barrier = vk::MemoryBarrier2()
+                       .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+                       .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                       .setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+                       .setDstAccessMask(vk::AccessFlagBits2::eHostRead);
+      auto dependency_info = vk::DependencyInfo().setMemoryBarriers(barrier);
+      command_block.get_command_buffer().pipelineBarrier2(dependency_info);
+
+      command_block.submit_and_wait();
+
+      vmaInvalidateAllocation(
+        allocator, readback_buffer.get().allocation, 0, VK_WHOLE_SIZE
+      );
+
+      auto ret = Readback{
+        .bytes = std::vector<std::byte>(size),
+        .size = get_size(),
+        .format = format_v,
+      };
+      std::memcpy(ret.bytes.data(), readback_buffer.get().mapped, size);
+      return ret;
+    }
+
+  private:
+    VmaAllocator allocator{};
+    std::uint32_t queue_family{};
+    vk::Extent2D extent;
+    vma::Image image;
+    vk::UniqueImageView image_view;
+  };
+} // namespace framework
@@ -0,0 +1,141 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+export module framework:parallel_recorder;
+import :resource_buffering;
+import :thread_pool;
+
+namespace framework {
+  /// Records draw commands into a secondary command buffer, inside the
+  /// scene's dynamic rendering scope. Dynamic state is not inherited from
+  /// the primary command buffer: each task must bind its own state, eg with
+  /// ShaderProgram::bind().
+  export using DrawTask = std::function<void(vk::CommandBuffer const)>;
+
+  struct ParallelRecorderCreateInfo {
+    vk::Device device;
+    std::uint32_t queue_family{};
+    std::size_t buffering{resource_buffering};
+    std::size_t thread_count{ThreadPool::default_thread_count()};
+  };
+
+  /// Splits a frame's draw work across worker threads.
+  /// Each worker owns one command pool per virtual frame, and the recorded
+  /// secondary command buffers are returned in task order, so execution
+  /// order is deterministic regardless of which thread recorded what.
+  export class ParallelRecorder {
+  public:
+    using CreateInfo = ParallelRecorderCreateInfo;
+
+    explicit ParallelRecorder(CreateInfo const &create_info) :
+      device(create_info.device),
+      pools(create_info.buffering),
+      workers(create_info.thread_count) {
+      auto command_pool_info =
+        vk::CommandPoolCreateInfo()
+          .setQueueFamilyIndex(create_info.queue_family)
+          // Reset all at once at the start of each frame.
+          .setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+
+      for (auto &frame_pools : pools) {
+        frame_pools.resize(workers.thread_count());
+        for (auto &thread_pool : frame_pools) {
+          thread_pool.pool = device.createCommandPoolUnique(command_pool_info);
+        }
+      }
+    }
+
+    [[nodiscard]] auto thread_count() const -> std::size_t {
+      return workers.thread_count();
+    }
+
+    /// Records every task into its own secondary command buffer, blocking
+    /// until all are recorded. The virtual frame at frame_index must have
+    /// retired. rendering must describe the attachments of the
+    /// beginRendering() scope these will be executed in, which must use
+    /// vk::RenderingFlagBits::eContentsSecondaryCommandBuffers.
+    [[nodiscard]] auto record(
+      std::size_t const frame_index,
+      vk::CommandBufferInheritanceRenderingInfo const &rendering,
+      std::span<DrawTask const> tasks
+    ) -> std::span<vk::CommandBuffer const> {
+      auto &frame_pools = pools.at(frame_index);
+      for (auto &thread_pool : frame_pools) {
+        device.resetCommandPool(*thread_pool.pool);
+        thread_pool.used = 0;
+      }
+
+      recorded.assign(tasks.size(), vk::CommandBuffer{});
+
+      for (auto index = 0uz; index < tasks.size(); ++index) {
+        workers.enqueue(
+          [this, &frame_pools, &rendering, &tasks, index](
+            std::size_t const thread_index
+          ) {
+            auto &thread_pool = frame_pools.at(thread_index);
+            auto const command_buffer = next_command_buffer(thread_pool);
+
+            auto inheritance_rendering = rendering;
+            auto inheritance_info =
+              vk::CommandBufferInheritanceInfo().setPNext(
+                &inheritance_rendering
+              );
+            auto begin_info =
+              vk::CommandBufferBeginInfo()
+                .setFlags(
+                  vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                  vk::CommandBufferUsageFlagBits::eRenderPassContinue
+                )
+                .setPInheritanceInfo(&inheritance_info);
+
+            command_buffer.begin(begin_info);
+            tasks[index](command_buffer);
+            command_buffer.end();
+
+            recorded[index] = command_buffer;
+          }
+        );
+      }
+
+      workers.wait_idle();
+
+      return recorded;
+    }
+
+  private:
+    struct ThreadCommandPool {
+      vk::UniqueCommandPool pool;
+      // Allocated once, reused every time this pool is reset.
+      std::vector<vk::CommandBuffer> buffers;
+      std::size_t used{};
+    };
+
+    auto next_command_buffer(ThreadCommandPool &thread_pool) const
+      -> vk::CommandBuffer {
+      if (thread_pool.used == thread_pool.buffers.size()) {
+        auto allocate_info = vk::CommandBufferAllocateInfo()
+                               .setCommandPool(*thread_pool.pool)
+                               .setCommandBufferCount(1)
+                               .setLevel(vk::CommandBufferLevel::eSecondary);
+        thread_pool.buffers.push_back(
+          device.allocateCommandBuffers(allocate_info).front()
+        );
+      }
+
+      return thread_pool.buffers.at(thread_pool.used++);
+    }
+
+    vk::Device device;
+    // One pool per worker thread, per virtual frame.
+    Buffered<std::vector<ThreadCommandPool>> pools;
+    std::vector<vk::CommandBuffer> recorded;
+
+    // Declared last: joined before the pools are destroyed.
+    ThreadPool workers;
+  };
+} // namespace framework
@@ -0,0 +1,896 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+
+export module framework:render_graph;
+import :gpu_profiler;
+import :resource_buffering;
+import :trace;
+import :vma;
+
+namespace {
+  // Color image with 1 layer and 1 mip-level.
+  constexpr auto color_range_v = [] {
+    return vk::ImageSubresourceRange()
+      .setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setLayerCount(1)
+      .setLevelCount(1);
+  }();
+
+  constexpr auto write_access_v = vk::AccessFlagBits2::eShaderWrite |
+    vk::AccessFlagBits2::eShaderStorageWrite |
+    vk::AccessFlagBits2::eColorAttachmentWrite |
+    vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+    vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite |
+    vk::AccessFlagBits2::eMemoryWrite;
+
+  [[nodiscard]] constexpr auto is_write(vk::AccessFlags2 const access)
+    -> bool {
+    return static_cast<bool>(access & write_access_v);
+  }
+} // namespace
+
+namespace framework {
+  /// How a pass accesses a resource.
+  export enum class ResourceUsage : std::int8_t {
+    ColorAttachment,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+    VertexBuffer,
+    IndexBuffer,
+    UniformBuffer,
+    Present,
+  };
+
+  /// Pipeline stages, access and (for images) layout of a resource access.
+  export struct ResourceState {
+    vk::PipelineStageFlags2 stages;
+    vk::AccessFlags2 access;
+    vk::ImageLayout layout{vk::ImageLayout::eUndefined};
+  };
+
+  export [[nodiscard]] constexpr auto get_resource_state(
+    ResourceUsage const usage
+  ) -> ResourceState {
+    using Stage = vk::PipelineStageFlagBits2;
+    using Access = vk::AccessFlagBits2;
+    using Layout = vk::ImageLayout;
+
+    switch (usage) {
+      case ResourceUsage::ColorAttachment:
+        return {
+          Stage::eColorAttachmentOutput,
+          Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+          Layout::eAttachmentOptimal,
+        };
+      case ResourceUsage::Sampled:
+        return {
+          Stage::eFragmentShader,
+          Access::eShaderSampledRead,
+          Layout::eShaderReadOnlyOptimal,
+        };
+      case ResourceUsage::StorageRead:
+        return {
+          Stage::eComputeShader | Stage::eFragmentShader,
+          Access::eShaderStorageRead,
+          Layout::eGeneral,
+        };
+      case ResourceUsage::StorageWrite:
+        return {
+          Stage::eComputeShader | Stage::eFragmentShader,
+          Access::eShaderStorageRead | Access::eShaderStorageWrite,
+          Layout::eGeneral,
+        };
+      case ResourceUsage::TransferSrc:
+        return {
+          Stage::eCopy | Stage::eBlit,
+          Access::eTransferRead,
+          Layout::eTransferSrcOptimal,
+        };
+      case ResourceUsage::TransferDst:
+        return {
+          Stage::eCopy | Stage::eBlit | Stage::eClear,
+          Access::eTransferWrite,
+          Layout::eTransferDstOptimal,
+        };
+      case ResourceUsage::VertexBuffer:
+        return {Stage::eVertexAttributeInput, Access::eVertexAttributeRead};
+      case ResourceUsage::IndexBuffer:
+        return {Stage::eIndexInput, Access::eIndexRead};
+      case ResourceUsage::UniformBuffer:
+        return {
+          Stage::eVertexShader | Stage::eFragmentShader,
+          Access::eUniformRead,
+        };
+      case ResourceUsage::Present:
+        // Presentation is ordered by the semaphore signalled at the end of
+        // the submission, which waits for this stage.
+        return {
+          Stage::eColorAttachmentOutput,
+          Access::eNone,
+          Layout::ePresentSrcKHR,
+        };
+    }
+    return {};
+  }
+
+  export struct ImageHandle {
+    std::uint32_t index{~0u};
+  };
+
+  export struct BufferHandle {
+    std::uint32_t index{~0u};
+  };
+
+  /// An image owned outside the graph, eg a Swapchain image.
+  export struct ImportedImage {
+    vk::Image image;
+    vk::ImageView image_view;
+    vk::Extent2D extent;
+    vk::Format format{};
+    vk::ImageSubresourceRange subresource_range{color_range_v};
+    /// Last access before this frame. An Undefined layout discards contents.
+    ResourceState initial{};
+    /// Left in this state at the end of the frame. Passes contributing to an
+    /// image with a final usage are never culled.
+    std::optional<ResourceUsage> final_usage;
+  };
+
+  /// A color image owned by the graph, only valid during execute(). Memory
+  /// is reused across frames (and passes may not rely on its contents from
+  /// a previous frame), and shared with transients used by other passes.
+  export struct TransientImage {
+    vk::Extent2D extent;
+    vk::Format format{};
+  };
+
+  export struct ImportedBuffer {
+    vk::Buffer buffer;
+    ResourceState initial{};
+    std::optional<ResourceUsage> final_usage;
+  };
+
+  export struct ColorAttachment {
+    ImageHandle image;
+    /// eLoad also makes the pass read the image.
+    vk::AttachmentLoadOp load_op{vk::AttachmentLoadOp::eClear};
+    vk::ClearColorValue clear_value{0.0f, 0.0f, 0.0f, 1.0f};
+  };
+
+  export struct ImageUse {
+    ImageHandle image;
+    ResourceUsage usage{};
+  };
+
+  export struct BufferUse {
+    BufferHandle buffer;
+    ResourceUsage usage{};
+  };
+
+  /// A unit of GPU work and the resources it accesses. With color
+  /// attachments, record is called inside a beginRendering() scope over
+  /// them (all attachments must have the same extent).
+  export struct GraphPass {
+    /// Must outlive the frame (eg a string literal).
+    std::string_view name;
+    std::vector<ColorAttachment> color_attachments;
+    std::vector<ImageUse> images;
+    std::vector<BufferUse> buffers;
+    vk::RenderingFlags rendering_flags{};
+    /// Never culled, even if nothing reads its outputs.
+    bool has_side_effects{};
+    std::function<void(vk::CommandBuffer const)> record;
+  };
+
+  struct RenderGraphCreateInfo {
+    vk::Device device;
+    VmaAllocator allocator;
+    std::uint32_t queue_family;
+    std::size_t buffering{resource_buffering};
+    // Transients whose live passes don't overlap share memory.
+    bool alias_transients{true};
+  };
+
+  /// Memory of the transient images of the last executed frame.
+  export struct TransientStats {
+    std::size_t images{};
+    // Allocations backing them: fewer than images when aliased.
+    std::size_t allocations{};
+    // Only ever used as attachments, in lazily allocated memory: not
+    // counted in the bytes below.
+    std::size_t lazy_images{};
+    // Sum of the images' memory requirements, ie without aliasing.
+    vk::DeviceSize required_bytes{};
+    vk::DeviceSize allocated_bytes{};
+
+    // Alignment padding can make allocations larger than required.
+    [[nodiscard]] auto saved_bytes() const -> vk::DeviceSize {
+      return required_bytes > allocated_bytes
+        ? required_bytes - allocated_bytes
+        : 0;
+    }
+  };
+
+  /// Records a frame as passes declaring the resources they access.
+  /// execute() culls passes that contribute nothing to the frame's outputs,
+  /// and records one batched barrier before each pass with the precise
+  /// stages, access and layouts its accesses need.
+  /// Transients are bound into memory shared by those whose live passes
+  /// don't overlap, each one's first access waiting for the last access to
+  /// the memory through the others.
+  /// Rebuilt every frame: resources and passes are cleared by execute().
+  export class RenderGraph {
+  public:
+    using CreateInfo = RenderGraphCreateInfo;
+
+    explicit RenderGraph(CreateInfo const &create_info) :
+      device(create_info.device),
+      allocator(create_info.allocator),
+      queue_family(create_info.queue_family),
+      buffering(create_info.buffering),
+      alias_transients(create_info.alias_transients),
+      lazy_memory(vma::has_lazy_memory(create_info.allocator)) {}
+
+    auto import_image(ImportedImage const &imported) -> ImageHandle {
+      images.push_back(Image{
+        .image = imported.image,
+        .image_view = imported.image_view,
+        .extent = imported.extent,
+        .format = imported.format,
+        .subresource_range = imported.subresource_range,
+        .tracking = Tracking::from(imported.initial),
+        .final_usage = imported.final_usage,
+      });
+      return {static_cast<std::uint32_t>(images.size() - 1)};
+    }
+
+    auto create_image(TransientImage const &transient) -> ImageHandle {
+      images.push_back(Image{
+        .extent = transient.extent,
+        .format = transient.format,
+        .subresource_range = color_range_v,
+        .is_transient = true,
+      });
+      return {static_cast<std::uint32_t>(images.size() - 1)};
+    }
+
+    auto import_buffer(ImportedBuffer const &imported) -> BufferHandle {
+      buffers.push_back(Buffer{
+        .buffer = imported.buffer,
+        .tracking = Tracking::from(imported.initial),
+        .final_usage = imported.final_usage,
+      });
+      return {static_cast<std::uint32_t>(buffers.size() - 1)};
+    }
+
+    void add_pass(GraphPass pass) {
+      passes.push_back(std::move(pass));
+    }
+
+    /// Valid during execute(), eg to write descriptors of a transient.
+    [[nodiscard]] auto get_image(ImageHandle const handle) const -> vk::Image {
+      return images.at(handle.index).image;
+    }
+
+    [[nodiscard]] auto get_image_view(ImageHandle const handle) const
+      -> vk::ImageView {
+      return images.at(handle.index).image_view;
+    }
+
+    [[nodiscard]] auto get_transient_stats() const -> TransientStats const & {
+      return transient_stats;
+    }
+
+    /// Records all live passes, wrapped in profiler scopes if profiler is
+    /// not null, then clears the graph.
+    void execute(
+      vk::CommandBuffer const command_buffer, GpuProfiler *profiler = nullptr
+    ) {
+      auto const span = trace::Span{"RenderGraph::execute"};
+
+      auto const live = cull();
+      allocate_transients(live);
+
+      for (auto const [index, pass] : std::views::enumerate(passes)) {
+        auto const pass_index = static_cast<std::size_t>(index);
+        if (!live.at(pass_index)) continue;
+
+        begin_transients(pass_index);
+        add_barriers(pass);
+        flush_barriers(command_buffer);
+
+        if (profiler != nullptr) {
+          auto const scope = profiler->scope(command_buffer, pass.name);
+          record(command_buffer, pass);
+        } else {
+          record(command_buffer, pass);
+        }
+        end_transients(pass_index);
+      }
+
+      for (auto &image : images) {
+        if (!image.final_usage) continue;
+        add_barrier(image, get_resource_state(*image.final_usage), false);
+      }
+      for (auto &buffer : buffers) {
+        if (!buffer.final_usage) continue;
+        add_barrier(buffer, get_resource_state(*buffer.final_usage));
+      }
+      flush_barriers(command_buffer);
+
+      release_transients();
+      ++frame;
+    }
+
+  private:
+    // Synchronization state of a resource during a frame.
+    struct Tracking {
+      // Stages and access of the last write (or layout transition).
+      vk::PipelineStageFlags2 write_stages;
+      vk::AccessFlags2 write_access;
+      // Stages that read since the last write.
+      vk::PipelineStageFlags2 read_stages;
+      // Scopes the last write has been made visible to.
+      vk::PipelineStageFlags2 visible_stages;
+      vk::AccessFlags2 visible_access;
+      vk::ImageLayout layout{vk::ImageLayout::eUndefined};
+
+      static auto from(ResourceState const &state) -> Tracking {
+        auto ret = Tracking{.layout = state.layout};
+        if (is_write(state.access)) {
+          ret.write_stages = state.stages;
+          ret.write_access = state.access;
+        } else {
+          ret.read_stages = state.stages;
+        }
+        return ret;
+      }
+    };
+
+    // Source and destination scopes of a barrier.
+    struct Dependency {
+      vk::PipelineStageFlags2 src_stages;
+      vk::AccessFlags2 src_access;
+      vk::PipelineStageFlags2 dst_stages;
+      vk::AccessFlags2 dst_access;
+      vk::ImageLayout old_layout;
+      vk::ImageLayout new_layout;
+    };
+
+    // First and last live pass using a transient.
+    struct PassRange {
+      std::size_t first{};
+      std::size_t last{};
+
+      [[nodiscard]] auto overlaps(PassRange const &rhs) const -> bool {
+        return first <= rhs.last && rhs.first <= last;
+      }
+    };
+
+    struct Image {
+      vk::Image image;
+      vk::ImageView image_view;
+      vk::Extent2D extent;
+      vk::Format format{};
+      vk::ImageSubresourceRange subresource_range;
+      Tracking tracking{};
+      std::optional<ResourceUsage> final_usage;
+      bool is_transient{};
+      // Index into the transient cache, when allocated.
+      std::optional<std::size_t> cached;
+      PassRange range{};
+    };
+
+    struct Buffer {
+      vk::Buffer buffer;
+      Tracking tracking{};
+      std::optional<ResourceUsage> final_usage;
+    };
+
+    // Memory shared by the transients bound to it.
+    struct MemoryBlock {
+      vma::Allocation allocation;
+      vk::DeviceSize alignment{};
+      // Last access to the memory through any of its images, to order the
+      // next one after it (in this frame or the next).
+      Tracking tracking{};
+      // Live passes of this frame's images bound to it.
+      std::vector<PassRange> ranges;
+      std::uint64_t last_frame{};
+      bool is_lazy{};
+
+      [[nodiscard]] auto is_free(PassRange const &range) const -> bool {
+        return std::ranges::none_of(ranges, [&](PassRange const &used) {
+          return used.overlaps(range);
+        });
+      }
+    };
+
+    struct CachedImage {
+      vk::UniqueImage image;
+      vk::UniqueImageView image_view;
+      vk::Extent2D extent;
+      vk::Format format{};
+      vk::ImageUsageFlags usage;
+      vk::MemoryRequirements requirements;
+      MemoryBlock *block{};
+      std::uint64_t last_frame{};
+      bool in_use{};
+    };
+
+    // Returns the barrier needed before an access in state next, if any,
+    // and updates tracking as if it was recorded.
+    static auto transition(
+      Tracking &tracking, ResourceState const &next, bool const discard
+    ) -> std::optional<Dependency> {
+      auto const writes = is_write(next.access);
+      auto const layout_change = next.layout != tracking.layout;
+      auto ret = Dependency{
+        .dst_stages = next.stages,
+        .dst_access = next.access,
+        .old_layout = discard ? vk::ImageLayout::eUndefined : tracking.layout,
+        .new_layout = next.layout,
+      };
+
+      if (writes || layout_change) {
+        // Write after read only needs an execution dependency on the readers
+        // (which already waited for the previous write).
+        if (tracking.read_stages) {
+          ret.src_stages = tracking.read_stages;
+        } else {
+          ret.src_stages = tracking.write_stages;
+          ret.src_access = tracking.write_access & write_access_v;
+        }
+
+        // A layout transition is a write, made visible to this access.
+        tracking = Tracking{
+          .write_stages = next.stages,
+          .write_access = writes ? next.access : vk::AccessFlags2{},
+          .layout = next.layout,
+        };
+        if (!writes) {
+          tracking.read_stages = next.stages;
+          tracking.visible_stages = next.stages;
+          tracking.visible_access = next.access;
+        }
+
+        if (!ret.src_stages && !layout_change) return {};
+        return ret;
+      }
+
+      tracking.read_stages |= next.stages;
+
+      // Read after write: make the write visible once per reading scope.
+      auto const is_visible = !(next.stages & ~tracking.visible_stages) &&
+        !(next.access & ~tracking.visible_access);
+      if (!tracking.write_stages || is_visible) return {};
+
+      ret.src_stages = tracking.write_stages;
+      ret.src_access = tracking.write_access & write_access_v;
+      tracking.visible_stages |= next.stages;
+      tracking.visible_access |= next.access;
+      return ret;
+    }
+
+    // Marks passes contributing to a final usage (or with side effects),
+    // walking back from the last pass.
+    [[nodiscard]] auto cull() const -> std::vector<bool> {
+      auto needed_images = std::vector<bool>(images.size());
+      auto needed_buffers = std::vector<bool>(buffers.size());
+      for (auto const [index, image] : std::views::enumerate(images)) {
+        needed_images.at(static_cast<std::size_t>(index)) =
+          image.final_usage.has_value();
+      }
+      for (auto const [index, buffer] : std::views::enumerate(buffers)) {
+        needed_buffers.at(static_cast<std::size_t>(index)) =
+          buffer.final_usage.has_value();
+      }
+
+      auto ret = std::vector<bool>(passes.size());
+      for (auto index = passes.size(); index-- > 0;) {
+        auto const &pass = passes.at(index);
+
+        auto is_live = pass.has_side_effects;
+        for (auto const &attachment : pass.color_attachments) {
+          is_live = is_live || needed_images.at(attachment.image.index);
+        }
+        for (auto const &use : pass.images) {
+          auto const writes = is_write(get_resource_state(use.usage).access);
+          is_live = is_live || (writes && needed_images.at(use.image.index));
+        }
+        for (auto const &use : pass.buffers) {
+          auto const writes = is_write(get_resource_state(use.usage).access);
+          is_live = is_live || (writes && needed_buffers.at(use.buffer.index));
+        }
+        if (!is_live) continue;
+
+        ret.at(index) = true;
+        // Cleared attachments don't need earlier contents, other writes may
+        // be partial and keep earlier writers alive.
+        for (auto const &attachment : pass.color_attachments) {
+          needed_images.at(attachment.image.index) =
+            attachment.load_op == vk::AttachmentLoadOp::eLoad;
+        }
+        for (auto const &use : pass.images) {
+          needed_images.at(use.image.index) = true;
+        }
+        for (auto const &use : pass.buffers) {
+          needed_buffers.at(use.buffer.index) = true;
+        }
+      }
+
+      return ret;
+    }
+
+    void allocate_transients(std::span<bool const> live) {
+      // Usage and live passes of each transient.
+      auto usages = std::vector<vk::ImageUsageFlags>(images.size());
+      auto ranges = std::vector<std::optional<PassRange>>(images.size());
+      auto const add_use = [&](ImageHandle const handle,
+                           vk::ImageUsageFlags const usage,
+                           std::size_t const pass_index) {
+        usages.at(handle.index) |= usage;
+        auto &range = ranges.at(handle.index);
+        if (!range) range = PassRange{.first = pass_index};
+        range->last = pass_index;
+      };
+      for (auto const [index, pass] : std::views::enumerate(passes)) {
+        auto const pass_index = static_cast<std::size_t>(index);
+        if (!live[pass_index]) continue;
+        for (auto const &attachment : pass.color_attachments) {
+          add_use(
+            attachment.image,
+            vk::ImageUsageFlagBits::eColorAttachment,
+            pass_index
+          );
+        }
+        for (auto const &use : pass.images) {
+          add_use(use.image, get_image_usage(use.usage), pass_index);
+        }
+      }
+
+      // In order of first use: earlier (eg full size) images create the
+      // blocks later ones fit into.
+      auto order = std::vector<std::size_t>{};
+      for (auto index = 0uz; index < images.size(); ++index) {
+        if (images.at(index).is_transient && usages.at(index)) {
+          order.push_back(index);
+        }
+      }
+      std::ranges::sort(order, {}, [&](std::size_t const index) {
+        return ranges.at(index)->first;
+      });
+
+      transient_stats = {};
+      for (auto const index : order) {
+        auto &image = images.at(index);
+        image.range = *ranges.at(index);
+        auto const cache_index = acquire_transient(image, usages.at(index));
+
+        auto const &cached = cache.at(cache_index);
+        image.image = *cached.image;
+        image.image_view = *cached.image_view;
+        image.cached = cache_index;
+
+        ++transient_stats.images;
+        if (cached.block->is_lazy) {
+          ++transient_stats.lazy_images;
+        } else {
+          transient_stats.required_bytes += cached.requirements.size;
+        }
+      }
+      for (auto const &block : blocks) {
+        if (block->ranges.empty()) continue;
+        ++transient_stats.allocations;
+        if (!block->is_lazy) {
+          transient_stats.allocated_bytes += block->allocation.get().size;
+        }
+      }
+    }
+
+    auto acquire_transient(Image const &image, vk::ImageUsageFlags const usage)
+      -> std::size_t {
+      auto const is_match = [&](CachedImage const &cached) {
+        return !cached.in_use && cached.extent == image.extent &&
+          cached.format == image.format && cached.usage == usage &&
+          cached.block->is_free(image.range);
+      };
+
+      auto const it = std::ranges::find_if(cache, is_match);
+      if (it != cache.end()) {
+        it->in_use = true;
+        it->block->ranges.push_back(image.range);
+        return static_cast<std::size_t>(std::distance(cache.begin(), it));
+      }
+
+      // Only ever an attachment: its contents can stay in tile memory.
+      auto const is_lazy =
+        lazy_memory && usage == vk::ImageUsageFlagBits::eColorAttachment;
+      auto image_usage = usage;
+      if (is_lazy) image_usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+
+      auto const image_ci =
+        vk::ImageCreateInfo()
+          .setImageType(vk::ImageType::e2D)
+          .setExtent({image.extent.width, image.extent.height, 1})
+          .setFormat(image.format)
+          .setUsage(image_usage)
+          .setArrayLayers(1)
+          .setMipLevels(1)
+          .setSamples(vk::SampleCountFlagBits::e1)
+          .setTiling(vk::ImageTiling::eOptimal)
+          .setInitialLayout(vk::ImageLayout::eUndefined)
+          .setQueueFamilyIndices(queue_family);
+
+      auto cached = CachedImage{
+        .image = device.createImageUnique(image_ci),
+        .extent = image.extent,
+        .format = image.format,
+        .usage = usage,
+        .in_use = true,
+      };
+      cached.requirements = device.getImageMemoryRequirements(*cached.image);
+      cached.block = acquire_block(cached.requirements, image.range, is_lazy);
+
+      auto const &allocation = cached.block->allocation.get();
+      auto const result = vmaBindImageMemory(
+        allocation.allocator, allocation.allocation, *cached.image
+      );
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error{"Failed to bind Transient Image"};
+      }
+
+      auto image_view_info = vk::ImageViewCreateInfo()
+                               .setImage(*cached.image)
+                               .setViewType(vk::ImageViewType::e2D)
+                               .setFormat(image.format)
+                               .setSubresourceRange(color_range_v);
+      cached.image_view = device.createImageViewUnique(image_view_info);
+
+      cache.push_back(std::move(cached));
+      return cache.size() - 1;
+    }
+
+    // Returns a block requirements fit into, free over range: shared with
+    // other transients when aliasing, else a new one.
+    auto acquire_block(
+      vk::MemoryRequirements const &requirements,
+      PassRange const &range,
+      bool const is_lazy
+    ) -> MemoryBlock * {
+      auto const fits = [&](auto const &block) {
+        auto const &allocation = block->allocation.get();
+        return !block->is_lazy && block->is_free(range) &&
+          allocation.size >= requirements.size &&
+          block->alignment >= requirements.alignment &&
+          (requirements.memoryTypeBits & (1u << allocation.memory_type)) != 0;
+      };
+
+      if (alias_transients && !is_lazy) {
+        auto const it = std::ranges::find_if(blocks, fits);
+        if (it != blocks.end()) {
+          (*it)->ranges.push_back(range);
+          return it->get();
+        }
+      }
+
+      auto allocation = vma::allocate_memory(
+        allocator, requirements, vma::MemoryTag::Attachment, is_lazy
+      );
+      if (!allocation.get().allocation) {
+        throw std::runtime_error{"Failed to allocate Transient Memory"};
+      }
+
+      auto block = std::make_unique<MemoryBlock>(MemoryBlock{
+        .allocation = std::move(allocation),
+        .alignment = requirements.alignment,
+        .ranges = {range},
+        .is_lazy = is_lazy,
+      });
+      blocks.push_back(std::move(block));
+      return blocks.back().get();
+    }
+
+    // Orders the first access to each transient used from pass_index on
+    // after the last access to its memory (through another image).
+    void begin_transients(std::size_t const pass_index) {
+      for (auto &image : images) {
+        if (!image.cached || image.range.first != pass_index) continue;
+        image.tracking = cache.at(*image.cached).block->tracking;
+        // Contents of other images (or the previous frame) are never kept.
+        image.tracking.layout = vk::ImageLayout::eUndefined;
+      }
+    }
+
+    void end_transients(std::size_t const pass_index) {
+      for (auto const &image : images) {
+        if (!image.cached || image.range.last != pass_index) continue;
+        cache.at(*image.cached).block->tracking = image.tracking;
+      }
+    }
+
+    void release_transients() {
+      for (auto const &image : images) {
+        if (!image.cached) continue;
+        auto &cached = cache.at(*image.cached);
+        cached.last_frame = frame;
+        cached.in_use = false;
+        cached.block->last_frame = frame;
+      }
+      for (auto &block : blocks) block->ranges.clear();
+
+      // Unused for longer than any frame can be in flight: safe to destroy,
+      // images first.
+      std::erase_if(cache, [this](CachedImage const &cached) {
+        return cached.last_frame + buffering < frame;
+      });
+      std::erase_if(blocks, [this](std::unique_ptr<MemoryBlock> const &block) {
+        auto const is_bound = std::ranges::any_of(
+          cache,
+          [&](CachedImage const &cached) { return cached.block == block.get(); }
+        );
+        return !is_bound && block->last_frame + buffering < frame;
+      });
+
+      images.clear();
+      buffers.clear();
+      passes.clear();
+    }
+
+    [[nodiscard]] static auto get_image_usage(ResourceUsage const usage)
+      -> vk::ImageUsageFlags {
+      switch (usage) {
+        case ResourceUsage::ColorAttachment:
+          return vk::ImageUsageFlagBits::eColorAttachment;
+        case ResourceUsage::Sampled:
+          return vk::ImageUsageFlagBits::eSampled;
+        case ResourceUsage::StorageRead:
+        case ResourceUsage::StorageWrite:
+          return vk::ImageUsageFlagBits::eStorage;
+        case ResourceUsage::TransferSrc:
+          return vk::ImageUsageFlagBits::eTransferSrc;
+        case ResourceUsage::TransferDst:
+          return vk::ImageUsageFlagBits::eTransferDst;
+        default:
+          return {};
+      }
+    }
+
+    void add_barriers(GraphPass const &pass) {
+      for (auto const &attachment : pass.color_attachments) {
+        auto state = get_resource_state(ResourceUsage::ColorAttachment);
+        auto const discard = attachment.load_op != vk::AttachmentLoadOp::eLoad;
+        if (discard) state.access = vk::AccessFlagBits2::eColorAttachmentWrite;
+        add_barrier(images.at(attachment.image.index), state, discard);
+      }
+      for (auto const &use : pass.images) {
+        auto const state = get_resource_state(use.usage);
+        add_barrier(images.at(use.image.index), state, false);
+      }
+      for (auto const &use : pass.buffers) {
+        auto const state = get_resource_state(use.usage);
+        add_barrier(buffers.at(use.buffer.index), state);
+      }
+    }
+
+    void add_barrier(
+      Image &image, ResourceState const &next, bool const discard
+    ) {
+      auto const dependency = transition(image.tracking, next, discard);
+      if (!dependency) return;
+
+      image_barriers.push_back(
+        vk::ImageMemoryBarrier2()
+          .setImage(image.image)
+          .setSubresourceRange(image.subresource_range)
+          .setSrcQueueFamilyIndex(queue_family)
+          .setDstQueueFamilyIndex(queue_family)
+          .setSrcStageMask(dependency->src_stages)
+          .setSrcAccessMask(dependency->src_access)
+          .setDstStageMask(dependency->dst_stages)
+          .setDstAccessMask(dependency->dst_access)
+          .setOldLayout(dependency->old_layout)
+          .setNewLayout(dependency->new_layout)
+      );
+    }
+
+    void add_barrier(Buffer &buffer, ResourceState const &next) {
+      auto const dependency = transition(buffer.tracking, next, false);
+      if (!dependency) return;
+
+      buffer_barriers.push_back(
+        vk::BufferMemoryBarrier2()
+          .setBuffer(buffer.buffer)
+          .setSize(VK_WHOLE_SIZE)
+          .setSrcQueueFamilyIndex(queue_family)
+          .setDstQueueFamilyIndex(queue_family)
+          .setSrcStageMask(dependency->src_stages)
+          .setSrcAccessMask(dependency->src_access)
+          .setDstStageMask(dependency->dst_stages)
+          .setDstAccessMask(dependency->dst_access)
+      );
+    }
+
+    // Records all pending barriers as one dependency.
+    void flush_barriers(vk::CommandBuffer const command_buffer) {
+      if (image_barriers.empty() && buffer_barriers.empty()) return;
+
+      auto dependency_info = vk::DependencyInfo()
+                               .setImageMemoryBarriers(image_barriers)
+                               .setBufferMemoryBarriers(buffer_barriers);
+      command_buffer.pipelineBarrier2(dependency_info);
+
+      image_barriers.clear();
+      buffer_barriers.clear();
+    }
+
+    void record(vk::CommandBuffer const command_buffer, GraphPass const &pass) {
+      if (pass.color_attachments.empty()) {
+        if (pass.record) pass.record(command_buffer);
+        return;
+      }
+
+      attachments.clear();
+      for (auto const &attachment : pass.color_attachments) {
+        attachments.push_back(
+          vk::RenderingAttachmentInfo()
+            .setImageView(images.at(attachment.image.index).image_view)
+            .setImageLayout(vk::ImageLayout::eAttachmentOptimal)
+            .setLoadOp(attachment.load_op)
+            .setStoreOp(vk::AttachmentStoreOp::eStore)
+            .setClearValue(attachment.clear_value)
+        );
+      }
+
+      auto const extent =
+        images.at(pass.color_attachments.front().image.index).extent;
+      auto const rendering_info =
+        vk::RenderingInfo()
+          .setFlags(pass.rendering_flags)
+          .setRenderArea(vk::Rect2D{vk::Offset2D{}, extent})
+          .setColorAttachments(attachments)
+          .setLayerCount(1);
+
+      command_buffer.beginRendering(rendering_info);
+      if (pass.record) pass.record(command_buffer);
+      command_buffer.endRendering();
+    }
+
+    vk::Device device;
+    VmaAllocator allocator{};
+    std::uint32_t queue_family{};
+    std::size_t buffering{};
+
+    // Built every frame.
+    std::vector<Image> images;
+    std::vector<Buffer> buffers;
+    std::vector<GraphPass> passes;
+
+    // Scratch storage reused across passes.
+    std::vector<vk::ImageMemoryBarrier2> image_barriers;
+    std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+    std::vector<vk::RenderingAttachmentInfo> attachments;
+
+    // Declared before the cache: its images are destroyed first.
+    std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    std::vector<CachedImage> cache;
+    TransientStats transient_stats{};
+    std::uint64_t frame{};
+    bool alias_transients{};
+    bool lazy_memory{};
+  };
+} // namespace framework
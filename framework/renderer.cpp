@@ -4,27 +4,53 @@ module;
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_hpp_macros.hpp>
+#include <algorithm>
 #include <chrono>
+#include <concepts>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
 #include <format>
 #include <functional>
 #include <imgui.h>
 #include <print>
 #include <ranges>
+#include <vector>
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 export module framework:renderer;
+import :bindless_table;
+import :command_block;
 import :dear_imgui;
+import :deferred_queue;
+import :defragmenter;
+import :frame_stats;
 import :gpu;
+import :gpu_profiler;
+import :memory_stats;
+import :offscreen;
+import :parallel_recorder;
+import :render_graph;
 import :resource_buffering;
+import :sampler_cache;
 import :scoped_waiter;
+import :staging_ring;
 import :swapchain;
+import :thread_pool;
+import :timeline;
+import :trace;
+import :uniform_arena;
+import :upload;
 import :vma;
 import :window;
 
 using namespace std::chrono_literals;
 
 namespace {
+  // Measured frames of a benchmark run setting only LVK_BENCH_WARMUP.
+  constexpr auto bench_frames_v = std::uint64_t{1000};
+
   [[nodiscard]] auto get_valid_layers(std::span<char const *const> desired)
     -> std::vector<char const *> {
     auto layers = std::vector<char const *>{};
@@ -47,50 +73,278 @@ namespace {
 
     return layers;
   }
+
+  // Returns the value of an environment variable, if set and not empty.
+  [[nodiscard]] auto get_env(char const *name)
+    -> std::optional<std::string_view> {
+    auto const *value = std::getenv(name);
+    if (value == nullptr || *value == '\0') return {};
+    return value;
+  }
+
+  // Parses a comma separated list of present modes, eg "mailbox,fifo".
+  [[nodiscard]] auto parse_present_modes(std::string_view const value)
+    -> std::vector<vk::PresentModeKHR> {
+    auto ret = std::vector<vk::PresentModeKHR>{};
+    for (auto const part : std::views::split(value, ',')) {
+      auto const name = std::string_view{part};
+      if (name == "fifo") {
+        ret.push_back(vk::PresentModeKHR::eFifo);
+      } else if (name == "fifo_relaxed") {
+        ret.push_back(vk::PresentModeKHR::eFifoRelaxed);
+      } else if (name == "mailbox") {
+        ret.push_back(vk::PresentModeKHR::eMailbox);
+      } else if (name == "immediate") {
+        ret.push_back(vk::PresentModeKHR::eImmediate);
+      } else {
+        std::println(stderr, "[lvk] Unknown present mode: '{}'", name);
+      }
+    }
+    return ret;
+  }
 } // namespace
 
 namespace framework {
+  struct RendererCreateInfo {
+    /// Render into an offscreen image: no window, surface or Swapchain.
+    bool headless{};
+    /// Window size, or offscreen image size when headless.
+    glm::ivec2 extent{1280, 720};
+    /// Stop the frame loop after this many frames (0: no limit).
+    std::uint64_t max_frames{};
+    /// Stop the frame loop after this much time (0: no limit).
+    std::chrono::duration<double> max_duration{};
+    /// Write the last rendered frame here (as PPM) once the loop ends.
+    std::filesystem::path capture_path;
+    /// Number of virtual frames: more hides CPU spikes, fewer cuts latency.
+    std::size_t frames_in_flight{resource_buffering};
+    /// Worker threads used by Renderer::run_parallel (0: one per core).
+    std::size_t recording_threads{};
+    /// Size of the staging ring all uploads share.
+    vk::DeviceSize staging_size{32 * 1024 * 1024};
+    /// Size of each virtual frame's region of the uniform arena.
+    vk::DeviceSize uniform_arena_size{4 * 1024 * 1024};
+    /// Compact tracked resources (see Renderer::defragmenter) in the
+    /// background, moving at most this many bytes per frame.
+    bool defragment{};
+    vk::DeviceSize defragment_bytes_per_pass{16 * 1024 * 1024};
+    /// Show the GPU profiler's Dear ImGui overlay.
+    bool show_gpu_profiler{};
+    /// Show the memory budget/usage Dear ImGui panel.
+    bool show_memory_stats{};
+    /// If set, VMA's detailed memory stats are written here as JSON once
+    /// the loop ends.
+    std::filesystem::path memory_stats_path;
+    /// If set, CPU trace spans are written here as Chrome JSON on exit.
+    std::filesystem::path trace_path;
+    /// Present mode preferences and Swapchain image count.
+    PresentPolicy present_policy{};
+    /// Frames rendered before timings are sampled (counted in max_frames).
+    std::uint64_t warmup_frames{};
+    /// If set, frame timing percentiles are written here as JSON.
+    std::filesystem::path stats_path;
+
+    /// Default settings overridden by environment variables:
+    /// LVK_HEADLESS, LVK_WIDTH, LVK_HEIGHT, LVK_FRAMES, LVK_DURATION (seconds),
+    /// LVK_CAPTURE (path), LVK_FRAMES_IN_FLIGHT, LVK_RECORDING_THREADS,
+    /// LVK_DEFRAG, LVK_DEFRAG_BYTES (MiB per frame),
+    /// LVK_GPU_PROFILER, LVK_MEMORY_PANEL, LVK_MEMORY_STATS (path),
+    /// LVK_TRACE_FILE (path), LVK_PRESENT_MODE (comma
+    /// separated preferences among fifo, fifo_relaxed, mailbox and immediate),
+    /// LVK_SWAPCHAIN_IMAGES, LVK_STAGING_SIZE and LVK_UNIFORM_ARENA_SIZE (MiB).
+    /// Benchmarking: LVK_BENCH_WARMUP and LVK_BENCH_FRAMES (measured frames,
+    /// after warm-up, 1000 if only the warm-up is set) set max_frames,
+    /// LVK_BENCH_OUTPUT (path) the JSON stats.
+    /// A headless run without any limit renders a single frame.
+    [[nodiscard]] static auto from_env() -> RendererCreateInfo {
+      auto ret = RendererCreateInfo{};
+
+      auto const to_number = [](std::string_view const value) {
+        return std::strtod(std::string{value}.c_str(), nullptr);
+      };
+
+      if (auto const value = get_env("LVK_HEADLESS")) {
+        ret.headless = *value != "0";
+      }
+      if (auto const value = get_env("LVK_WIDTH")) {
+        ret.extent.x = static_cast<int>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_HEIGHT")) {
+        ret.extent.y = static_cast<int>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_FRAMES")) {
+        ret.max_frames = static_cast<std::uint64_t>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_DURATION")) {
+        ret.max_duration = std::chrono::duration<double>{to_number(*value)};
+      }
+      if (auto const value = get_env("LVK_CAPTURE")) {
+        ret.capture_path = *value;
+      }
+      if (auto const value = get_env("LVK_FRAMES_IN_FLIGHT")) {
+        ret.frames_in_flight = static_cast<std::size_t>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_RECORDING_THREADS")) {
+        ret.recording_threads = static_cast<std::size_t>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_GPU_PROFILER")) {
+        ret.show_gpu_profiler = *value != "0";
+      }
+      if (auto const value = get_env("LVK_DEFRAG")) {
+        ret.defragment = *value != "0";
+      }
+      if (auto const value = get_env("LVK_DEFRAG_BYTES")) {
+        ret.defragment_bytes_per_pass =
+          static_cast<vk::DeviceSize>(to_number(*value) * 1024.0 * 1024.0);
+      }
+      if (auto const value = get_env("LVK_MEMORY_PANEL")) {
+        ret.show_memory_stats = *value != "0";
+      }
+      if (auto const value = get_env("LVK_MEMORY_STATS")) {
+        ret.memory_stats_path = *value;
+      }
+      if (auto const value = get_env("LVK_TRACE_FILE")) {
+        ret.trace_path = *value;
+      }
+      if (auto const value = get_env("LVK_PRESENT_MODE")) {
+        ret.present_policy.modes = parse_present_modes(*value);
+      }
+      if (auto const value = get_env("LVK_SWAPCHAIN_IMAGES")) {
+        ret.present_policy.image_count =
+          static_cast<std::uint32_t>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_STAGING_SIZE")) {
+        ret.staging_size =
+          static_cast<vk::DeviceSize>(to_number(*value) * 1024.0 * 1024.0);
+      }
+      if (auto const value = get_env("LVK_UNIFORM_ARENA_SIZE")) {
+        ret.uniform_arena_size =
+          static_cast<vk::DeviceSize>(to_number(*value) * 1024.0 * 1024.0);
+      }
+      if (auto const value = get_env("LVK_BENCH_WARMUP")) {
+        ret.warmup_frames = static_cast<std::uint64_t>(to_number(*value));
+      }
+      if (auto const value = get_env("LVK_BENCH_FRAMES")) {
+        ret.max_frames = ret.warmup_frames +
+          static_cast<std::uint64_t>(to_number(*value));
+      } else if (ret.warmup_frames > 0) {
+        ret.max_frames = ret.warmup_frames + bench_frames_v;
+      }
+      if (auto const value = get_env("LVK_BENCH_OUTPUT")) {
+        ret.stats_path = *value;
+      }
+
+      if (ret.headless && ret.max_frames == 0 && ret.max_duration <= 0s) {
+        ret.max_frames = 1;
+      }
+
+      return ret;
+    }
+  };
+
   export class Renderer {
   public:
+    using CreateInfo = RendererCreateInfo;
+
     struct RenderSync {
       /// Signalled when Swapchain image has been acquired
       vk::UniqueSemaphore draw;
       /// Signalled when image is ready to be presented
       vk::UniqueSemaphore present;
-      /// Signalled with present Semaphore, waited on before next render
-      vk::UniqueFence drawn;
+      /// Timeline value signalled by this frame's submission, waited on
+      /// before the next render of this virtual frame (0: never submitted)
+      std::uint64_t drawn{};
       /// Used to record rendering commands
       vk::CommandBuffer command_buffer;
+      /// When this frame started on the CPU, to measure its latency
+      std::chrono::steady_clock::time_point begun_at;
     };
 
+    CreateInfo create_info;
+
+    // Null when headless.
     glfw::Window window;
     vk::UniqueInstance instance;
     vk::UniqueSurfaceKHR surface;
     Gpu gpu{};
     vk::UniqueDevice device;
     vk::Queue queue;
+    // Dedicated transfer queue, if the GPU has one.
+    vk::Queue transfer_queue;
+    // Counts submissions on queue: every frame signals the next value.
+    Timeline timeline;
     vma::Allocator allocator;
+    // Device local memory is host visible: for vma::BufferCreateInfo's
+    // direct_write.
+    bool direct_write{};
+    // Staging memory shared by all uploads, reclaimed by timeline.
+    std::optional<StagingRing> staging;
+    // Resources dropped while frames may still use them, reclaimed by
+    // timeline.
+    DeferredQueue deferred;
 
     std::optional<Swapchain> swapchain;
+    // Rendered into instead of the Swapchain when headless.
+    std::optional<OffscreenTarget> offscreen;
     // Command pool for all render Command Buffers
     vk::UniqueCommandPool render_cmd_pool;
     // Command pool for all Command Blocks.
     vk::UniqueCommandPool cmd_block_pool;
+    // Command pool for Command Blocks on the transfer queue.
+    vk::UniqueCommandPool transfer_cmd_pool;
+    // Asynchronous uploads in flight, released in order as they complete.
+    std::deque<PendingSubmission> pending_uploads;
+    // Uploads the next frame's submission waits for.
+    std::vector<vk::SemaphoreSubmitInfo> upload_waits;
+    // Compacts the memory of resources tracked with it, when enabled by
+    // create_info.defragment.
+    std::optional<Defragmenter> defragmenter;
     // Sync and Command Buffer for virtual frames
     Buffered<RenderSync> render_sync{};
+    // Uniform/storage data pushed by draws, reset per virtual frame.
+    std::optional<UniformArena> uniforms;
+    // Samplers shared by Textures (and immutable sampler set layouts).
+    std::optional<SamplerCache> samplers;
+    // Every Texture created with it, indexed by shaders. Null without
+    // descriptor indexing.
+    std::optional<BindlessTable> bindless;
     // Current virtual frame index
     std::size_t frame_index{};
+    // Total number of frames submitted
+    std::uint64_t frame_count{};
+    // Throughput and latency of the last run
+    FrameStats frame_stats{};
+    // CPU timings of the current frame
+    FrameSample frame_sample{};
 
     glm::ivec2 framebuffer_size{};
     std::optional<RenderTarget> render_target;
     std::optional<DearImGui> imgui;
+    // Created on first use by run_parallel()
+    std::optional<ParallelRecorder> recorder;
+    // GPU timings of the renderer's passes, and of any scopes added by draw
+    // callbacks.
+    std::optional<GpuProfiler> profiler;
+    // Passes of the current frame, and the barriers between them.
+    std::optional<RenderGraph> graph;
 
     ScopedWaiter waiter;
 
     bool wireframe = false;
+    bool show_gpu_profiler = false;
+    bool show_memory_stats = false;
+    // VK_EXT_memory_budget is enabled: heap budgets are reported by the
+    // driver instead of estimated.
+    bool memory_budget = false;
+    // Descriptor indexing is enabled: bindless is created.
+    bool descriptor_indexing = false;
+
+    [[nodiscard]] auto is_headless() const -> bool {
+      return create_info.headless;
+    }
 
     void create_window() {
-      window = glfw::create_window({1280, 720}, "Learn Vulkan");
+      window = glfw::create_window(create_info.extent, "Learn Vulkan");
     }
 
     void create_instance() {
@@ -106,7 +360,10 @@ namespace framework {
       };
       auto valid_layers = get_valid_layers(layers);
 
-      auto const extensions = glfw::instance_extensions();
+      // No surface extensions are needed without a window.
+      auto const extensions = is_headless()
+        ? std::span<char const *const>{}
+        : glfw::instance_extensions();
 
       auto instance_info = vk::InstanceCreateInfo()
                              .setPApplicationInfo(&app_info)
@@ -130,13 +387,23 @@ namespace framework {
     }
 
     void create_device() {
-      // since we use only one queue, it has the entire priority range, ie, 1.0
+      // one queue per family, each has the entire priority range, ie, 1.0
       static constexpr auto queue_priorities = std::array{1.0f};
 
-      auto queue_info = vk::DeviceQueueCreateInfo()
-                          .setQueueFamilyIndex(gpu.queue_family)
-                          .setQueueCount(1)
-                          .setQueuePriorities(queue_priorities);
+      auto queue_infos = std::vector{
+        vk::DeviceQueueCreateInfo()
+          .setQueueFamilyIndex(gpu.queue_family)
+          .setQueueCount(1)
+          .setQueuePriorities(queue_priorities),
+      };
+      if (gpu.transfer_queue_family) {
+        queue_infos.push_back(
+          vk::DeviceQueueCreateInfo()
+            .setQueueFamilyIndex(*gpu.transfer_queue_family)
+            .setQueueCount(1)
+            .setQueuePriorities(queue_priorities)
+        );
+      }
 
       // nice-to-have optional core features, enable if GPU supports them.
       auto enabled_features =
@@ -144,7 +411,13 @@ namespace framework {
           .setFillModeNonSolid(gpu.features.fillModeNonSolid)
           .setWideLines(gpu.features.wideLines)
           .setSamplerAnisotropy(gpu.features.samplerAnisotropy)
-          .setSampleRateShading(gpu.features.sampleRateShading);
+          .setSampleRateShading(gpu.features.sampleRateShading)
+          // Block compressed textures, eg loaded with load_ktx2().
+          .setTextureCompressionBC(gpu.features.textureCompressionBC)
+          .setTextureCompressionASTC_LDR(
+            gpu.features.textureCompressionASTC_LDR
+          )
+          .setTextureCompressionETC2(gpu.features.textureCompressionETC2);
 
       auto shader_object_feature =
         vk::PhysicalDeviceShaderObjectFeaturesEXT(vk::True);
@@ -155,22 +428,63 @@ namespace framework {
           &shader_object_feature
         );
 
-      // sync_feature.pNext => dynamic_rendering_feature,
+      auto timeline_feature =
+        vk::PhysicalDeviceTimelineSemaphoreFeatures(vk::True).setPNext(
+          &dynamic_rendering_feature
+        );
+
+      // sync_feature.pNext => timeline_feature,
       // and later device_ci.pNext => sync_feature.
       // this is 'pNext chaining'.
       auto sync_feature =
         vk::PhysicalDeviceSynchronization2Features(vk::True).setPNext(
-          &dynamic_rendering_feature
+          &timeline_feature
         );
 
-      static constexpr auto extensions =
-        std::array{VK_KHR_SWAPCHAIN_EXTENSION_NAME, "VK_EXT_shader_object"};
+      // Descriptor indexing for the BindlessTable, if supported.
+      auto const supported = gpu.device.getFeatures2<
+        vk::PhysicalDeviceFeatures2,
+        vk::PhysicalDeviceDescriptorIndexingFeatures>();
+      auto const &indexing =
+        supported.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+      descriptor_indexing = indexing.runtimeDescriptorArray &&
+        indexing.descriptorBindingPartiallyBound &&
+        indexing.descriptorBindingUpdateUnusedWhilePending &&
+        indexing.descriptorBindingSampledImageUpdateAfterBind &&
+        indexing.descriptorBindingStorageBufferUpdateAfterBind &&
+        indexing.shaderSampledImageArrayNonUniformIndexing;
+      auto indexing_feature =
+        vk::PhysicalDeviceDescriptorIndexingFeatures()
+          .setRuntimeDescriptorArray(vk::True)
+          .setDescriptorBindingPartiallyBound(vk::True)
+          .setDescriptorBindingUpdateUnusedWhilePending(vk::True)
+          .setDescriptorBindingSampledImageUpdateAfterBind(vk::True)
+          .setDescriptorBindingStorageBufferUpdateAfterBind(vk::True)
+          .setShaderSampledImageArrayNonUniformIndexing(vk::True)
+          .setPNext(&sync_feature);
+
+      auto extensions = std::vector<char const *>{"VK_EXT_shader_object"};
+      if (!is_headless()) {
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+      }
+      auto const available = gpu.device.enumerateDeviceExtensionProperties();
+      memory_budget = std::ranges::any_of(
+        available,
+        [](vk::ExtensionProperties const &properties) {
+          return std::string_view{properties.extensionName.data()} ==
+            VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        }
+      );
+      if (memory_budget) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+      }
 
       auto device_info = vk::DeviceCreateInfo()
                            .setPEnabledExtensionNames(extensions)
-                           .setQueueCreateInfos(queue_info)
+                           .setQueueCreateInfos(queue_infos)
                            .setPEnabledFeatures(&enabled_features)
                            .setPNext(&sync_feature);
+      if (descriptor_indexing) device_info.setPNext(&indexing_feature);
 
       device = gpu.device.createDeviceUnique(device_info);
       VULKAN_HPP_DEFAULT_DISPATCHER.init(*device);
@@ -179,26 +493,44 @@ namespace framework {
 
       static constexpr std::uint32_t queue_index{0};
       queue = device->getQueue(gpu.queue_family, queue_index);
+      if (gpu.transfer_queue_family) {
+        transfer_queue =
+          device->getQueue(*gpu.transfer_queue_family, queue_index);
+        std::println("[lvk] Using dedicated transfer queue for uploads");
+      }
+
+      timeline = Timeline{*device};
     }
 
     void create_imgui() {
       auto const imgui_info = DearImGui::CreateInfo{
         .window = window.get(),
+        .display_size = create_info.extent,
         .api_version = vk_version,
         .instance = *instance,
         .physical_device = gpu.device,
         .queue_family = gpu.queue_family,
         .device = *device,
         .queue = queue,
-        .color_format = swapchain->get_format(),
+        .color_format = color_format(),
         .samples = vk::SampleCountFlagBits::e1,
+        .buffering = frames_in_flight(),
       };
 
       imgui.emplace(imgui_info);
     };
 
     void create_allocator() {
-      allocator = vma::create_allocator(*instance, gpu.device, *device);
+      allocator = vma::create_allocator(
+        *instance, gpu.device, *device, vk_version, memory_budget
+      );
+      direct_write = vma::has_direct_write(allocator.get());
+      if (direct_write) {
+        std::println(
+          "[lvk] Device local memory is host visible: direct writes"
+        );
+      }
+      show_memory_stats = create_info.show_memory_stats;
     }
 
     void create_cmd_block_pool() {
@@ -210,37 +542,61 @@ namespace framework {
           .setFlags(vk::CommandPoolCreateFlagBits::eTransient);
 
       cmd_block_pool = device->createCommandPoolUnique(command_pool_info);
+
+      if (gpu.transfer_queue_family) {
+        command_pool_info.setQueueFamilyIndex(*gpu.transfer_queue_family);
+        transfer_cmd_pool = device->createCommandPoolUnique(command_pool_info);
+      }
     }
 
     auto acquire_render_target() -> bool {
-      framebuffer_size = glfw::framebuffer_size(window.get());
+      auto const span = trace::Span{"acquire_render_target"};
+      framebuffer_size = is_headless() ? offscreen->get_size()
+                                       : glfw::framebuffer_size(window.get());
 
       // Skip loop if minimized
       if (framebuffer_size.x <= 0 || framebuffer_size.y <= 0) return false;
 
       auto &current_render_sync = render_sync.at(frame_index);
 
-      // Wait for the fence to be signaled.
-      static constexpr auto fence_timeout_v =
+      // Wait for the previous submission of this virtual frame to retire.
+      static constexpr auto wait_timeout_v =
         static_cast<std::uint64_t>(std::chrono::nanoseconds{3s}.count());
-      auto result = device->waitForFences(
-        *current_render_sync.drawn, vk::True, fence_timeout_v
-      );
-
-      if (result != vk::Result::eSuccess)
-        throw std::runtime_error{"Failed to wait for Render Fence"};
+      auto const wait_start = std::chrono::steady_clock::now();
+      {
+        auto const wait_span = trace::Span{"wait_for_frame"};
+        if (!timeline.wait(current_render_sync.drawn, wait_timeout_v))
+          throw std::runtime_error{"Failed to wait for Render Timeline"};
+      }
+      deferred.collect(timeline.completed_value());
+      if (bindless) bindless->collect(timeline.completed_value());
+      collect_uploads();
+      step_defragmenter();
+      uniforms->begin_frame(frame_index);
+
+      auto const now = std::chrono::steady_clock::now();
+      frame_sample.wait = now - wait_start;
+      if (current_render_sync.drawn > 0) {
+        frame_stats.add_latency(now - current_render_sync.begun_at);
+      }
+      current_render_sync.begun_at = now;
+
+      if (is_headless()) {
+        render_target = offscreen->acquire();
+      } else {
+        auto const acquire_span = trace::Span{"acquire_next_image"};
+        render_target =
+          swapchain->acquire_next_image(*current_render_sync.draw);
+      }
+      frame_sample.acquire = std::chrono::steady_clock::now() - now;
 
-      render_target = swapchain->acquire_next_image(*current_render_sync.draw);
       if (!render_target) {
         // Acquire failure => ErrorOutOfDate. Recreate Swapchain.
-        swapchain->recreate(framebuffer_size);
+        recreate_swapchain();
 
         return false;
       }
 
-      // Reset fence _after_ acquisition of image: if it fails, the
-      // fence remains signaled.
-      device->resetFences(*current_render_sync.drawn);
       imgui->new_frame();
 
       return true;
@@ -249,10 +605,133 @@ namespace framework {
     void create_swapchain() {
       auto const size = glfw::framebuffer_size(window.get());
 
-      swapchain.emplace(*device, gpu, *surface, size);
+      swapchain.emplace(
+        *device, gpu, *surface, size, create_info.present_policy
+      );
+    }
+
+    void create_recorder() {
+      auto const thread_count = create_info.recording_threads > 0
+        ? create_info.recording_threads
+        : ThreadPool::default_thread_count();
+
+      auto const recorder_info = ParallelRecorder::CreateInfo{
+        .device = *device,
+        .queue_family = gpu.queue_family,
+        .buffering = frames_in_flight(),
+        .thread_count = thread_count,
+      };
+      recorder.emplace(recorder_info);
+    }
+
+    void create_profiler() {
+      auto const profiler_info = GpuProfiler::CreateInfo{
+        .device = *device,
+        .gpu = gpu,
+        .buffering = frames_in_flight(),
+      };
+      profiler.emplace(profiler_info);
+      show_gpu_profiler = create_info.show_gpu_profiler;
+    }
+
+    void create_staging() {
+      auto const staging_info = StagingRing::CreateInfo{
+        .allocator = allocator.get(),
+        .queue_family = gpu.queue_family,
+        .timeline = &timeline,
+        .size = create_info.staging_size,
+      };
+      staging.emplace(staging_info);
+    }
+
+    void create_defragmenter() {
+      auto const defragmenter_info = Defragmenter::CreateInfo{
+        .device = *device,
+        .allocator = allocator.get(),
+        .queue = queue,
+        .command_pool = *cmd_block_pool,
+        .staging = &*staging,
+        .max_bytes_per_pass = create_info.defragment_bytes_per_pass,
+      };
+      defragmenter.emplace(defragmenter_info);
+    }
+
+    void step_defragmenter() {
+      if (!create_info.defragment) return;
+      auto const pass = defragmenter->step();
+      if (!pass || pass->allocations_moved == 0) return;
+      std::println(
+        "[lvk] Defragmentation: moved {} allocation(s) ({} KiB), reclaimed "
+        "{} KiB",
+        pass->allocations_moved,
+        pass->bytes_moved / 1024,
+        pass->bytes_reclaimed / 1024
+      );
+    }
+
+    void create_uniform_arena() {
+      auto const &limits = gpu.properties.limits;
+      auto const arena_info = UniformArena::CreateInfo{
+        .allocator = allocator.get(),
+        .queue_family = gpu.queue_family,
+        .buffering = frames_in_flight(),
+        .alignment = std::max(
+          limits.minUniformBufferOffsetAlignment,
+          limits.minStorageBufferOffsetAlignment
+        ),
+        .size_per_frame = create_info.uniform_arena_size,
+      };
+      uniforms.emplace(arena_info);
+    }
+
+    void create_bindless_table() {
+      if (!descriptor_indexing) return;
+      auto const properties = gpu.device.getProperties2<
+        vk::PhysicalDeviceProperties2,
+        vk::PhysicalDeviceDescriptorIndexingProperties>();
+      auto const &limits =
+        properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+      auto table_info = BindlessTable::CreateInfo{.device = *device};
+      // combined image samplers count as both samplers and sampled images.
+      table_info.max_textures = std::min({
+        table_info.max_textures,
+        limits.maxDescriptorSetUpdateAfterBindSampledImages,
+        limits.maxDescriptorSetUpdateAfterBindSamplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+      });
+      table_info.max_buffers = std::min({
+        table_info.max_buffers,
+        limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+      });
+      bindless.emplace(table_info);
+    }
+
+    void create_render_graph() {
+      auto const graph_info = RenderGraph::CreateInfo{
+        .device = *device,
+        .allocator = allocator.get(),
+        .queue_family = gpu.queue_family,
+        .buffering = frames_in_flight(),
+      };
+      graph.emplace(graph_info);
+    }
+
+    void create_offscreen() {
+      offscreen.emplace(
+        *device, allocator.get(), gpu.queue_family, create_info.extent
+      );
     }
 
     void create_render_sync() {
+      auto const buffering = std::clamp(
+        create_info.frames_in_flight,
+        min_resource_buffering,
+        max_resource_buffering
+      );
+      render_sync = Buffered<RenderSync>(buffering);
+
       auto command_pool_info =
         vk::CommandPoolCreateInfo()
           // Enables resetting command buffer
@@ -264,7 +743,7 @@ namespace framework {
       auto command_buffer_info =
         vk::CommandBufferAllocateInfo()
           .setCommandPool(*render_cmd_pool)
-          .setCommandBufferCount(static_cast<std::uint32_t>(resource_buffering))
+          .setCommandBufferCount(static_cast<std::uint32_t>(buffering))
           .setLevel(vk::CommandBufferLevel::ePrimary);
 
       auto const command_buffers =
@@ -272,23 +751,20 @@ namespace framework {
 
       assert(command_buffers.size() == render_sync.size());
 
-      // We create Render Fences as pre-signaled so that on the first render for
-      // each virtual frame we don't wait on their fences (since there's nothing
-      // to wait for yet).
-      static constexpr auto fence_create_info =
-        vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled);
-
+      // Each virtual frame starts at timeline value 0, which is already
+      // "signalled": the first render doesn't wait on anything.
       for (auto [sync, command_buffer] :
            std::views::zip(render_sync, command_buffers)) {
 
         sync.command_buffer = command_buffer;
         sync.draw = device->createSemaphoreUnique({});
         sync.present = device->createSemaphoreUnique({});
-        sync.drawn = device->createFenceUnique(fence_create_info);
+        sync.drawn = 0;
       }
     }
 
     auto begin_frame() -> vk::CommandBuffer {
+      auto const span = trace::Span{"begin_frame"};
       auto const &current_render_sync = render_sync.at(frame_index);
 
       auto command_buffer_bi = vk::CommandBufferBeginInfo{};
@@ -296,94 +772,108 @@ namespace framework {
       command_buffer_bi.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit
       );
       current_render_sync.command_buffer.begin(command_buffer_bi);
+      profiler->begin_frame(current_render_sync.command_buffer, frame_index);
       return current_render_sync.command_buffer;
     }
 
-    void transition_for_render(vk::CommandBuffer const command_buffer) const {
-      auto barrier = swapchain->base_barrier();
+    [[nodiscard]] auto color_format() const -> vk::Format {
+      return swapchain ? swapchain->get_format() : offscreen->get_format();
+    }
 
-      // Undefined => AttachmentOptimal
-      // the barrier must wait for prior color attachment operations to complete,
-      // and block subsequent ones.
+    void render(
+      vk::CommandBuffer const command_buffer,
+      const std::function<void(vk::CommandBuffer const)> &draw,
+      vk::RenderingFlags const scene_flags = {}
+    ) {
+      auto const target = import_render_target();
+
+      graph->add_pass(GraphPass{
+        .name = "scene",
+        .color_attachments = {ColorAttachment{.image = target}},
+        .rendering_flags = scene_flags,
+        .record =
+          [&draw](vk::CommandBuffer const command_buffer) {
+            auto const span = trace::Span{"draw"};
+            draw(command_buffer);
+          },
+      });
+
+      // We don't want to clear the image again, instead load it intact after
+      // the previous pass.
+      graph->add_pass(GraphPass{
+        .name = "imgui",
+        .color_attachments = {ColorAttachment{
+          .image = target,
+          .load_op = vk::AttachmentLoadOp::eLoad,
+        }},
+        .record =
+          [this](vk::CommandBuffer const command_buffer) {
+            // Draw callbacks add ImGui widgets: end the frame after them.
+            if (show_gpu_profiler) profiler->draw_overlay();
+            if (show_memory_stats) {
+              draw_memory_panel(get_memory_stats(allocator.get()));
+            }
+            imgui->end_frame();
+            imgui->render(command_buffer);
+          },
+      });
+
+      graph->execute(command_buffer, &*profiler);
+    }
 
-      barrier.setOldLayout(vk::ImageLayout::eUndefined)
-        .setNewLayout(vk::ImageLayout::eAttachmentOptimal)
-        .setSrcAccessMask(
-          vk::AccessFlagBits2::eColorAttachmentRead |
-          vk::AccessFlagBits2::eColorAttachmentWrite
-        )
-        .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-        .setDstAccessMask(barrier.srcAccessMask)
-        .setDstStageMask(barrier.srcStageMask);
+    // Imports the current render target, left ready to be presented (or
+    // read back when headless) at the end of the frame.
+    auto import_render_target() -> ImageHandle {
+      using Stage = vk::PipelineStageFlagBits2;
 
-      auto dependency_info =
-        vk::DependencyInfo().setImageMemoryBarriers(barrier);
+      // The acquire semaphore is waited on at ColorAttachmentOutput, the
+      // offscreen image was last read by a copy (readback).
+      auto const initial = ResourceState{
+        .stages = is_headless() ? Stage::eCopy : Stage::eColorAttachmentOutput,
+      };
 
-      command_buffer.pipelineBarrier2(dependency_info);
+      return graph->import_image(ImportedImage{
+        .image = render_target->image,
+        .image_view = render_target->image_view,
+        .extent = render_target->extent,
+        .format = color_format(),
+        .initial = initial,
+        .final_usage = is_headless() ? ResourceUsage::TransferSrc
+                                     : ResourceUsage::Present,
+      });
     }
 
-    void render(
-      vk::CommandBuffer const command_buffer,
-      const std::function<void(vk::CommandBuffer const)> &draw
+    // Records tasks into secondary command buffers on worker threads, and
+    // executes them in task order in the scene pass.
+    void render_parallel(
+      vk::CommandBuffer const command_buffer, std::span<DrawTask const> tasks
     ) {
-      auto color_attachment =
-        vk::RenderingAttachmentInfo()
-          .setImageView(render_target->image_view)
-          .setImageLayout(vk::ImageLayout::eAttachmentOptimal)
-          .setLoadOp(vk::AttachmentLoadOp::eClear)
-          .setStoreOp(vk::AttachmentStoreOp::eStore)
-          .setClearValue(vk::ClearColorValue{0.0f, 0.0f, 0.0f, 1.0f});
-
-      auto const render_area =
-        vk::Rect2D{vk::Offset2D{}, render_target->extent};
-      auto rendering_info = vk::RenderingInfo()
-                              .setRenderArea(render_area)
-                              .setColorAttachments(color_attachment)
-                              .setLayerCount(1);
-
-      command_buffer.beginRendering(rendering_info);
-
-      draw(command_buffer);
-
-      command_buffer.endRendering();
-
-      imgui->end_frame();
-
-      // We don't want to clear the image again, instead load it intact after the
-      // previous pass.
-      color_attachment =
-        color_attachment.setLoadOp(vk::AttachmentLoadOp::eLoad);
-      rendering_info = rendering_info.setColorAttachments(color_attachment)
-                         .setPDepthAttachment(nullptr);
-      command_buffer.beginRendering(rendering_info);
-      imgui->render(command_buffer);
-      command_buffer.endRendering();
-    }
-
-    void transition_for_present(vk::CommandBuffer const command_buffer) const {
-      auto barrier = swapchain->base_barrier();
-
-      // AttachmentOptimal => PresentSrc
-      // the barrier must wait for prior color attachment operations to complete,
-      // and block subsequent ones.
-      barrier.setOldLayout(vk::ImageLayout::eAttachmentOptimal)
-        .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
-        .setSrcAccessMask(
-          vk::AccessFlagBits2::eColorAttachmentRead |
-          vk::AccessFlagBits2::eColorAttachmentWrite
-        )
-        .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-        .setDstAccessMask(barrier.srcAccessMask)
-        .setDstStageMask(barrier.srcStageMask);
-
-      auto dependency_info =
-        vk::DependencyInfo().setImageMemoryBarriers(barrier);
-      command_buffer.pipelineBarrier2(dependency_info);
+      if (!recorder) create_recorder();
+
+      auto const format = color_format();
+      auto const inheritance_rendering =
+        vk::CommandBufferInheritanceRenderingInfo()
+          .setColorAttachmentFormats(format)
+          .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+      auto const execute = [&](vk::CommandBuffer const primary) {
+        auto const secondaries =
+          recorder->record(frame_index, inheritance_rendering, tasks);
+        if (!secondaries.empty()) primary.executeCommands(secondaries);
+      };
+
+      render(
+        command_buffer,
+        execute,
+        vk::RenderingFlagBits::eContentsSecondaryCommandBuffers
+      );
     }
 
     void submit_and_present() {
-      auto const &current_render_sync = render_sync.at(frame_index);
+      auto const span = trace::Span{"submit_and_present"};
+      auto &current_render_sync = render_sync.at(frame_index);
       current_render_sync.command_buffer.end();
+      uniforms->flush();
 
       auto submit_info = vk::SubmitInfo2{};
       auto const command_buffer_info =
@@ -391,54 +881,315 @@ namespace framework {
       auto wait_semaphore_info = vk::SemaphoreSubmitInfo{};
       wait_semaphore_info.setSemaphore(*current_render_sync.draw)
         .setStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput);
-      auto signal_semaphore_info = vk::SemaphoreSubmitInfo{};
-      signal_semaphore_info.setSemaphore(*current_render_sync.present)
-        .setStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput);
-      submit_info.setCommandBufferInfos(command_buffer_info)
-        .setWaitSemaphoreInfos(wait_semaphore_info)
-        .setSignalSemaphoreInfos(signal_semaphore_info);
-      queue.submit2(submit_info, *current_render_sync.drawn);
+      current_render_sync.drawn = timeline.next_value();
+      deferred.seal(current_render_sync.drawn);
+      if (bindless) bindless->seal(current_render_sync.drawn);
+      auto signal_semaphore_infos = std::array{
+        timeline.signal_info(current_render_sync.drawn),
+        vk::SemaphoreSubmitInfo()
+          .setSemaphore(*current_render_sync.present)
+          .setStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput),
+      };
+      submit_info.setCommandBufferInfos(command_buffer_info);
+      // Nothing is acquired or presented when headless.
+      auto wait_semaphore_infos = std::move(upload_waits);
+      upload_waits.clear();
+      if (is_headless()) {
+        submit_info.setSignalSemaphoreInfos(signal_semaphore_infos.front());
+      } else {
+        wait_semaphore_infos.push_back(wait_semaphore_info);
+        submit_info.setSignalSemaphoreInfos(signal_semaphore_infos);
+      }
+      submit_info.setWaitSemaphoreInfos(wait_semaphore_infos);
+      queue.submit2(submit_info);
 
       frame_index = (frame_index + 1) % render_sync.size();
+      ++frame_count;
       render_target.reset();
 
+      if (is_headless()) return;
+
       // an eErrorOutOfDateKHR result is not guaranteed if the
       // framebuffer size does not match the Swapchain image size, check it
       // explicitly.
       auto const fb_size_changed = framebuffer_size != swapchain->get_size();
       auto const out_of_date =
         !swapchain->present(queue, *current_render_sync.present);
-      if (fb_size_changed || out_of_date) {
-        swapchain->recreate(framebuffer_size);
+      if (fb_size_changed || out_of_date) recreate_swapchain();
+    }
+
+    void collect_uploads() {
+      while (!pending_uploads.empty() &&
+             pending_uploads.front().is_complete()) {
+        pending_uploads.pop_front();
+      }
+    }
+
+    // Recreates the Swapchain without idling the device: the old one is
+    // deferred until the next frame's submission (which seals it) has
+    // retired, by which time the queue has processed its pending presents.
+    // Upload and defragmentation submissions also advance the timeline, so
+    // the next timeline value would not do.
+    void recreate_swapchain() {
+      swapchain->recreate(framebuffer_size, &deferred);
+    }
+
+    // Limits apply per frame loop: start and start_frame are its own.
+    [[nodiscard]] auto should_close(
+      std::chrono::steady_clock::time_point const start,
+      std::uint64_t const start_frame
+    ) const -> bool {
+      if (create_info.max_frames > 0 &&
+          frame_count - start_frame >= create_info.max_frames) {
+        return true;
+      }
+
+      if (create_info.max_duration > 0s &&
+          std::chrono::steady_clock::now() - start >=
+            create_info.max_duration) {
+        return true;
+      }
+
+      return !is_headless() && glfwWindowShouldClose(window.get()) == GLFW_TRUE;
+    }
+
+    void write_capture() const {
+      if (create_info.capture_path.empty()) return;
+
+      if (!offscreen) {
+        std::println(stderr, "[lvk] Capture is only supported when headless");
+        return;
+      }
+
+      auto const pixels = read_back();
+      if (write_ppm(create_info.capture_path, pixels)) {
+        std::println(
+          "[lvk] Captured frame to '{}'",
+          create_info.capture_path.generic_string()
+        );
       }
     }
 
   public:
-    explicit Renderer() {
-      create_window();
+    explicit Renderer() : Renderer(CreateInfo::from_env()) {}
+
+    explicit Renderer(CreateInfo info) : create_info(std::move(info)) {
+      if (!create_info.trace_path.empty()) {
+        if constexpr (trace::enabled_v) {
+          trace::dump_at_exit(create_info.trace_path);
+        } else {
+          std::println(stderr, "[lvk] Tracing is compiled out (LVK_TRACE)");
+        }
+      }
+      if (!is_headless()) create_window();
       create_instance();
-      create_surface();
+      if (!is_headless()) create_surface();
       select_gpu();
       create_device();
       create_allocator();
-      create_swapchain();
+      create_staging();
+      if (is_headless()) {
+        create_offscreen();
+      } else {
+        create_swapchain();
+      }
       create_render_sync();
+      create_uniform_arena();
+      samplers.emplace(*device);
+      create_bindless_table();
+      create_profiler();
+      create_render_graph();
       create_imgui();
       create_cmd_block_pool();
+      create_defragmenter();
+    }
+
+    /// Command Block for uploads: records on the dedicated transfer queue
+    /// if there is one (handing resources over to queue), else on queue.
+    /// Staging memory for uploads is sub-allocated from the staging ring.
+    [[nodiscard]] auto create_command_block() -> CommandBlock {
+      if (!gpu.transfer_queue_family) {
+        return CommandBlock{*device, queue, *cmd_block_pool, &*staging};
+      }
+
+      auto const graphics = QueueInfo{
+        .queue = queue,
+        .family = gpu.queue_family,
+        .command_pool = *cmd_block_pool,
+      };
+      auto const transfer = QueueInfo{
+        .queue = transfer_queue,
+        .family = *gpu.transfer_queue_family,
+        .command_pool = *transfer_cmd_pool,
+      };
+      return CommandBlock{*device, transfer, graphics, &*staging};
+    }
+
+    /// Batch of uploads recorded into one create_command_block() and
+    /// submitted together.
+    [[nodiscard]] auto create_upload_batch() -> vma::UploadBatch {
+      return vma::UploadBatch{create_command_block()};
+    }
+
+    /// Submits batch without blocking the render loop. Its Command Buffers
+    /// are released, and its staging memory reclaimed, once the returned
+    /// ticket completes: poll it, or chain it with wait_for().
+    auto submit_async(vma::UploadBatch batch) -> UploadTicket {
+      auto pending = batch.submit_async();
+      auto const ret = pending.get_ticket();
+      pending_uploads.push_back(std::move(pending));
+      return ret;
+    }
+
+    /// Makes the next frame's submission wait for ticket before stage, so
+    /// its resources can be drawn with in that frame without blocking.
+    void wait_for(
+      UploadTicket const &ticket,
+      vk::PipelineStageFlags2 const stage =
+        vk::PipelineStageFlagBits2::eAllCommands
+    ) {
+      if (ticket.is_complete()) return;
+      upload_waits.push_back(ticket.wait_info(stage));
+    }
+
+    /// Destroys resource once the frame being recorded (or the next one, if
+    /// none is) has retired, instead of waiting for the device: eg to swap a
+    /// ShaderProgram, Texture or buffer while rendering.
+    template <std::movable Type> void defer(Type resource) {
+      deferred.defer(std::move(resource));
+    }
+
+    /// For resources replacing their own buffers, eg DescriptorBuffer.
+    [[nodiscard]] auto get_deferred_queue() -> DeferredQueue & {
+      return deferred;
+    }
+
+    /// Number of virtual frames, chosen at construction.
+    [[nodiscard]] auto frames_in_flight() const -> std::size_t {
+      return render_sync.size();
+    }
+
+    /// Copies the last rendered frame to host memory (headless only).
+    [[nodiscard]] auto read_back() const -> Readback {
+      if (!offscreen || frame_count == 0) return {};
+
+      return offscreen->read_back(
+        CommandBlock{*device, queue, *cmd_block_pool}
+      );
     }
 
     void run(const std::function<void(vk::CommandBuffer const)> &draw) {
-      while (glfwWindowShouldClose(window.get()) == GLFW_FALSE) {
-        glfwPollEvents();
+      run_frames([&](vk::CommandBuffer const command_buffer) {
+        render(command_buffer, draw);
+      });
+    }
 
+    /// Fills a list of draw tasks every frame (on this thread, so Dear ImGui
+    /// can be used), which are then recorded in parallel on worker threads.
+    using BuildTasks = std::function<void(std::vector<DrawTask> &)>;
+
+    void run_parallel(BuildTasks const &build) {
+      auto tasks = std::vector<DrawTask>{};
+      run_frames([&](vk::CommandBuffer const command_buffer) {
+        tasks.clear();
+        build(tasks);
+        render_parallel(command_buffer, tasks);
+      });
+    }
+
+  private:
+    void run_frames(
+      const std::function<void(vk::CommandBuffer const)> &record
+    ) {
+      using Clock = std::chrono::steady_clock;
+
+      auto const start = Clock::now();
+      auto const start_frame = frame_count;
+      frame_stats = {};
+      if (swapchain) swapchain->reset_latency();
+
+      // Stats only cover frames after warm-up.
+      auto measuring = create_info.warmup_frames == 0;
+      auto measured_start = start;
+      auto measured_frame = start_frame;
+
+      while (!should_close(start, start_frame)) {
+        auto const frame_start = Clock::now();
+        if (!measuring &&
+            frame_count - start_frame >= create_info.warmup_frames) {
+          measuring = true;
+          measured_start = frame_start;
+          measured_frame = frame_count;
+          frame_stats = {};
+          if (swapchain) swapchain->reset_latency();
+        }
+
+        if (!is_headless()) glfwPollEvents();
+
+        frame_sample = {};
         if (!acquire_render_target()) continue;
 
         auto const command_buffer = begin_frame();
-        transition_for_render(command_buffer);
-        render(command_buffer, draw);
-        transition_for_present(command_buffer);
+        {
+          auto const frame_scope = profiler->scope(command_buffer, "frame");
+          record(command_buffer);
+        }
+
+        auto const submit_start = Clock::now();
         submit_and_present();
+
+        auto const frame_end = Clock::now();
+        frame_sample.submit = frame_end - submit_start;
+        frame_sample.cpu_frame = frame_end - frame_start;
+        if (measuring) frame_stats.samples.push_back(frame_sample);
       }
+
+      // One wait for every frame in flight: resources used by draw can then
+      // be destroyed once this returns, and everything deferred is freed.
+      static constexpr auto drain_timeout_v =
+        static_cast<std::uint64_t>(std::chrono::nanoseconds{3s}.count());
+      // Nothing else waits before teardown (eg ShaderProgram, DearImGui):
+      // fall back to waiting for the device rather than destroy resources
+      // it may still use.
+      if (!timeline.wait(timeline.submitted_value(), drain_timeout_v)) {
+        std::println(
+          stderr, "[lvk] Failed to wait for Render Timeline, waiting for idle"
+        );
+        device->waitIdle();
+      }
+      deferred.collect(timeline.completed_value());
+      if (bindless) bindless->collect(timeline.completed_value());
+
+      frame_stats.frames = frame_count - measured_frame;
+      frame_stats.elapsed = Clock::now() - measured_start;
+      frame_stats.warmup_frames = measured_frame - start_frame;
+      if (swapchain) {
+        frame_stats.present_latency = swapchain->get_latency().average;
+      }
+      frame_stats.print(frames_in_flight());
+      if (!create_info.stats_path.empty()) {
+        frame_stats.write_json(
+          create_info.stats_path,
+          frames_in_flight(),
+          std::string_view{gpu.properties.deviceName}
+        );
+      }
+
+      if (!create_info.memory_stats_path.empty()) {
+        get_memory_stats(allocator.get()).print();
+        auto const &transients = graph->get_transient_stats();
+        std::println(
+          "[lvk] transients: {} images ({} lazy) in {} allocations, "
+          "{} KiB saved by aliasing",
+          transients.images,
+          transients.lazy_images,
+          transients.allocations,
+          transients.saved_bytes() / 1024
+        );
+        write_memory_json(allocator.get(), create_info.memory_stats_path);
+      }
+
+      write_capture();
     }
   };
 } // namespace lvk
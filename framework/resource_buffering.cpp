@@ -1,15 +1,20 @@
 module;
 
-#include <array>
 #include <cstddef>
+#include <vector>
 
 export module framework:resource_buffering;
 
 namespace framework {
-  /// Number of virtual frames
-  inline constexpr std::size_t resource_buffering{2};
+  /// Default number of virtual frames
+  export inline constexpr std::size_t resource_buffering{2};
 
-  /// Alias for N-buffered resources
+  /// Supported range for the number of virtual frames
+  export inline constexpr std::size_t min_resource_buffering{1};
+  export inline constexpr std::size_t max_resource_buffering{4};
+
+  /// Alias for N-buffered resources, sized to the number of virtual frames
+  /// chosen at Renderer creation.
   export template <typename Type>
-  using Buffered = std::array<Type, resource_buffering>;
+  using Buffered = std::vector<Type>;
 }
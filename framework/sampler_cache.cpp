@@ -0,0 +1,134 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+export module framework:sampler_cache;
+
+namespace {
+  // Every field of vk::SamplerCreateInfo but sType and pNext, as words.
+  using SamplerKey = std::array<std::uint32_t, 16>;
+
+  [[nodiscard]] auto to_key(vk::SamplerCreateInfo const &info) -> SamplerKey {
+    return {
+      static_cast<std::uint32_t>(info.flags),
+      static_cast<std::uint32_t>(info.magFilter),
+      static_cast<std::uint32_t>(info.minFilter),
+      static_cast<std::uint32_t>(info.mipmapMode),
+      static_cast<std::uint32_t>(info.addressModeU),
+      static_cast<std::uint32_t>(info.addressModeV),
+      static_cast<std::uint32_t>(info.addressModeW),
+      std::bit_cast<std::uint32_t>(info.mipLodBias),
+      info.anisotropyEnable,
+      std::bit_cast<std::uint32_t>(info.maxAnisotropy),
+      info.compareEnable,
+      static_cast<std::uint32_t>(info.compareOp),
+      std::bit_cast<std::uint32_t>(info.minLod),
+      std::bit_cast<std::uint32_t>(info.maxLod),
+      static_cast<std::uint32_t>(info.borderColor),
+      info.unnormalizedCoordinates,
+    };
+  }
+
+  // FNV-1a over the key's words.
+  struct SamplerKeyHash {
+    [[nodiscard]] auto operator()(SamplerKey const &key) const
+      -> std::size_t {
+      auto ret = std::uint64_t{0xcbf29ce484222325};
+      for (auto const word : key) {
+        ret = (ret ^ word) * 0x100000001b3;
+      }
+      return static_cast<std::size_t>(ret);
+    }
+  };
+} // namespace
+
+namespace framework {
+  export struct SamplerCacheStats {
+    /// Cached get() calls.
+    std::uint64_t requests{};
+    /// Samplers created by them.
+    std::uint64_t created{};
+  };
+
+  /// Reference to a sampler shared through a SamplerCache: the sampler is
+  /// destroyed with the last SharedSampler referencing it. get() stays at
+  /// the same address for as long as any copy lives, so it can be passed
+  /// as a descriptor set layout's immutable sampler.
+  export class SharedSampler {
+  public:
+    SharedSampler() = default;
+
+    explicit SharedSampler(std::shared_ptr<vk::UniqueSampler const> sampler) :
+      sampler(std::move(sampler)) {}
+
+    [[nodiscard]] auto get() const -> vk::Sampler const & {
+      return sampler->get();
+    }
+
+    explicit operator bool() const { return sampler != nullptr; }
+
+  private:
+    std::shared_ptr<vk::UniqueSampler const> sampler;
+  };
+
+  /// Deduplicates samplers by create info: every Texture with the same
+  /// filtering / addressing shares one vk::Sampler, keeping far below the
+  /// device's maxSamplerAllocationCount. Create infos with a pNext chain
+  /// are not cached. Thread-safe.
+  export class SamplerCache {
+  public:
+    explicit SamplerCache(vk::Device const device) : device(device) {}
+
+    [[nodiscard]] auto get(vk::SamplerCreateInfo const &info)
+      -> SharedSampler {
+      if (info.pNext != nullptr) return SharedSampler{create(info)};
+
+      auto const key = to_key(info);
+      auto lock = std::scoped_lock{mutex};
+      ++stats.requests;
+      if (auto const it = samplers.find(key); it != samplers.end()) {
+        if (auto sampler = it->second.lock()) {
+          return SharedSampler{std::move(sampler)};
+        }
+      }
+
+      // drop samplers whose last reference has gone before adding one.
+      std::erase_if(samplers, [](auto const &entry) {
+        return entry.second.expired();
+      });
+      auto ret = create(info);
+      samplers.insert_or_assign(key, ret);
+      ++stats.created;
+      return SharedSampler{std::move(ret)};
+    }
+
+    [[nodiscard]] auto get_stats() const -> SamplerCacheStats {
+      auto lock = std::scoped_lock{mutex};
+      return stats;
+    }
+
+  private:
+    [[nodiscard]] auto create(vk::SamplerCreateInfo const &info) const
+      -> std::shared_ptr<vk::UniqueSampler const> {
+      return std::make_shared<vk::UniqueSampler const>(
+        device.createSamplerUnique(info)
+      );
+    }
+
+    vk::Device device;
+    mutable std::mutex mutex;
+    std::unordered_map<
+      SamplerKey,
+      std::weak_ptr<vk::UniqueSampler const>,
+      SamplerKeyHash>
+      samplers;
+    SamplerCacheStats stats{};
+  };
+} // namespace framework
@@ -5,7 +5,6 @@ module;
 #include <span>
 
 export module framework:shader_program;
-import :scoped_waiter;
 
 namespace {
   constexpr auto to_vkbool(bool const value) {
@@ -25,8 +24,13 @@ namespace framework {
     std::span<std::uint32_t const> fragment_spirv;
     ShaderVertexInput vertex_input;
     std::span<vk::DescriptorSetLayout const> set_layouts;
+    // Must match the pipeline layout the draws push constants with.
+    std::span<vk::PushConstantRange const> push_constant_ranges;
   };
 
+  /// Destroy once the submissions binding it have retired: after
+  /// Renderer::run() returns, or through Renderer::defer() to swap it
+  /// while rendering.
   export class ShaderProgram {
   public:
     // Bit flags for various binary states.
@@ -64,6 +68,9 @@ namespace framework {
                                .setPCode(spirv.data())
                                // set common parameters.
                                .setSetLayouts(create_info.set_layouts)
+                               .setPushConstantRanges(
+                                 create_info.push_constant_ranges
+                               )
                                .setCodeType(vk::ShaderCodeTypeEXT::eSpirv)
                                .setPName("main");
 
@@ -89,7 +96,6 @@ namespace framework {
         throw std::runtime_error{"Failed to create Shader Objects"};
 
       shaders = std::move(result.value);
-      waiter = create_info.device;
     }
 
     void bind(
@@ -107,8 +113,6 @@ namespace framework {
     ShaderVertexInput vertex_input{};
     std::vector<vk::UniqueShaderEXT> shaders;
 
-    ScopedWaiter waiter;
-
     static void set_viewport_scissor(
       vk::CommandBuffer const command_buffer, glm::ivec2 const framebuffer_size
     ) {
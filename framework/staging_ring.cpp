@@ -0,0 +1,140 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <print>
+#include <span>
+#include <vk_mem_alloc.h>
+
+export module framework:staging_ring;
+import :timeline;
+import :vma;
+
+namespace framework {
+  /// A region of the staging ring, mapped for writing.
+  export struct StagingAllocation {
+    vk::Buffer buffer;
+    vk::DeviceSize offset{};
+    std::span<std::byte> mapped;
+  };
+
+  struct StagingRingCreateInfo {
+    VmaAllocator allocator;
+    std::uint32_t queue_family;
+    // Signalled by the submissions reading from the ring.
+    Timeline *timeline;
+    vk::DeviceSize size{32 * 1024 * 1024};
+  };
+
+  /// One persistently mapped host buffer that all uploads sub-allocate
+  /// staging memory from, instead of creating a buffer per upload.
+  /// Allocations are retired with the timeline value of the submission
+  /// reading them, and reclaimed in order once the timeline reaches it.
+  /// Not thread-safe: allocate and retire from the thread that submits.
+  export class StagingRing {
+  public:
+    using CreateInfo = StagingRingCreateInfo;
+
+    explicit StagingRing(CreateInfo const &create_info) :
+      timeline(create_info.timeline) {
+      auto const buffer_info = vma::BufferCreateInfo{
+        .allocator = create_info.allocator,
+        .usage = vk::BufferUsageFlagBits::eTransferSrc,
+        .queue_family = create_info.queue_family,
+      };
+      buffer = vma::create_buffer(
+        buffer_info, vma::BufferMemoryType::Host, create_info.size
+      );
+      if (!buffer.get().buffer) {
+        throw std::runtime_error{"Failed to create Staging Ring"};
+      }
+
+      std::println("[lvk] Staging ring [{} KiB]", buffer.get().size / 1024);
+    }
+
+    [[nodiscard]] auto capacity() const -> vk::DeviceSize {
+      return buffer.get().size;
+    }
+
+    [[nodiscard]] auto get_timeline() const -> Timeline & {
+      return *timeline;
+    }
+
+    /// Returns size bytes at an offset aligned to alignment, or nullopt if
+    /// not enough space has been reclaimed yet (or size > capacity()).
+    [[nodiscard]] auto allocate(
+      vk::DeviceSize const size, vk::DeviceSize const alignment
+    ) -> std::optional<StagingAllocation> {
+      reclaim();
+
+      auto const ring_size = capacity();
+      // Aligned within the buffer, as capacity() need not be a multiple of
+      // alignment (eg a fractional LVK_STAGING_SIZE).
+      auto const start = head % ring_size;
+      auto position = align_up(start, alignment);
+      // Allocations never wrap around the end of the buffer.
+      if (position + size > ring_size) position = ring_size;
+      auto const offset = head - start + position;
+      if (offset + size - tail > ring_size) return {};
+
+      head = offset + size;
+      position = offset % ring_size;
+      return StagingAllocation{
+        .buffer = buffer.get().buffer,
+        .offset = position,
+        .mapped = buffer.get().mapped_span().subspan(position, size),
+      };
+    }
+
+    /// Everything allocated since the last call stays in use until value
+    /// has been signalled on the timeline. Makes host writes visible to the
+    /// device: call before submitting.
+    void retire(std::uint64_t const value) {
+      if (head == retired_head) return;
+
+      auto const &raw = buffer.get();
+      vmaFlushAllocation(raw.allocator, raw.allocation, 0, VK_WHOLE_SIZE);
+
+      in_flight.push_back(Region{.end = head, .value = value});
+      retired_head = head;
+    }
+
+  private:
+    struct Region {
+      std::uint64_t end{};
+      std::uint64_t value{};
+    };
+
+    [[nodiscard]] static constexpr auto align_up(
+      std::uint64_t const value, std::uint64_t const alignment
+    ) -> std::uint64_t {
+      return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void reclaim() {
+      while (!in_flight.empty() &&
+             timeline->is_retired(in_flight.front().value)) {
+        tail = in_flight.front().end;
+        in_flight.pop_front();
+      }
+
+      // Idle: restart at the beginning, so the whole ring is contiguous.
+      if (tail == head) {
+        head = tail = retired_head = align_up(head, capacity());
+      }
+    }
+
+    Timeline *timeline{};
+    vma::Buffer buffer;
+
+    // Monotonic byte counters, positions in the buffer are modulo capacity:
+    // [tail, retired_head) is in use by submissions, [retired_head, head)
+    // by commands being recorded.
+    std::uint64_t head{};
+    std::uint64_t retired_head{};
+    std::uint64_t tail{};
+    std::deque<Region> in_flight;
+  };
+} // namespace framework
@@ -2,14 +2,17 @@ module;
 
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
 #include <print>
+#include <vector>
 
 export module framework:swapchain;
+import :deferred_queue;
 import :gpu;
+import :trace;
 
 namespace {
-  constexpr std::uint32_t min_images{3};
-
   constexpr auto srgb_formats = std::array{
     vk::Format::eR8G8B8A8Srgb,
     vk::Format::eB8G8R8A8Srgb,
@@ -63,17 +66,30 @@ namespace {
     return vk::Extent2D{x, y};
   }
 
+  // maxImageCount 0 means there is no upper limit.
   [[nodiscard]] constexpr auto get_image_count(
-    vk::SurfaceCapabilitiesKHR const &capabilities
+    vk::SurfaceCapabilitiesKHR const &capabilities, std::uint32_t const desired
   ) -> std::uint32_t {
     if (capabilities.maxImageCount < capabilities.minImageCount) {
-      return std::max(min_images, capabilities.minImageCount);
+      return std::max(desired, capabilities.minImageCount);
     }
     return std::clamp(
-      min_images, capabilities.minImageCount, capabilities.maxImageCount
+      desired, capabilities.minImageCount, capabilities.maxImageCount
     );
   }
 
+  // Returns the first supported mode in preferred, else eFifo.
+  [[nodiscard]] auto get_present_mode(
+    std::span<vk::PresentModeKHR const> supported,
+    std::span<vk::PresentModeKHR const> preferred
+  ) -> vk::PresentModeKHR {
+    for (auto const desired : preferred) {
+      if (std::ranges::contains(supported, desired)) return desired;
+    }
+    // eFifo is guaranteed to be supported.
+    return vk::PresentModeKHR::eFifo;
+  }
+
   void require_success(vk::Result const result, char const *error_msg) {
     if (result != vk::Result::eSuccess) {
       throw std::runtime_error{error_msg};
@@ -96,6 +112,28 @@ namespace {
 } // namespace
 
 namespace framework {
+  /// How Swapchain images are queued for display, trading latency against
+  /// tearing and power:
+  /// eFifo: vsync, never tears, may queue up to image_count frames.
+  /// eFifoRelaxed: vsync, but tears instead of waiting when a frame is late.
+  /// eMailbox: vsync, newest frame replaces queued ones, burns more power.
+  /// eImmediate: no vsync, lowest latency, tears.
+  export struct PresentPolicy {
+    /// Tried in order, falling back to eFifo if none are supported.
+    std::vector<vk::PresentModeKHR> modes{vk::PresentModeKHR::eFifo};
+    /// Desired number of Swapchain images, clamped to the surface's limits.
+    /// Fewer images cut latency, more avoid stalls on acquire.
+    std::uint32_t image_count{3};
+  };
+
+  /// CPU time from acquiring a Swapchain image until it was queued for
+  /// present.
+  export struct PresentLatency {
+    std::chrono::duration<double> last{};
+    std::chrono::duration<double> average{};
+    std::uint64_t samples{};
+  };
+
   struct RenderTarget {
     vk::Image image;
     vk::ImageView image_view;
@@ -108,10 +146,14 @@ namespace framework {
       vk::Device const device,
       Gpu const &gpu,
       vk::SurfaceKHR const surface,
-      glm::ivec2 const size
-    ) : device(device), gpu(gpu) {
+      glm::ivec2 const size,
+      PresentPolicy const &policy = {}
+    ) : device(device), gpu(gpu), image_count(policy.image_count) {
       auto const surface_format =
         get_surface_format(gpu.device.getSurfaceFormatsKHR(surface));
+      auto const present_mode = get_present_mode(
+        gpu.device.getSurfacePresentModesKHR(surface), policy.modes
+      );
 
       swapchain_create_info =
         vk::SwapchainCreateInfoKHR()
@@ -121,15 +163,21 @@ namespace framework {
           .setImageArrayLayers(1)
           // Swapchain images will be used as color attachments (render targets).
           .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
-          // eFifo is guaranteed to be supported.
-          .setPresentMode(vk::PresentModeKHR::eFifo);
+          .setPresentMode(present_mode);
 
       if (!recreate(size)) {
         throw std::runtime_error{"Failed to create Vulkan Swapchain"};
       }
     }
 
-    auto recreate(glm::ivec2 size) -> bool {
+    /// Creates a new swapchain from the current one, without waiting for the
+    /// device. The old swapchain and its image views are handed to deferred,
+    /// to be destroyed once the next sealed submission has retired, by which
+    /// time the queue has processed their pending presents. Without deferred
+    /// they are destroyed immediately: only when the device is idle.
+    auto recreate(glm::ivec2 size, DeferredQueue *deferred = nullptr)
+      -> bool {
+      auto const span = trace::Span{"Swapchain::recreate"};
       // Image sizes must be positive.
       if (size.x <= 0 || size.y <= 0) {
         return false;
@@ -139,26 +187,39 @@ namespace framework {
         gpu.device.getSurfaceCapabilitiesKHR(swapchain_create_info.surface);
 
       swapchain_create_info.setImageExtent(get_image_extent(capabilities, size))
-        .setMinImageCount(get_image_count(capabilities))
+        .setMinImageCount(get_image_count(capabilities, image_count))
         .setOldSwapchain(swapchain ? *swapchain : vk::SwapchainKHR{})
         .setQueueFamilyIndices(gpu.queue_family);
 
       assert(
         swapchain_create_info.imageExtent.width > 0 &&
         swapchain_create_info.imageExtent.height > 0 &&
-        swapchain_create_info.minImageCount >= min_images
+        swapchain_create_info.minImageCount >= capabilities.minImageCount
       );
 
-      // Wait for the device to be idle before destroying the current swapchain.
-      device.waitIdle();
-      swapchain = device.createSwapchainKHRUnique(swapchain_create_info);
+      auto new_swapchain =
+        device.createSwapchainKHRUnique(swapchain_create_info);
+      if (swapchain && deferred != nullptr) {
+        deferred->defer(Retired{
+          .swapchain = std::move(swapchain),
+          .image_views = std::move(image_views),
+        });
+      }
+      image_views.clear();
+      swapchain = std::move(new_swapchain);
       image_index.reset();
 
       populate_images();
       create_image_views();
 
       size = get_size();
-      std::println("[lvk] Swapchain [{}x{}]", size.x, size.y);
+      std::println(
+        "[lvk] Swapchain [{}x{}] {}, {} images",
+        size.x,
+        size.y,
+        vk::to_string(get_present_mode()),
+        images.size()
+      );
       return true;
     }
 
@@ -175,6 +236,21 @@ namespace framework {
       return swapchain_create_info.imageFormat;
     }
 
+    [[nodiscard]]
+    auto get_present_mode() const -> vk::PresentModeKHR {
+      return swapchain_create_info.presentMode;
+    }
+
+    [[nodiscard]]
+    auto get_latency() const -> PresentLatency {
+      return latency;
+    }
+
+    void reset_latency() {
+      latency = {};
+      total_latency = {};
+    }
+
     [[nodiscard]]
     auto acquire_next_image(vk::Semaphore const to_signal)
       -> std::optional<RenderTarget> {
@@ -191,6 +267,7 @@ namespace framework {
       if (needs_recreation(result)) return {};
 
       image_index = static_cast<std::size_t>(new_image_index);
+      acquired_at = std::chrono::steady_clock::now();
 
       return RenderTarget{
         .image = images.at(*image_index),
@@ -224,11 +301,25 @@ namespace framework {
       // avoid VulkanHPP ErrorOutOfDateKHR exceptions by using alternate API.
       auto const result = queue.presentKHR(&present_info);
       image_index.reset();
+      add_latency(std::chrono::steady_clock::now() - acquired_at);
 
       return !needs_recreation(result);
     }
 
   private:
+    struct Retired {
+      // Declared first: destroyed after its image views.
+      vk::UniqueSwapchainKHR swapchain;
+      std::vector<vk::UniqueImageView> image_views;
+    };
+
+    void add_latency(std::chrono::duration<double> const value) {
+      total_latency += value;
+      latency.last = value;
+      ++latency.samples;
+      latency.average = total_latency / static_cast<double>(latency.samples);
+    }
+
     void populate_images() {
       // we use the more verbose two-call API to avoid assigning `images` to a new
       // vector on every call.
@@ -261,11 +352,16 @@ namespace framework {
 
     vk::Device device;
     Gpu gpu{};
+    std::uint32_t image_count{};
 
     vk::SwapchainCreateInfoKHR swapchain_create_info;
     vk::UniqueSwapchainKHR swapchain;
     std::vector<vk::Image> images;
     std::vector<vk::UniqueImageView> image_views;
     std::optional<std::size_t> image_index;
+
+    std::chrono::steady_clock::time_point acquired_at;
+    std::chrono::duration<double> total_latency{};
+    PresentLatency latency{};
   };
 } // namespace framework
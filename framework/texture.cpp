@@ -1,9 +1,17 @@
 module;
 
 #include <vulkan/vulkan.hpp>
+#include <memory>
+#include <optional>
+#include <utility>
 #include <vk_mem_alloc.h>
 
 export module framework:texture;
+import :bindless_table;
+import :command_block;
+import :defragmenter;
+import :sampler_cache;
+import :upload;
 import :vma;
 
 namespace {
@@ -31,7 +39,7 @@ namespace framework {
         .setMagFilter(filter)
         .setMaxLod(VK_LOD_CLAMP_NONE)
         .setBorderColor(vk::BorderColor::eFloatTransparentBlack)
-        .setMipmapMode(vk::SamplerMipmapMode::eNearest);
+        .setMipmapMode(vk::SamplerMipmapMode::eLinear);
 
     return sampler_info;
   }
@@ -46,11 +54,21 @@ namespace framework {
     std::uint32_t queue_family;
     CommandBlock command_block;
     vma::Bitmap bitmap;
+    // Generate a full mip chain (see vma::UploadBatch::add_image()).
+    bool mipmaps{};
 
     vk::SamplerCreateInfo sampler{sampler_info};
+    // Shares the sampler with every Texture created with the same sampler
+    // info, if set. Otherwise the Texture creates its own.
+    SamplerCache *sampler_cache{};
+    // Registers the Texture into this table's texture array, if set (see
+    // get_bindless_index()).
+    BindlessTable *bindless_table{};
+    // Tracks the Texture for relocation for as long as it lives, if set.
+    Defragmenter *defragmenter{};
   };
 
-  export class Texture {
+  export class Texture : public RelocatableImage {
   public:
     using CreateInfo = TextureCreateInfo;
 
@@ -65,9 +83,136 @@ namespace framework {
         .queue_family = create_info.queue_family,
       };
       image = vma::create_sampled_image(
-        image_ci, std::move(create_info.command_block), create_info.bitmap
+        image_ci,
+        std::move(create_info.command_block),
+        create_info.bitmap,
+        create_info.mipmaps
       );
 
+      create_view_and_sampler(
+        create_info.device, create_info.sampler, create_info.sampler_cache
+      );
+      if (create_info.bindless_table != nullptr) {
+        add_to(*create_info.bindless_table);
+      }
+      defragmenter = create_info.defragmenter;
+      track();
+    }
+
+    /// Wraps an image already uploaded for sampling, eg by an UploadBatch.
+    explicit Texture(
+      vk::Device const device,
+      vma::Image image,
+      vk::SamplerCreateInfo const &sampler_ci = sampler_info,
+      SamplerCache *sampler_cache = nullptr,
+      BindlessTable *bindless_table = nullptr,
+      Defragmenter *defragmenter = nullptr
+    ) :
+      image(std::move(image)), defragmenter(defragmenter) {
+      create_view_and_sampler(device, sampler_ci, sampler_cache);
+      if (bindless_table != nullptr) add_to(*bindless_table);
+      track();
+    }
+
+    Texture(Texture const &) = delete;
+    auto operator=(Texture const &) = delete;
+
+    // The Defragmenter tracks the Texture by address: moves re-track it.
+    Texture(Texture &&rhs) noexcept :
+      image(std::move(rhs.image)),
+      view(std::move(rhs.view)),
+      sampler(std::move(rhs.sampler)),
+      bindless_slot(std::move(rhs.bindless_slot)),
+      defragmenter(std::exchange(rhs.defragmenter, nullptr)) {
+      track();
+    }
+
+    auto operator=(Texture &&rhs) noexcept -> Texture & {
+      if (&rhs == this) return *this;
+      untrack();
+      image = std::move(rhs.image);
+      view = std::move(rhs.view);
+      sampler = std::move(rhs.sampler);
+      bindless_slot = std::move(rhs.bindless_slot);
+      defragmenter = std::exchange(rhs.defragmenter, nullptr);
+      track();
+      return *this;
+    }
+
+    ~Texture() { untrack(); }
+
+    [[nodiscard]] auto descriptor_info() const -> vk::DescriptorImageInfo {
+      return vk::DescriptorImageInfo()
+        .setImageView(*view)
+        .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setSampler(sampler.get());
+    }
+
+    [[nodiscard]] auto get_sampler() const -> SharedSampler const & {
+      return sampler;
+    }
+
+    /// Index of the Texture in its BindlessTable's texture array, for
+    /// shaders to sample it with. nullopt if not registered in one.
+    /// Changes when the Texture is relocated (see Defragmenter).
+    [[nodiscard]] auto get_bindless_index() const
+      -> std::optional<std::uint32_t> {
+      if (bindless_slot.get().table == nullptr) return std::nullopt;
+      return bindless_slot.get().index;
+    }
+
+    [[nodiscard]] auto get_image() const -> vma::RawImage const & override {
+      return image.get();
+    }
+
+    /// Points the Texture at new_image, a copy of its image bound to its
+    /// allocation's new memory (see Defragmenter). Returns the previous
+    /// image and view, to destroy once the device no longer uses them.
+    [[nodiscard]] auto relocate(vk::Image const new_image)
+      -> std::pair<vk::Image, vk::UniqueImageView> override {
+      auto const device = view.getOwner();
+      auto const old_image = std::exchange(image.get().image, new_image);
+      auto old_view = std::move(view);
+      create_view(device);
+      // frames in flight may still read the old slot: move to a new one.
+      if (auto *table = bindless_slot.get().table) add_to(*table);
+      return {old_image, std::move(old_view)};
+    }
+
+  private:
+    void track() {
+      if (defragmenter != nullptr) defragmenter->track(*this);
+    }
+
+    void untrack() {
+      if (defragmenter == nullptr) return;
+      defragmenter->untrack(image);
+    }
+
+    void add_to(BindlessTable &table) {
+      bindless_slot = RawBindlessSlot{
+        .table = &table,
+        .binding = BindlessTable::texture_binding_v,
+        .index = table.add_texture(descriptor_info()),
+      };
+    }
+
+    void create_view_and_sampler(
+      vk::Device const device,
+      vk::SamplerCreateInfo const &sampler_ci,
+      SamplerCache *sampler_cache
+    ) {
+      create_view(device);
+      if (sampler_cache != nullptr) {
+        sampler = sampler_cache->get(sampler_ci);
+        return;
+      }
+      sampler = SharedSampler{std::make_shared<vk::UniqueSampler const>(
+        device.createSamplerUnique(sampler_ci)
+      )};
+    }
+
+    void create_view(vk::Device const device) {
       auto image_view_ci = vk::ImageViewCreateInfo{};
       auto subresource_range = vk::ImageSubresourceRange{};
       subresource_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
@@ -78,21 +223,13 @@ namespace framework {
         .setViewType(vk::ImageViewType::e2D)
         .setFormat(image.get().format)
         .setSubresourceRange(subresource_range);
-      view = create_info.device.createImageViewUnique(image_view_ci);
-
-      sampler = create_info.device.createSamplerUnique(create_info.sampler);
+      view = device.createImageViewUnique(image_view_ci);
     }
 
-    [[nodiscard]] auto descriptor_info() const -> vk::DescriptorImageInfo {
-      return vk::DescriptorImageInfo()
-        .setImageView(*view)
-        .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-        .setSampler(*sampler);
-    }
-
-  private:
     vma::Image image;
     vk::UniqueImageView view;
-    vk::UniqueSampler sampler;
+    SharedSampler sampler;
+    BindlessSlot bindless_slot;
+    Defragmenter *defragmenter{};
   };
 } // namespace framework
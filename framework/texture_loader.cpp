@@ -0,0 +1,281 @@
+module;
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+export module framework:texture_loader;
+import :image_decode;
+import :staging_ring;
+import :thread_pool;
+import :trace;
+import :upload;
+import :vma;
+
+namespace fs = std::filesystem;
+
+namespace {
+  // enough for the PNG IHDR chunk and the QOI header. JPEG frame headers
+  // follow a variable amount of metadata: the prefix read grows until found.
+  constexpr auto header_size_v = 32uz;
+  // copies out of staging start on a texel boundary, keep them aligned.
+  constexpr auto staging_alignment_v = vk::DeviceSize{16};
+
+  auto read_file(fs::path const &path, std::vector<std::byte> &out) -> bool {
+    auto file = std::ifstream{path, std::ios::binary | std::ios::ate};
+    if (!file.is_open()) return false;
+    out.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg({}, std::ios::beg);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    file.read(reinterpret_cast<char *>(out.data()), std::ssize(out));
+    return file.good();
+  }
+
+  [[nodiscard]] auto read_size(fs::path const &path)
+    -> std::optional<glm::ivec2> {
+    auto header = std::vector<std::byte>{};
+    auto file = std::ifstream{path, std::ios::binary};
+    for (auto size = header_size_v;; size *= 16) {
+      auto const offset = header.size();
+      header.resize(size);
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto *const dst = reinterpret_cast<char *>(header.data() + offset);
+      file.read(dst, static_cast<std::streamsize>(size - offset));
+      auto const read = static_cast<std::size_t>(
+        std::max(file.gcount(), std::streamsize{})
+      );
+      header.resize(offset + read);
+
+      auto const ret = framework::read_image_size(header);
+      if (ret) {
+        if (ret->x <= 0 || ret->y <= 0) return std::nullopt;
+        return ret;
+      }
+      // The whole file has been read.
+      if (!file) return std::nullopt;
+    }
+  }
+
+  // Per worker thread, reused across files: no allocation per decode once
+  // warmed up.
+  struct Scratch {
+    std::vector<std::byte> file;
+    std::vector<std::byte> decode;
+  };
+
+  struct Decoded {
+    std::size_t index{};
+    std::size_t file_size{};
+    std::string error;
+  };
+} // namespace
+
+namespace framework {
+  export struct TextureLoadStats {
+    std::size_t textures{};
+    std::size_t decoded_bytes{};
+    std::size_t file_bytes{};
+    std::chrono::duration<double> elapsed{};
+
+    [[nodiscard]] auto textures_per_second() const -> double {
+      return elapsed.count() > 0.0 ? double(textures) / elapsed.count() : 0.0;
+    }
+
+    [[nodiscard]] auto megabytes_per_second() const -> double {
+      if (elapsed.count() <= 0.0) return 0.0;
+      return double(decoded_bytes) / (1024.0 * 1024.0) / elapsed.count();
+    }
+  };
+
+  /// Decodes PNG / JPEG / QOI files on a ThreadPool straight into mapped
+  /// staging memory, recording each image's copy into the UploadBatch as
+  /// soon as it has been decoded. Images that don't fit in the staging ring
+  /// at once are decoded into host memory and uploaded through
+  /// add_image(Bitmap).
+  export class TextureLoader {
+  public:
+    explicit TextureLoader(ThreadPool &thread_pool) :
+      thread_pool(&thread_pool),
+      scratch(thread_pool.thread_count()) {}
+
+    /// Returns one image per path, in order: empty where the file could not
+    /// be read or decoded (the error is printed). Submit the batch before
+    /// using them.
+    [[nodiscard]] auto load(
+      vma::UploadBatch &batch,
+      vma::ImageCreateInfo const &create_info,
+      std::span<fs::path const> paths
+    ) -> std::vector<vma::Image> {
+      auto const span = trace::Span{"TextureLoader::load"};
+      auto const start = std::chrono::steady_clock::now();
+
+      auto ret = std::vector<vma::Image>(paths.size());
+      auto extents = std::vector<vk::Extent2D>(paths.size());
+      auto allocations = std::vector<StagingAllocation>(paths.size());
+
+      auto const record = [&](Decoded const &decoded) {
+        if (!decoded.error.empty()) {
+          std::println(
+            stderr,
+            "[lvk] Failed to load '{}': {}",
+            paths[decoded.index].generic_string(),
+            decoded.error
+          );
+          return;
+        }
+        ret.at(decoded.index) = batch.add_image(
+          create_info, allocations.at(decoded.index), extents.at(decoded.index)
+        );
+        stats.file_bytes += decoded.file_size;
+        stats.decoded_bytes += allocations.at(decoded.index).mapped.size();
+        ++stats.textures;
+      };
+
+      for (auto index = 0uz; index < paths.size(); ++index) {
+        auto const size = read_size(paths[index]);
+        if (!size) {
+          record(Decoded{.index = index, .error = "unsupported format"});
+          continue;
+        }
+        extents.at(index) = vk::Extent2D{
+          static_cast<std::uint32_t>(size->x),
+          static_cast<std::uint32_t>(size->y),
+        };
+        auto const bytes =
+          vk::DeviceSize(size->x) * vk::DeviceSize(size->y) * 4;
+
+        auto staging = batch.try_stage(bytes, staging_alignment_v);
+        if (!staging) {
+          // ring full: let in-flight decodes land, then reclaim it.
+          while (pending > 0) record(pop());
+          if (batch.size() > 0) batch.flush();
+          staging = batch.try_stage(bytes, staging_alignment_v);
+        }
+        if (!staging) {
+          load_direct(batch, create_info, paths[index], index, ret);
+          continue;
+        }
+
+        allocations.at(index) = *staging;
+        enqueue(paths[index], index, staging->mapped);
+        // record whatever has finished meanwhile.
+        for (auto decoded = try_pop(); decoded; decoded = try_pop()) {
+          record(*decoded);
+        }
+      }
+      while (pending > 0) record(pop());
+
+      stats.elapsed += std::chrono::steady_clock::now() - start;
+      return ret;
+    }
+
+    /// Totals over every load() so far (elapsed excludes the final submit).
+    [[nodiscard]] auto get_stats() const -> TextureLoadStats const & {
+      return stats;
+    }
+
+  private:
+    void enqueue(
+      fs::path const &path, std::size_t const index, std::span<std::byte> out
+    ) {
+      ++pending;
+      thread_pool->enqueue([this, path, index, out](std::size_t thread) {
+        auto &buffers = scratch.at(thread);
+        auto decoded = Decoded{.index = index};
+        try {
+          if (!read_file(path, buffers.file)) {
+            throw std::runtime_error{"failed to read file"};
+          }
+          decoded.file_size = buffers.file.size();
+          decode_image(buffers.file, out, buffers.decode);
+        } catch (std::exception const &e) {
+          decoded.error = e.what();
+        }
+        push(std::move(decoded));
+      });
+    }
+
+    // fallback for images larger than the whole staging ring.
+    void load_direct(
+      vma::UploadBatch &batch,
+      vma::ImageCreateInfo const &create_info,
+      fs::path const &path,
+      std::size_t const index,
+      std::vector<vma::Image> &out
+    ) {
+      auto &buffers = direct_scratch;
+      try {
+        if (!read_file(path, buffers.file)) {
+          throw std::runtime_error{"failed to read file"};
+        }
+        auto const size = read_image_size(buffers.file).value();
+        auto rgba = std::vector<std::byte>(std::size_t(size.x) * size.y * 4);
+        decode_image(buffers.file, rgba, buffers.decode);
+        auto const bitmap = vma::Bitmap{.bytes = rgba, .size = size};
+        out.at(index) = batch.add_image(create_info, bitmap);
+        stats.file_bytes += buffers.file.size();
+        stats.decoded_bytes += rgba.size();
+        ++stats.textures;
+      } catch (std::exception const &e) {
+        std::println(
+          stderr,
+          "[lvk] Failed to load '{}': {}",
+          path.generic_string(),
+          e.what()
+        );
+      }
+    }
+
+    void push(Decoded decoded) {
+      {
+        auto lock = std::scoped_lock{mutex};
+        decoded_queue.push_back(std::move(decoded));
+      }
+      has_decoded.notify_one();
+    }
+
+    auto pop() -> Decoded {
+      auto lock = std::unique_lock{mutex};
+      has_decoded.wait(lock, [this] { return !decoded_queue.empty(); });
+      --pending;
+      auto ret = std::move(decoded_queue.front());
+      decoded_queue.pop_front();
+      return ret;
+    }
+
+    auto try_pop() -> std::optional<Decoded> {
+      auto lock = std::scoped_lock{mutex};
+      if (decoded_queue.empty()) return std::nullopt;
+      --pending;
+      auto ret = std::move(decoded_queue.front());
+      decoded_queue.pop_front();
+      return ret;
+    }
+
+    ThreadPool *thread_pool;
+    std::vector<Scratch> scratch;
+    Scratch direct_scratch;
+
+    std::mutex mutex;
+    std::condition_variable has_decoded;
+    std::deque<Decoded> decoded_queue;
+    // only touched by the loading thread.
+    std::size_t pending{};
+
+    TextureLoadStats stats{};
+  };
+} // namespace framework
@@ -0,0 +1,113 @@
+module;
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module framework:thread_pool;
+
+namespace framework {
+  /// Fixed set of worker threads consuming a shared job queue.
+  export class ThreadPool {
+  public:
+    /// Jobs receive the index of the worker running them, in
+    /// [0, thread_count()), to select per-thread resources.
+    using Job = std::function<void(std::size_t const thread_index)>;
+
+    [[nodiscard]] static auto default_thread_count() -> std::size_t {
+      return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    explicit ThreadPool(std::size_t const count = default_thread_count()) {
+      threads.reserve(std::max(count, 1uz));
+      for (auto index = 0uz; index < std::max(count, 1uz); ++index) {
+        threads.emplace_back([this, index] { work(index); });
+      }
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    auto operator=(ThreadPool const &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    auto operator=(ThreadPool &&) = delete;
+
+    ~ThreadPool() {
+      {
+        auto lock = std::scoped_lock{mutex};
+        stopping = true;
+      }
+      has_work.notify_all();
+      // threads are joined on destruction.
+    }
+
+    [[nodiscard]] auto thread_count() const -> std::size_t {
+      return threads.size();
+    }
+
+    void enqueue(Job job) {
+      {
+        auto lock = std::scoped_lock{mutex};
+        jobs.push_back(std::move(job));
+      }
+      has_work.notify_one();
+    }
+
+    /// Blocks until every queued job has finished.
+    /// Rethrows the first exception thrown by a job, if any.
+    void wait_idle() {
+      auto lock = std::unique_lock{mutex};
+      is_idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+
+      if (auto const error = std::exchange(first_error, {})) {
+        std::rethrow_exception(error);
+      }
+    }
+
+  private:
+    void work(std::size_t const thread_index) {
+      while (true) {
+        auto job = Job{};
+        {
+          auto lock = std::unique_lock{mutex};
+          has_work.wait(lock, [this] { return stopping || !jobs.empty(); });
+          if (jobs.empty()) return;
+
+          job = std::move(jobs.front());
+          jobs.pop_front();
+          ++running;
+        }
+
+        auto error = std::exception_ptr{};
+        try {
+          job(thread_index);
+        } catch (...) {
+          error = std::current_exception();
+        }
+
+        {
+          auto lock = std::scoped_lock{mutex};
+          if (error && !first_error) first_error = error;
+          --running;
+        }
+        is_idle.notify_all();
+      }
+    }
+
+    std::mutex mutex;
+    std::condition_variable has_work;
+    std::condition_variable is_idle;
+    std::deque<Job> jobs;
+    std::size_t running{};
+    std::exception_ptr first_error;
+    bool stopping{};
+
+    // Declared last: joined before the state above is destroyed.
+    std::vector<std::jthread> threads;
+  };
+} // namespace framework
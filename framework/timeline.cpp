@@ -0,0 +1,99 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+
+export module framework:timeline;
+
+namespace framework {
+  /// Device-wide counter backed by a timeline semaphore.
+  /// Each submission signals the next value, so "has submission N retired"
+  /// is a single comparison against the semaphore's counter.
+  export class Timeline {
+  public:
+    Timeline() = default;
+
+    explicit Timeline(vk::Device const device) : device(device) {
+      auto type_info = vk::SemaphoreTypeCreateInfo()
+                         .setSemaphoreType(vk::SemaphoreType::eTimeline)
+                         .setInitialValue(0);
+      auto semaphore_info = vk::SemaphoreCreateInfo().setPNext(&type_info);
+
+      semaphore = device.createSemaphoreUnique(semaphore_info);
+    }
+
+    [[nodiscard]] auto get_semaphore() const -> vk::Semaphore {
+      return *semaphore;
+    }
+
+    /// Reserves the value signalled by the next submission.
+    /// Values must be signalled in the order they are reserved.
+    [[nodiscard]] auto next_value() -> std::uint64_t {
+      return ++submitted;
+    }
+
+    /// The last value reserved for a submission.
+    [[nodiscard]] auto submitted_value() const -> std::uint64_t {
+      return submitted;
+    }
+
+    /// The last value signalled by the GPU.
+    [[nodiscard]] auto completed_value() const -> std::uint64_t {
+      // Cache the counter, it only ever increases.
+      if (completed < submitted) {
+        completed = device.getSemaphoreCounterValue(*semaphore);
+      }
+      return completed;
+    }
+
+    [[nodiscard]] auto is_retired(std::uint64_t const value) const -> bool {
+      return value <= completed || value <= completed_value();
+    }
+
+    /// Blocks until value has been signalled, returns false on timeout.
+    [[nodiscard]] auto wait(
+      std::uint64_t const value, std::uint64_t const timeout
+    ) const -> bool {
+      if (value <= completed) return true;
+
+      auto const handle = *semaphore;
+      auto wait_info =
+        vk::SemaphoreWaitInfo().setSemaphores(handle).setValues(value);
+
+      if (device.waitSemaphores(wait_info, timeout) != vk::Result::eSuccess) {
+        return false;
+      }
+
+      completed = std::max(completed, value);
+      return true;
+    }
+
+    /// Info to signal value at the end of a submission.
+    [[nodiscard]] auto signal_info(
+      std::uint64_t const value,
+      vk::PipelineStageFlags2 const stage =
+        vk::PipelineStageFlagBits2::eAllCommands
+    ) const -> vk::SemaphoreSubmitInfo {
+      return vk::SemaphoreSubmitInfo()
+        .setSemaphore(*semaphore)
+        .setValue(value)
+        .setStageMask(stage);
+    }
+
+    /// Info to wait for value before a submission executes stage.
+    [[nodiscard]] auto wait_info(
+      std::uint64_t const value,
+      vk::PipelineStageFlags2 const stage =
+        vk::PipelineStageFlagBits2::eAllCommands
+    ) const -> vk::SemaphoreSubmitInfo {
+      return signal_info(value, stage);
+    }
+
+  private:
+    vk::Device device;
+    vk::UniqueSemaphore semaphore;
+    std::uint64_t submitted{};
+    mutable std::uint64_t completed{};
+  };
+} // namespace framework
@@ -0,0 +1,222 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Set to 0 (LVK_TRACE=OFF in CMake) to compile out all spans.
+#ifndef LVK_TRACE_ENABLED
+  #define LVK_TRACE_ENABLED 1
+#endif
+
+export module framework:trace;
+
+namespace fs = std::filesystem;
+
+namespace framework::trace {
+  export inline constexpr bool enabled_v = LVK_TRACE_ENABLED != 0;
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Event {
+    char const *name{};
+    Clock::time_point begin;
+    Clock::time_point end;
+  };
+
+  // One ring entry, a seqlock: sequence is odd while the producer writes
+  // it, and 2 * (index + 1) once the event pushed at index is complete.
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{};
+    std::atomic<char const *> name{};
+    std::atomic<Clock::rep> begin{};
+    std::atomic<Clock::rep> end{};
+  };
+
+  // Single producer (the owning thread), read by dump() concurrently: the
+  // producer never blocks, the oldest events are overwritten once full,
+  // and dump() skips the slots overwritten while it reads them.
+  struct ThreadBuffer {
+    static constexpr std::size_t capacity_v{std::size_t{1} << 14};
+
+    void push(Event const &event) {
+      auto const index = head.load(std::memory_order_relaxed);
+      auto &slot = slots.at(index % capacity_v);
+      slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.name.store(event.name, std::memory_order_relaxed);
+      slot.begin.store(
+        event.begin.time_since_epoch().count(), std::memory_order_relaxed
+      );
+      slot.end.store(
+        event.end.time_since_epoch().count(), std::memory_order_relaxed
+      );
+      slot.sequence.store(2 * (index + 1), std::memory_order_release);
+      head.store(index + 1, std::memory_order_release);
+    }
+
+    // The event pushed at index, nullopt if it has been (or is being)
+    // overwritten.
+    [[nodiscard]] auto read(std::uint64_t const index) const
+      -> std::optional<Event> {
+      auto const &slot = slots.at(index % capacity_v);
+      auto const expected = 2 * (index + 1);
+      if (slot.sequence.load(std::memory_order_acquire) != expected) {
+        return std::nullopt;
+      }
+      auto const ret = Event{
+        .name = slot.name.load(std::memory_order_relaxed),
+        .begin = Clock::time_point{
+          Clock::duration{slot.begin.load(std::memory_order_relaxed)}
+        },
+        .end = Clock::time_point{
+          Clock::duration{slot.end.load(std::memory_order_relaxed)}
+        },
+      };
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+        return std::nullopt;
+      }
+      return ret;
+    }
+
+    std::array<Slot, capacity_v> slots{};
+    std::atomic<std::uint64_t> head{};
+    std::uint32_t thread_id{};
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    // Buffers outlive their threads, so spans of finished threads are dumped.
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    Clock::time_point epoch{Clock::now()};
+    fs::path exit_path;
+  };
+
+  auto get_registry() -> Registry & {
+    static auto ret = Registry{};
+    return ret;
+  }
+
+  auto get_thread_buffer() -> ThreadBuffer & {
+    // Registration locks once per thread, recording never does.
+    thread_local auto const ret = [] {
+      auto buffer = std::make_shared<ThreadBuffer>();
+      auto &registry = get_registry();
+      auto lock = std::scoped_lock{registry.mutex};
+      buffer->thread_id = static_cast<std::uint32_t>(registry.buffers.size());
+      registry.buffers.push_back(buffer);
+      return buffer;
+    }();
+    return *ret;
+  }
+
+  auto escape(std::string_view const name) -> std::string {
+    auto ret = std::string{};
+    ret.reserve(name.size());
+    for (auto const c : name) {
+      if (c == '"' || c == '\\') ret.push_back('\\');
+      ret.push_back(c);
+    }
+    return ret;
+  }
+
+  /// Records the time between construction and destruction on the calling
+  /// thread. name must be a string literal (or otherwise outlive the dump).
+  /// Does nothing when compiled out.
+  export class Span {
+  public:
+    Span(Span const &) = delete;
+    auto operator=(Span const &) = delete;
+    Span(Span &&) = delete;
+    auto operator=(Span &&) = delete;
+
+    explicit Span(char const *name) {
+      if constexpr (enabled_v) {
+        this->name = name;
+        begin = Clock::now();
+      }
+    }
+
+    ~Span() {
+      if constexpr (enabled_v) {
+        get_thread_buffer().push(
+          Event{.name = name, .begin = begin, .end = Clock::now()}
+        );
+      }
+    }
+
+  private:
+    char const *name{};
+    Clock::time_point begin;
+  };
+
+  /// Writes all recorded spans as Chrome trace events (JSON), viewable in
+  /// chrome://tracing or ui.perfetto.dev.
+  export auto dump(fs::path const &path) -> bool {
+    if constexpr (!enabled_v) return false;
+
+    auto file = std::ofstream{path};
+    if (!file.is_open()) {
+      std::println(stderr, "Failed to open file: '{}'", path.generic_string());
+      return false;
+    }
+
+    auto &registry = get_registry();
+    auto const to_us = [&registry](Clock::time_point const time) {
+      return std::chrono::duration<double, std::micro>{time - registry.epoch}
+        .count();
+    };
+
+    auto lock = std::scoped_lock{registry.mutex};
+    auto first = true;
+    file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    for (auto const &buffer : registry.buffers) {
+      auto const head = buffer->head.load(std::memory_order_acquire);
+      auto const count = std::min<std::uint64_t>(head, ThreadBuffer::capacity_v);
+
+      for (auto index = head - count; index < head; ++index) {
+        auto const event = buffer->read(index);
+        if (!event) continue;
+        file << (first ? "\n" : ",\n")
+             << std::format(
+                  R"({{"name":"{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                  escape(event->name),
+                  buffer->thread_id,
+                  to_us(event->begin),
+                  to_us(event->end) - to_us(event->begin)
+                );
+        first = false;
+      }
+    }
+    file << "\n]}\n";
+
+    std::println("[lvk] Wrote trace to '{}'", path.generic_string());
+    return true;
+  }
+
+  /// Dumps all spans to path when the process exits normally.
+  export void dump_at_exit(fs::path path) {
+    if constexpr (!enabled_v) return;
+
+    auto &registry = get_registry();
+    auto const first = registry.exit_path.empty();
+    registry.exit_path = std::move(path);
+    if (first) {
+      std::atexit([] { dump(get_registry().exit_path); });
+    }
+  }
+} // namespace framework::trace
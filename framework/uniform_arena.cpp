@@ -0,0 +1,132 @@
+module;
+
+#include <vulkan/vulkan.hpp>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <print>
+#include <span>
+#include <vk_mem_alloc.h>
+
+export module framework:uniform_arena;
+import :vma;
+
+namespace framework {
+  struct UniformArenaCreateInfo {
+    VmaAllocator allocator;
+    std::uint32_t queue_family;
+    // Number of virtual frames, each gets its own region.
+    std::size_t buffering;
+    // minUniformBufferOffsetAlignment / minStorageBufferOffsetAlignment.
+    vk::DeviceSize alignment{256};
+    vk::DeviceSize size_per_frame{4 * 1024 * 1024};
+    vk::BufferUsageFlags usage{
+      vk::BufferUsageFlagBits::eUniformBuffer |
+      vk::BufferUsageFlagBits::eStorageBuffer
+    };
+  };
+
+  /// Per-frame bump allocator over one persistently mapped buffer, for
+  /// uniform and storage data pushed by any number of draws.
+  /// Bind the buffer once as a dynamic uniform (or storage) buffer and pass
+  /// each push()'s offset as the dynamic offset: one buffer and one
+  /// descriptor set serve every draw of every frame. Not thread-safe.
+  export class UniformArena {
+  public:
+    using CreateInfo = UniformArenaCreateInfo;
+
+    explicit UniformArena(CreateInfo const &create_info) :
+      alignment(create_info.alignment),
+      frame_size(align_up(create_info.size_per_frame, alignment)) {
+      auto const buffer_info = vma::BufferCreateInfo{
+        .allocator = create_info.allocator,
+        .usage = create_info.usage,
+        .queue_family = create_info.queue_family,
+      };
+      buffer = vma::create_buffer(
+        buffer_info,
+        vma::BufferMemoryType::Host,
+        frame_size * create_info.buffering
+      );
+      if (!buffer.get().buffer) {
+        throw std::runtime_error{"Failed to create Uniform Arena"};
+      }
+
+      std::println(
+        "[lvk] Uniform arena [{} x {} KiB]",
+        create_info.buffering,
+        frame_size / 1024
+      );
+    }
+
+    /// Starts allocating from frame_index's region, discarding its previous
+    /// contents: only call once that frame's last submission has retired.
+    void begin_frame(std::size_t const frame_index) {
+      frame_start = frame_size * frame_index;
+      head = 0;
+    }
+
+    /// Copies bytes into the current frame's region, returns the dynamic
+    /// offset to bind them at.
+    [[nodiscard]] auto push(std::span<std::byte const> bytes)
+      -> std::uint32_t {
+      auto const offset = align_up(head, alignment);
+      if (offset + bytes.size() > frame_size) {
+        throw std::runtime_error{"Uniform Arena out of memory"};
+      }
+
+      auto const position = frame_start + offset;
+      std::memcpy(
+        buffer.get().mapped_span().subspan(position).data(),
+        bytes.data(),
+        bytes.size()
+      );
+      head = offset + bytes.size();
+      return static_cast<std::uint32_t>(position);
+    }
+
+    template <typename Type>
+      requires std::is_trivially_copyable_v<Type>
+    [[nodiscard]] auto push(Type const &t) -> std::uint32_t {
+      return push(std::as_bytes(std::span{&t, 1}));
+    }
+
+    /// Makes this frame's writes visible to the device: call before
+    /// submitting.
+    void flush() const {
+      if (head == 0) return;
+      auto const &raw = buffer.get();
+      vmaFlushAllocation(raw.allocator, raw.allocation, frame_start, head);
+    }
+
+    [[nodiscard]] auto get_buffer() const -> vk::Buffer {
+      return buffer.get().buffer;
+    }
+
+    /// Bytes pushed in the current frame.
+    [[nodiscard]] auto frame_usage() const -> vk::DeviceSize {
+      return head;
+    }
+
+    /// Info for a dynamic descriptor, range being the largest push bound.
+    [[nodiscard]] auto descriptor_info(vk::DeviceSize const range) const
+      -> vk::DescriptorBufferInfo {
+      return vk::DescriptorBufferInfo()
+        .setBuffer(buffer.get().buffer)
+        .setRange(range);
+    }
+
+  private:
+    [[nodiscard]] static constexpr auto align_up(
+      vk::DeviceSize const value, vk::DeviceSize const alignment
+    ) -> vk::DeviceSize {
+      return (value + alignment - 1) / alignment * alignment;
+    }
+
+    vma::Buffer buffer;
+    vk::DeviceSize alignment{};
+    vk::DeviceSize frame_size{};
+    vk::DeviceSize frame_start{};
+    vk::DeviceSize head{};
+  };
+} // namespace framework
@@ -0,0 +1,709 @@
+module;
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_format_traits.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <print>
+#include <span>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+
+export module framework:upload;
+import :command_block;
+import :staging_ring;
+import :vma;
+
+namespace {
+  // Satisfies buffer-image copy offset rules for any color format.
+  constexpr vk::DeviceSize staging_alignment_v{16};
+
+  // Number of levels of a full mip chain down to 1x1.
+  [[nodiscard]] constexpr auto get_mip_levels(vk::Extent2D const extent)
+    -> std::uint32_t {
+    return static_cast<std::uint32_t>(
+      std::bit_width(std::max(extent.width, extent.height))
+    );
+  }
+
+  [[nodiscard]] constexpr auto get_mip_extent(
+    vk::Extent2D const extent, std::uint32_t const level
+  ) -> vk::Extent2D {
+    return {
+      std::max(extent.width >> level, 1u),
+      std::max(extent.height >> level, 1u),
+    };
+  }
+
+  // The GPU can blit (with linear filtering) between images of format.
+  [[nodiscard]] auto can_blit(VmaAllocator const allocator, vk::Format format)
+    -> bool {
+    auto allocator_info = VmaAllocatorInfo{};
+    vmaGetAllocatorInfo(allocator, &allocator_info);
+    auto const physical_device =
+      vk::PhysicalDevice{allocator_info.physicalDevice};
+
+    static constexpr auto features_v =
+      vk::FormatFeatureFlagBits::eBlitSrc |
+      vk::FormatFeatureFlagBits::eBlitDst |
+      vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    auto const properties = physical_device.getFormatProperties(format);
+    return (properties.optimalTilingFeatures & features_v) == features_v;
+  }
+
+  // sRGB encoded byte to linear, and back.
+  auto const srgb_to_linear_v = [] {
+    auto ret = std::array<float, 256>{};
+    for (auto i = 0uz; i < ret.size(); ++i) {
+      auto const c = static_cast<float>(i) / 255.0f;
+      ret.at(i) = c <= 0.04045f ? c / 12.92f
+                                : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return ret;
+  }();
+
+  [[nodiscard]] auto linear_to_srgb(float const c) -> std::byte {
+    auto const s = c <= 0.0031308f
+      ? c * 12.92f
+      : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return static_cast<std::byte>(std::lround(std::clamp(s, 0.0f, 1.0f) * 255));
+  }
+
+  // Halves an sRGB RGBA8 level with a 2x2 box filter, averaging colour in
+  // linear space (edge texels repeat on odd sizes).
+  [[nodiscard]] auto downsample(
+    std::span<std::byte const> src, vk::Extent2D const src_extent
+  ) -> std::vector<std::byte> {
+    static constexpr auto channels_v = 4uz;
+    auto const extent = get_mip_extent(src_extent, 1);
+    auto ret = std::vector<std::byte>(
+      std::size_t{extent.width} * extent.height * channels_v
+    );
+
+    auto const texel = [&](std::uint32_t x, std::uint32_t y) {
+      x = std::min(x, src_extent.width - 1);
+      y = std::min(y, src_extent.height - 1);
+      return src.subspan(
+        (std::size_t{y} * src_extent.width + x) * channels_v, channels_v
+      );
+    };
+
+    for (auto y = 0u; y < extent.height; ++y) {
+      for (auto x = 0u; x < extent.width; ++x) {
+        auto const quad = std::array{
+          texel(2 * x, 2 * y),
+          texel(2 * x + 1, 2 * y),
+          texel(2 * x, 2 * y + 1),
+          texel(2 * x + 1, 2 * y + 1),
+        };
+        auto *dst =
+          ret.data() + (std::size_t{y} * extent.width + x) * channels_v;
+        for (auto c = 0uz; c < channels_v; ++c) {
+          auto sum = 0.0f;
+          for (auto const &t : quad) {
+            auto const value = std::to_integer<std::size_t>(t[c]);
+            // Alpha is linear.
+            sum += c == 3 ? static_cast<float>(value) / 255.0f
+                          : srgb_to_linear_v.at(value);
+          }
+          auto const average = sum / static_cast<float>(quad.size());
+          dst[c] = c == 3
+            ? static_cast<std::byte>(std::lround(average * 255.0f))
+            : linear_to_srgb(average);
+        }
+      }
+    }
+    return ret;
+  }
+} // namespace
+
+namespace framework::vma {
+  // disparate byte spans.
+  using ByteSpans = std::span<std::span<std::byte const> const>;
+
+  // records copying each byte span sequentially into a new Device Buffer,
+  // returns it and the barrier handing it over to its consumers.
+  // Host visible Device Buffers (direct writes) are written immediately
+  // instead: nothing is recorded, and there is no barrier.
+  auto record_device_buffer(
+    BufferCreateInfo const &create_info,
+    CommandBlock &command_block,
+    ByteSpans const &byte_spans
+  ) -> std::pair<Buffer, std::optional<vk::BufferMemoryBarrier2>> {
+    auto const total_size = std::accumulate(
+      byte_spans.begin(),
+      byte_spans.end(),
+      0uz,
+      [](std::size_t const n, std::span<std::byte const> bytes) {
+        return n + bytes.size();
+      }
+    );
+
+    // Create the Device Buffer.
+    auto device_buffer =
+      create_buffer(create_info, BufferMemoryType::Device, total_size);
+
+    // Can't do anything if buffer creation failed.
+    if (!device_buffer.get().buffer) return {};
+
+    // Host writes are visible to submissions made after them.
+    if (auto const &raw = device_buffer.get(); raw.mapped) {
+      auto dst = raw.mapped_span();
+      for (auto const bytes : byte_spans) {
+        std::memcpy(dst.data(), bytes.data(), bytes.size());
+        dst = dst.subspan(bytes.size());
+      }
+      vmaFlushAllocation(raw.allocator, raw.allocation, 0, VK_WHOLE_SIZE);
+      return {std::move(device_buffer), std::nullopt};
+    }
+
+    // Copy byte spans through the staging ring, in chunks if it is smaller.
+    auto dst_offset = vk::DeviceSize{};
+    for (auto bytes : byte_spans) {
+      while (!bytes.empty()) {
+        auto const staging =
+          command_block.stage(bytes.size(), staging_alignment_v);
+        auto const size = staging.mapped.size();
+        std::memcpy(staging.mapped.data(), bytes.data(), size);
+
+        auto buffer_copy = vk::BufferCopy2{};
+        buffer_copy.setSrcOffset(staging.offset)
+          .setDstOffset(dst_offset)
+          .setSize(size);
+        auto copy_buffer_info = vk::CopyBufferInfo2{};
+        copy_buffer_info.setSrcBuffer(staging.buffer)
+          .setDstBuffer(device_buffer.get().buffer)
+          .setRegions(buffer_copy);
+        command_block.get_command_buffer().copyBuffer2(copy_buffer_info);
+
+        bytes = bytes.subspan(size);
+        dst_offset += size;
+      }
+    }
+
+    // Hand the buffer over to its consumers (on the graphics queue, when
+    // copied on a dedicated transfer queue).
+    auto const barrier =
+      vk::BufferMemoryBarrier2()
+        .setBuffer(device_buffer.get().buffer)
+        .setSize(VK_WHOLE_SIZE)
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+        .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+        .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead);
+
+    return {std::move(device_buffer), barrier};
+  }
+
+  // returns a Device Buffer with each byte span sequentially written.
+  export [[nodiscard]] auto create_device_buffer(
+    BufferCreateInfo const &create_info,
+    CommandBlock command_block,
+    ByteSpans const &byte_spans
+  ) -> Buffer {
+    auto [ret, barrier] =
+      record_device_buffer(create_info, command_block, byte_spans);
+    // Nothing to submit when written directly.
+    if (!barrier) return std::move(ret);
+
+    command_block.transfer_ownership(*barrier);
+
+    // Submit and wait: the staging memory is reclaimed once the submission
+    // has completed.
+    command_block.submit_and_wait();
+
+    return std::move(ret);
+  }
+
+  // records copying bytes (a whole level) through the staging ring into
+  // level of image, in chunks of whole rows if the ring is smaller. Rows
+  // are block_height texels high for block compressed formats.
+  void record_level_copy(
+    CommandBlock &command_block,
+    vk::Image const image,
+    std::span<std::byte const> bytes,
+    vk::Extent2D const extent,
+    std::uint32_t const level,
+    std::uint32_t const block_height = 1
+  ) {
+    auto const subresource_layers =
+      vk::ImageSubresourceLayers()
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setMipLevel(level)
+        .setLayerCount(1);
+
+    auto const block_rows = (extent.height + block_height - 1) / block_height;
+    auto const row_size = bytes.size_bytes() / block_rows;
+    auto row = std::uint32_t{};
+    while (!bytes.empty()) {
+      auto const staging =
+        command_block.stage(bytes.size(), staging_alignment_v, row_size);
+      auto const size = staging.mapped.size();
+      auto const rows = static_cast<std::uint32_t>(size / row_size);
+      std::memcpy(staging.mapped.data(), bytes.data(), size);
+
+      // The last row of blocks may extend past the image.
+      auto const y = row * block_height;
+      auto const height = std::min(rows * block_height, extent.height - y);
+      auto buffer_image_copy =
+        vk::BufferImageCopy2()
+          .setBufferOffset(staging.offset)
+          .setImageSubresource(subresource_layers)
+          .setImageOffset(vk::Offset3D{0, static_cast<std::int32_t>(y), 0})
+          .setImageExtent(vk::Extent3D{extent.width, height, 1});
+
+      auto copy_info =
+        vk::CopyBufferToImageInfo2()
+          .setDstImage(image)
+          .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+          .setSrcBuffer(staging.buffer)
+          .setRegions(buffer_image_copy);
+      command_block.get_command_buffer().copyBufferToImage2(copy_info);
+
+      bytes = bytes.subspan(size);
+      row += rows;
+    }
+  }
+
+  // records blitting each level of image from the previous one, level 0
+  // having been copied (in TransferDst layout). Each level is transitioned
+  // to TransferSrc once written: all levels end up in TransferSrc.
+  void record_mip_blits(
+    vk::CommandBuffer const command_buffer,
+    vk::Image const image,
+    vk::Extent2D const extent,
+    std::uint32_t const levels
+  ) {
+    auto barrier =
+      vk::ImageMemoryBarrier2()
+        .setImage(image)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+        .setSrcStageMask(
+          vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eBlit
+        )
+        .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eBlit)
+        .setDstAccessMask(vk::AccessFlagBits2::eTransferRead)
+        .setSubresourceRange(vk::ImageSubresourceRange()
+                               .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                               .setLevelCount(1)
+                               .setLayerCount(1));
+    auto const get_layers = [](std::uint32_t const level) {
+      return vk::ImageSubresourceLayers()
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setMipLevel(level)
+        .setLayerCount(1);
+    };
+    auto const to_offset = [](vk::Extent2D const e) {
+      return vk::Offset3D{
+        static_cast<std::int32_t>(e.width),
+        static_cast<std::int32_t>(e.height),
+        1,
+      };
+    };
+
+    for (auto level = 1u; level <= levels; ++level) {
+      // Level - 1 has been written: make it readable by the next blit.
+      barrier.subresourceRange.setBaseMipLevel(level - 1);
+      auto const dependency_info =
+        vk::DependencyInfo().setImageMemoryBarriers(barrier);
+      command_buffer.pipelineBarrier2(dependency_info);
+      if (level == levels) break;
+
+      auto const src_extent = get_mip_extent(extent, level - 1);
+      auto const dst_extent = get_mip_extent(extent, level);
+      auto const blit =
+        vk::ImageBlit2()
+          .setSrcSubresource(get_layers(level - 1))
+          .setSrcOffsets({vk::Offset3D{}, to_offset(src_extent)})
+          .setDstSubresource(get_layers(level))
+          .setDstOffsets({vk::Offset3D{}, to_offset(dst_extent)});
+      auto const blit_info =
+        vk::BlitImageInfo2()
+          .setSrcImage(image)
+          .setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+          .setDstImage(image)
+          .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+          .setRegions(blit)
+          .setFilter(vk::Filter::eLinear);
+      command_buffer.blitImage2(blit_info);
+    }
+  }
+
+  // records uploading bitmap into a new sampled image, returns it and the
+  // barrier transitioning it for sampling. With mipmaps, a full mip chain
+  // is generated: by blits on the GPU when the format supports them, else
+  // box filtered on the CPU and uploaded with level 0. On a dedicated
+  // transfer queue, blits are recorded on the owner (graphics) queue after
+  // acquiring the image, which is then already transitioned: no barrier
+  // is returned.
+  auto record_sampled_image(
+    ImageCreateInfo const &create_info,
+    CommandBlock &command_block,
+    Bitmap const &bitmap,
+    bool const mipmaps = false
+  ) -> std::pair<Image, std::optional<vk::ImageMemoryBarrier2>> {
+    static constexpr auto format_v = vk::Format::eR8G8B8A8Srgb;
+
+    // Create image
+    auto const usize = glm::uvec2{bitmap.size};
+    auto const extent = vk::Extent2D{usize.x, usize.y};
+    auto const mip_levels = mipmaps ? get_mip_levels(extent) : 1u;
+    // TransferSrc: can be copied elsewhere by defragmentation, and blitted
+    // from for mip-mapping.
+    auto const usage = vk::ImageUsageFlagBits::eTransferDst |
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled;
+
+    auto ret = create_image(create_info, usage, mip_levels, format_v, extent);
+
+    // Can't do anything if creation failed.
+    if (!ret.get().image) return {};
+
+    auto const gpu_mipmaps =
+      mip_levels > 1 && can_blit(create_info.allocator, format_v);
+    // Blits need a graphics queue: the owner queue of a cross-queue block.
+    auto const blit_on_owner = gpu_mipmaps && command_block.is_cross_queue();
+
+    // Transition all levels for transfer
+    auto subresource_range = vk::ImageSubresourceRange{};
+    subresource_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setLayerCount(1)
+      .setLevelCount(mip_levels);
+    auto barrier =
+      vk::ImageMemoryBarrier2()
+        .setImage(ret.get().image)
+        .setSrcQueueFamilyIndex(create_info.queue_family)
+        .setDstQueueFamilyIndex(create_info.queue_family)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSubresourceRange(subresource_range)
+        // Nothing to wait for: the image is new, its contents discarded.
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+        .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+        .setDstStageMask(
+          vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eBlit
+        )
+        .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite);
+
+    auto dependency_info = vk::DependencyInfo().setImageMemoryBarriers(barrier);
+    command_block.get_command_buffer().pipelineBarrier2(dependency_info);
+
+    record_level_copy(command_block, ret.get().image, bitmap.bytes, extent, 0);
+
+    if (gpu_mipmaps) {
+      if (blit_on_owner) {
+        // Hand level 0 (all levels, in TransferDst) over to the owner queue.
+        auto handover =
+          vk::ImageMemoryBarrier2(barrier)
+            .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eBlit)
+            .setDstAccessMask(
+              vk::AccessFlagBits2::eTransferRead |
+              vk::AccessFlagBits2::eTransferWrite
+            );
+        command_block.transfer_ownership(handover);
+      }
+      record_mip_blits(
+        command_block.get_owner_command_buffer(),
+        ret.get().image,
+        extent,
+        mip_levels
+      );
+      barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    } else {
+      // CPU fallback: each level filtered from the previous one.
+      auto level_bytes = std::vector<std::byte>{};
+      auto source = bitmap.bytes;
+      for (auto level = 1u; level < mip_levels; ++level) {
+        level_bytes = downsample(source, get_mip_extent(extent, level - 1));
+        source = level_bytes;
+        record_level_copy(
+          command_block,
+          ret.get().image,
+          source,
+          get_mip_extent(extent, level),
+          level
+        );
+      }
+      barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    }
+
+    // transition image for sampling, handing it over to the graphics queue
+    // when copied on a dedicated transfer queue.
+    barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+      .setSrcStageMask(barrier.dstStageMask)
+      .setSrcAccessMask(barrier.dstAccessMask)
+      .setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+      .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead);
+
+    if (blit_on_owner) {
+      // Already owned by the graphics queue.
+      barrier.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+      command_block.get_owner_command_buffer().pipelineBarrier2(
+        vk::DependencyInfo().setImageMemoryBarriers(barrier)
+      );
+      return {std::move(ret), std::nullopt};
+    }
+    return {std::move(ret), barrier};
+  }
+
+  // records copying an RGBA8 (sRGB) image of extent, already written to
+  // staging, into a new sampled image. Returns it and the barrier
+  // transitioning it for sampling.
+  auto record_staged_image(
+    ImageCreateInfo const &create_info,
+    CommandBlock &command_block,
+    StagingAllocation const &staging,
+    vk::Extent2D const extent
+  ) -> std::pair<Image, vk::ImageMemoryBarrier2> {
+    auto const usage = vk::ImageUsageFlagBits::eTransferDst |
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled;
+    auto ret = create_image(
+      create_info, usage, 1, vk::Format::eR8G8B8A8Srgb, extent
+    );
+    if (!ret.get().image) return {};
+
+    auto subresource_range = vk::ImageSubresourceRange{};
+    subresource_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setLayerCount(1)
+      .setLevelCount(1);
+    auto barrier =
+      vk::ImageMemoryBarrier2()
+        .setImage(ret.get().image)
+        .setSrcQueueFamilyIndex(create_info.queue_family)
+        .setDstQueueFamilyIndex(create_info.queue_family)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSubresourceRange(subresource_range)
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+        .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eCopy)
+        .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite);
+
+    auto const command_buffer = command_block.get_command_buffer();
+    auto dependency_info = vk::DependencyInfo().setImageMemoryBarriers(barrier);
+    command_buffer.pipelineBarrier2(dependency_info);
+
+    auto const buffer_image_copy =
+      vk::BufferImageCopy2()
+        .setBufferOffset(staging.offset)
+        .setImageSubresource(vk::ImageSubresourceLayers()
+                               .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                               .setLayerCount(1))
+        .setImageExtent(vk::Extent3D{extent.width, extent.height, 1});
+    auto const copy_info =
+      vk::CopyBufferToImageInfo2()
+        .setDstImage(ret.get().image)
+        .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSrcBuffer(staging.buffer)
+        .setRegions(buffer_image_copy);
+    command_buffer.copyBufferToImage2(copy_info);
+
+    barrier.setOldLayout(barrier.newLayout)
+      .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+      .setSrcStageMask(barrier.dstStageMask)
+      .setSrcAccessMask(barrier.dstAccessMask)
+      .setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+      .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead);
+
+    return {std::move(ret), barrier};
+  }
+
+  /// Levels of an image in any sampled format, largest first: eg block
+  /// compressed levels read from a KTX2 file (see load_ktx2()).
+  export struct ImageLevels {
+    vk::Format format{};
+    vk::Extent2D extent;
+    std::vector<std::span<std::byte const>> levels;
+  };
+
+  // records uploading each of levels as-is into a new sampled image,
+  // returns it and the barrier transitioning it for sampling.
+  auto record_sampled_image(
+    ImageCreateInfo const &create_info,
+    CommandBlock &command_block,
+    ImageLevels const &levels
+  ) -> std::pair<Image, vk::ImageMemoryBarrier2> {
+    auto const mip_levels = static_cast<std::uint32_t>(levels.levels.size());
+    auto const usage = vk::ImageUsageFlagBits::eTransferDst |
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled;
+
+    auto ret = create_image(
+      create_info, usage, mip_levels, levels.format, levels.extent
+    );
+    if (!ret.get().image) return {};
+
+    auto subresource_range = vk::ImageSubresourceRange{};
+    subresource_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+      .setLayerCount(1)
+      .setLevelCount(mip_levels);
+    auto barrier =
+      vk::ImageMemoryBarrier2()
+        .setImage(ret.get().image)
+        .setSrcQueueFamilyIndex(create_info.queue_family)
+        .setDstQueueFamilyIndex(create_info.queue_family)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSubresourceRange(subresource_range)
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+        .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eCopy)
+        .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite);
+
+    auto dependency_info = vk::DependencyInfo().setImageMemoryBarriers(barrier);
+    command_block.get_command_buffer().pipelineBarrier2(dependency_info);
+
+    auto const block_height = std::uint32_t{vk::blockExtent(levels.format)[1]};
+    for (auto level = 0u; level < mip_levels; ++level) {
+      record_level_copy(
+        command_block,
+        ret.get().image,
+        levels.levels.at(level),
+        get_mip_extent(levels.extent, level),
+        level,
+        block_height
+      );
+    }
+
+    barrier.setOldLayout(barrier.newLayout)
+      .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+      .setSrcStageMask(barrier.dstStageMask)
+      .setSrcAccessMask(barrier.dstAccessMask)
+      .setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+      .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead);
+
+    return {std::move(ret), barrier};
+  }
+
+  auto create_sampled_image(
+    ImageCreateInfo const &create_info,
+    CommandBlock command_block,
+    Bitmap const &bitmap,
+    bool const mipmaps = false
+  ) -> Image {
+    auto [ret, barrier] =
+      record_sampled_image(create_info, command_block, bitmap, mipmaps);
+    if (!ret.get().image) return {};
+
+    if (barrier) command_block.transfer_ownership(*barrier);
+    command_block.submit_and_wait();
+
+    return std::move(ret);
+  }
+
+  /// Records many buffer and image uploads into one Command Block, with all
+  /// their ownership/layout barriers batched, and submits them at once:
+  /// one submission instead of one per resource. Submit once.
+  /// Returned resources can be used once submit() has returned, or once
+  /// submit_async()'s ticket has completed (or been waited on by the
+  /// submission using them).
+  export class UploadBatch {
+  public:
+    explicit UploadBatch(CommandBlock command_block) :
+      command_block(std::move(command_block)) {}
+
+    [[nodiscard]] auto add_buffer(
+      BufferCreateInfo const &create_info, ByteSpans const &byte_spans
+    ) -> Buffer {
+      auto [ret, barrier] =
+        record_device_buffer(create_info, command_block, byte_spans);
+      if (barrier) buffer_barriers.push_back(*barrier);
+      return std::move(ret);
+    }
+
+    /// Uploads an RGBA8 (sRGB) bitmap into a sampled image, eg for Texture,
+    /// with a full mip chain if mipmaps.
+    [[nodiscard]] auto add_image(
+      ImageCreateInfo const &create_info,
+      Bitmap const &bitmap,
+      bool const mipmaps = false
+    ) -> Image {
+      auto [ret, barrier] =
+        record_sampled_image(create_info, command_block, bitmap, mipmaps);
+      if (barrier) image_barriers.push_back(*barrier);
+      return std::move(ret);
+    }
+
+    /// Uploads pre-built levels (eg block compressed) into a sampled image.
+    [[nodiscard]] auto add_image(
+      ImageCreateInfo const &create_info, ImageLevels const &levels
+    ) -> Image {
+      auto [ret, barrier] =
+        record_sampled_image(create_info, command_block, levels);
+      if (ret.get().image) image_barriers.push_back(barrier);
+      return std::move(ret);
+    }
+
+    /// Staging memory for add_image(staging, ...), or nullopt if the ring
+    /// is full until flush(). Write it before the next flush or submit.
+    [[nodiscard]] auto try_stage(
+      vk::DeviceSize const size, vk::DeviceSize const alignment
+    ) -> std::optional<StagingAllocation> {
+      return command_block.try_stage(size, alignment);
+    }
+
+    /// Uploads an RGBA8 (sRGB) image already written to staging (see
+    /// try_stage()) into a sampled image.
+    [[nodiscard]] auto add_image(
+      ImageCreateInfo const &create_info,
+      StagingAllocation const &staging,
+      vk::Extent2D const extent
+    ) -> Image {
+      auto [ret, barrier] =
+        record_staged_image(create_info, command_block, staging, extent);
+      if (ret.get().image) image_barriers.push_back(barrier);
+      return std::move(ret);
+    }
+
+    /// Submits everything added so far and waits for it, reclaiming the
+    /// staging ring, then keeps recording.
+    void flush() {
+      command_block.transfer_ownership(image_barriers, buffer_barriers);
+      command_block.flush();
+
+      image_barriers.clear();
+      buffer_barriers.clear();
+    }
+
+    /// Number of resources added since the last submit (or flush).
+    [[nodiscard]] auto size() const -> std::size_t {
+      return image_barriers.size() + buffer_barriers.size();
+    }
+
+    /// Submits everything added and waits for it.
+    void submit() {
+      command_block.transfer_ownership(image_barriers, buffer_barriers);
+      command_block.submit_and_wait();
+
+      image_barriers.clear();
+      buffer_barriers.clear();
+    }
+
+    /// Submits everything added without blocking. Keep the result alive
+    /// until it has completed (eg with Renderer::submit_async()).
+    [[nodiscard]] auto submit_async() -> PendingSubmission {
+      command_block.transfer_ownership(image_barriers, buffer_barriers);
+      auto ret = command_block.submit();
+
+      image_barriers.clear();
+      buffer_barriers.clear();
+      return ret;
+    }
+
+  private:
+    CommandBlock command_block;
+    std::vector<vk::ImageMemoryBarrier2> image_barriers;
+    std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+  };
+} // namespace framework::vma
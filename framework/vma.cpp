@@ -2,28 +2,169 @@ module;
 
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
-#include <cstring>
-#include <numeric>
+#include <array>
+#include <atomic>
+#include <optional>
+#include <mutex>
 #include <print>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
 #include <vk_mem_alloc.h>
 
 export module framework:vma;
 import :scoped;
-import :command_block;
 
 namespace framework::vma {
+  /// What an allocation is used for, for memory statistics.
+  export enum class MemoryTag : std::int8_t {
+    Vertex,
+    Texture,
+    Staging,
+    Uniform,
+    Attachment,
+    // Keep last: memory_tag_count_v counts up to it.
+    Other,
+  };
+
+  export inline constexpr std::size_t memory_tag_count_v{
+    static_cast<std::size_t>(MemoryTag::Other) + 1
+  };
+
+  export [[nodiscard]] constexpr auto to_string(MemoryTag const tag)
+    -> std::string_view {
+    switch (tag) {
+      case MemoryTag::Vertex:
+        return "vertex";
+      case MemoryTag::Texture:
+        return "texture";
+      case MemoryTag::Staging:
+        return "staging";
+      case MemoryTag::Uniform:
+        return "uniform";
+      case MemoryTag::Attachment:
+        return "attachment";
+      default:
+        return "other";
+    }
+  }
+
+  /// Live allocations of one tag, of one allocator.
+  export struct TagUsage {
+    std::uint64_t count{};
+    vk::DeviceSize bytes{};
+  };
+
+  // Updated on every Buffer/Image creation and destruction.
+  struct TagCounter {
+    std::atomic<std::uint64_t> count{};
+    std::atomic<std::uint64_t> bytes{};
+  };
+
+  using TagCounters = std::array<TagCounter, memory_tag_count_v>;
+
+  // Per allocator, from create_allocator() until its destruction. VMA has no
+  // user data on allocators: resources only know theirs.
+  std::shared_mutex tag_counters_mutex;
+  std::unordered_map<VmaAllocator, TagCounters> tag_counters;
+
+  // Counters of tag for allocator, null if not created by create_allocator().
+  [[nodiscard]] auto find_counter(
+    VmaAllocator const allocator, MemoryTag const tag
+  ) -> TagCounter * {
+    auto const lock = std::shared_lock{tag_counters_mutex};
+    auto const it = tag_counters.find(allocator);
+    if (it == tag_counters.end()) return nullptr;
+    return &it->second.at(static_cast<std::size_t>(tag));
+  }
+
+  void track(
+    MemoryTag const tag,
+    VmaAllocator const allocator,
+    VmaAllocationInfo const &info
+  ) {
+    auto *counter = find_counter(allocator, tag);
+    if (counter == nullptr) return;
+    ++counter->count;
+    counter->bytes += info.size;
+  }
+
+  void untrack(
+    MemoryTag const tag,
+    VmaAllocator const allocator,
+    VmaAllocation const allocation
+  ) {
+    auto *counter = find_counter(allocator, tag);
+    if (counter == nullptr) return;
+    auto info = VmaAllocationInfo{};
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    --counter->count;
+    counter->bytes -= info.size;
+  }
+
+  /// Live Buffers, Images and Allocations of allocator with tag.
+  export [[nodiscard]] auto get_tag_usage(
+    VmaAllocator const allocator, MemoryTag const tag
+  ) -> TagUsage {
+    auto const *counter = find_counter(allocator, tag);
+    if (counter == nullptr) return {};
+    return TagUsage{.count = counter->count, .bytes = counter->bytes};
+  }
+
+  /// Whether Device buffers are best written directly by the host (see
+  /// BufferCreateInfo::direct_write): UMA (all memory is device local and
+  /// host visible) or ReBAR (the largest device local heap is entirely host
+  /// visible, not just a 256 MiB window).
+  export [[nodiscard]] auto has_direct_write(VmaAllocator const allocator)
+    -> bool {
+    VkPhysicalDeviceMemoryProperties const *properties{};
+    vmaGetMemoryProperties(allocator, &properties);
+
+    auto largest_heap = std::optional<std::uint32_t>{};
+    for (auto i = 0u; i < properties->memoryHeapCount; ++i) {
+      auto const &heap = properties->memoryHeaps[i];
+      if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) continue;
+      if (!largest_heap ||
+          heap.size > properties->memoryHeaps[*largest_heap].size) {
+        largest_heap = i;
+      }
+    }
+    if (!largest_heap) return false;
+
+    static constexpr auto flags_v = VkMemoryPropertyFlags{
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+    };
+    for (auto i = 0u; i < properties->memoryTypeCount; ++i) {
+      auto const &type = properties->memoryTypes[i];
+      if (type.heapIndex == *largest_heap &&
+          (type.propertyFlags & flags_v) == flags_v) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   export struct Deleter {
     void operator()(VmaAllocator allocator) const noexcept {
+      {
+        auto const lock = std::unique_lock{tag_counters_mutex};
+        tag_counters.erase(allocator);
+      }
       vmaDestroyAllocator(allocator);
     }
   };
 
   export using Allocator = Scoped<VmaAllocator, Deleter>;
 
+  /// api_version: the instance's, which VMA fetches core functions for.
+  /// memory_budget: VK_EXT_memory_budget is enabled on device, for
+  /// accurate heap budgets and usage.
   export [[nodiscard]] auto create_allocator(
     vk::Instance const instance,
     vk::PhysicalDevice const physical_device,
-    vk::Device const device
+    vk::Device const device,
+    std::uint32_t const api_version,
+    bool const memory_budget = false
   ) -> Allocator {
     auto const &dispatcher = VULKAN_HPP_DEFAULT_DISPATCHER;
 
@@ -37,12 +178,25 @@ namespace framework::vma {
     allocator_info.device = device;
     allocator_info.pVulkanFunctions = &vma_vk_funcs;
     allocator_info.instance = instance;
+    // Else VMA assumes Vulkan 1.0, and looks up the KHR aliases of
+    // vkGetPhysicalDeviceMemoryProperties2 (for the budget) which the
+    // instance doesn't enable.
+    allocator_info.vulkanApiVersion = api_version;
+    if (memory_budget) {
+      allocator_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     VmaAllocator allocator{};
     auto const result = vmaCreateAllocator(&allocator_info, &allocator);
-    if (result == VK_SUCCESS) return allocator;
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error{"Failed to create Vulkan Memory Allocator"};
+    }
 
-    throw std::runtime_error{"Failed to create Vulkan Memory Allocator"};
+    {
+      auto const lock = std::unique_lock{tag_counters_mutex};
+      tag_counters.try_emplace(allocator);
+    }
+    return allocator;
   }
 
   export struct RawBuffer {
@@ -57,10 +211,13 @@ namespace framework::vma {
     vk::Buffer buffer;
     vk::DeviceSize size{};
     void *mapped{};
+    vk::BufferUsageFlags usage;
+    MemoryTag tag{MemoryTag::Other};
   };
 
   export struct BufferDeleter {
     void operator()(RawBuffer const &raw_buffer) const noexcept {
+      untrack(raw_buffer.tag, raw_buffer.allocator, raw_buffer.allocation);
       vmaDestroyBuffer(
         raw_buffer.allocator, raw_buffer.buffer, raw_buffer.allocation
       );
@@ -73,9 +230,35 @@ namespace framework::vma {
     VmaAllocator allocator;
     vk::BufferUsageFlags usage;
     std::uint32_t queue_family;
+    // Device buffers are allocated host visible when possible, and written
+    // without staging (see create_device_buffer()). Set if
+    // has_direct_write(), eg from Renderer::direct_write.
+    bool direct_write{};
   };
 
-  export enum class BufferMemoryType : std::int8_t { Host, Device };
+  export enum class BufferMemoryType : std::int8_t { Host, Device, Readback };
+
+  [[nodiscard]] auto get_memory_tag(
+    vk::BufferUsageFlags const usage, BufferMemoryType const memory_type
+  ) -> MemoryTag {
+    using enum vk::BufferUsageFlagBits;
+    if (memory_type == BufferMemoryType::Host && (usage & eTransferSrc)) {
+      return MemoryTag::Staging;
+    }
+    if (usage & (eVertexBuffer | eIndexBuffer)) return MemoryTag::Vertex;
+    if (usage & (eUniformBuffer | eStorageBuffer)) return MemoryTag::Uniform;
+    return MemoryTag::Other;
+  }
+
+  [[nodiscard]] auto get_memory_tag(vk::ImageUsageFlags const usage)
+    -> MemoryTag {
+    using enum vk::ImageUsageFlagBits;
+    if (usage & (eColorAttachment | eDepthStencilAttachment)) {
+      return MemoryTag::Attachment;
+    }
+    if (usage & eSampled) return MemoryTag::Texture;
+    return MemoryTag::Other;
+  }
 
   export [[nodiscard]] auto create_buffer(
     BufferCreateInfo const &create_info,
@@ -94,8 +277,24 @@ namespace framework::vma {
     auto usage = create_info.usage;
     if (memory_type == BufferMemoryType::Device) {
       allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-      // Device buffers need to support TransferDst.
-      usage |= vk::BufferUsageFlagBits::eTransferDst;
+      // Device buffers need to support TransferDst, and TransferSrc to be
+      // copied elsewhere by defragmentation.
+      usage |= vk::BufferUsageFlagBits::eTransferDst |
+        vk::BufferUsageFlagBits::eTransferSrc;
+      // Written through staging, so host access isn't needed; unless direct
+      // writes are enabled: then mapped if VMA picks host visible memory.
+      allocation_ci.flags = {};
+      if (create_info.direct_write) {
+        allocation_ci.flags =
+          VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+          VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT |
+          VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      }
+    } else if (memory_type == BufferMemoryType::Readback) {
+      allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+      // Readback buffers are read by the host, prefer cached memory.
+      allocation_ci.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+        VMA_ALLOCATION_CREATE_MAPPED_BIT;
     } else {
       allocation_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
       // Host buffers can provide mapped memory.
@@ -126,74 +325,21 @@ namespace framework::vma {
       return {};
     }
 
+    auto const tag = get_memory_tag(create_info.usage, memory_type);
+    track(tag, create_info.allocator, allocation_info);
+
     return RawBuffer{
       .allocator = create_info.allocator,
       .allocation = allocation,
       .buffer = buffer,
       .size = size,
       .mapped = allocation_info.pMappedData,
+      .usage = usage,
+      .tag = tag,
     };
   }
 
-  // disparate byte spans.
-  using ByteSpans = std::span<std::span<std::byte const> const>;
-
-  // returns a Device Buffer with each byte span sequentially written.
-  export [[nodiscard]] auto create_device_buffer(
-    BufferCreateInfo const &create_info,
-    CommandBlock command_block,
-    ByteSpans const &byte_spans
-  ) -> Buffer {
-    auto const total_size = std::accumulate(
-      byte_spans.begin(),
-      byte_spans.end(),
-      0uz,
-      [](std::size_t const n, std::span<std::byte const> bytes) {
-        return n + bytes.size();
-      }
-    );
-
-    auto staging_info = create_info;
-    staging_info.usage = vk::BufferUsageFlagBits::eTransferSrc;
-
-    // Create staging Host Buffer with TransferSrc usage.
-    auto staging_buffer =
-      create_buffer(staging_info, BufferMemoryType::Host, total_size);
-
-    // Create the Device Buffer.
-    auto device_buffer =
-      create_buffer(create_info, BufferMemoryType::Device, total_size);
-
-    // Can't do anything if either buffer creation failed.
-    if (!staging_buffer.get().buffer || !device_buffer.get().buffer) return {};
-
-    // Copy byte spans into staging buffer.
-    auto dst = staging_buffer.get().mapped_span();
-    for (auto const bytes : byte_spans) {
-      std::memcpy(dst.data(), bytes.data(), bytes.size());
-      dst = dst.subspan(bytes.size());
-    }
-
-    // Record buffer copy operation.
-    auto buffer_copy = vk::BufferCopy2{};
-    buffer_copy.setSize(total_size);
-    auto copy_buffer_info = vk::CopyBufferInfo2{};
-    copy_buffer_info.setSrcBuffer(staging_buffer.get().buffer)
-      .setDstBuffer(device_buffer.get().buffer)
-      .setRegions(buffer_copy);
-    command_block.get_command_buffer().copyBuffer2(copy_buffer_info);
-
-    // Submit and wait.
-    // Waiting here is necessary to keep the staging buffer alive while the GPU
-    // accesses it through the recorded commands.
-    // this is also why the function takes ownership of the passed CommandBlock
-    // instead of just referencing it / taking a vk::CommandBuffer.
-    command_block.submit_and_wait();
-
-    return device_buffer;
-  }
-
-  struct RawImage {
+  export struct RawImage {
     auto operator==(RawImage const &rhs) const -> bool = default;
 
     VmaAllocator allocator{};
@@ -202,19 +348,22 @@ namespace framework::vma {
     vk::Extent2D extent;
     vk::Format format{};
     std::uint32_t levels{};
+    vk::ImageUsageFlags usage;
+    MemoryTag tag{MemoryTag::Other};
   };
 
-  struct ImageDeleter {
+  export struct ImageDeleter {
     void operator()(RawImage const &raw_image) const noexcept {
+      untrack(raw_image.tag, raw_image.allocator, raw_image.allocation);
       vmaDestroyImage(
         raw_image.allocator, raw_image.image, raw_image.allocation
       );
     }
   };
 
-  using Image = Scoped<RawImage, ImageDeleter>;
+  export using Image = Scoped<RawImage, ImageDeleter>;
 
-  struct ImageCreateInfo {
+  export struct ImageCreateInfo {
     VmaAllocator allocator;
     std::uint32_t queue_family;
   };
@@ -250,13 +399,14 @@ namespace framework::vma {
 
     VkImage image{};
     VmaAllocation allocation{};
+    auto vma_allocation_info = VmaAllocationInfo{};
     auto const result = vmaCreateImage(
       create_info.allocator,
       &vk_image_info,
       &allocation_info,
       &image,
       &allocation,
-      {}
+      &vma_allocation_info
     );
 
     if (result != VK_SUCCESS) {
@@ -264,6 +414,9 @@ namespace framework::vma {
       return {};
     }
 
+    auto const tag = get_memory_tag(usage);
+    track(tag, create_info.allocator, vma_allocation_info);
+
     return RawImage{
       .allocator = create_info.allocator,
       .allocation = allocation,
@@ -271,109 +424,90 @@ namespace framework::vma {
       .extent = extent,
       .format = format,
       .levels = levels,
+      .usage = usage,
+      .tag = tag,
     };
   }
 
-  export struct Bitmap {
-    std::span<std::byte const> bytes;
-    glm::ivec2 size{};
+  /// Device memory not bound to a resource at creation: images are bound
+  /// into it with vmaBindImageMemory(), eg several whose uses don't
+  /// overlap (aliasing). Destroy them before the allocation.
+  export struct RawAllocation {
+    auto operator==(RawAllocation const &rhs) const -> bool = default;
+
+    VmaAllocator allocator{};
+    VmaAllocation allocation{};
+    vk::DeviceSize size{};
+    std::uint32_t memory_type{};
+    MemoryTag tag{MemoryTag::Other};
   };
 
-  auto create_sampled_image(
-    ImageCreateInfo const &create_info,
-    CommandBlock command_block,
-    Bitmap const &bitmap
-  ) -> Image {
-    // Create image
-    // no mip-mapping right now: 1 level.
-    auto const mip_levels = 1u;
-    auto const usize = glm::uvec2{bitmap.size};
-    auto const extent = vk::Extent2D{usize.x, usize.y};
-    auto const usage =
-      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
-
-    auto ret = create_image(
-      create_info, usage, mip_levels, vk::Format::eR8G8B8A8Srgb, extent
-    );
+  export struct AllocationDeleter {
+    void operator()(RawAllocation const &raw_allocation) const noexcept {
+      untrack(
+        raw_allocation.tag, raw_allocation.allocator, raw_allocation.allocation
+      );
+      vmaFreeMemory(raw_allocation.allocator, raw_allocation.allocation);
+    }
+  };
 
-    // Create staging buffer
-    auto const buffer_info = BufferCreateInfo{
-      .allocator = create_info.allocator,
-      .usage = vk::BufferUsageFlagBits::eTransferSrc,
-      .queue_family = create_info.queue_family,
-    };
+  export using Allocation = Scoped<RawAllocation, AllocationDeleter>;
 
-    auto const staging_buffer = create_buffer(
-      buffer_info, BufferMemoryType::Host, bitmap.bytes.size_bytes()
-    );
+  /// Allocator has a lazily allocated memory type: attachments whose
+  /// contents never leave tile memory need no backing memory (tilers).
+  export [[nodiscard]] auto has_lazy_memory(VmaAllocator const allocator)
+    -> bool {
+    VkPhysicalDeviceMemoryProperties const *properties{};
+    vmaGetMemoryProperties(allocator, &properties);
 
-    // Can't do anything if either creation failed.
-    if (!ret.get().image || !staging_buffer.get().buffer) {
-      return {};
+    for (auto i = 0u; i < properties->memoryTypeCount; ++i) {
+      auto const flags = properties->memoryTypes[i].propertyFlags;
+      if ((flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0) return true;
+    }
+    return false;
+  }
+
+  /// Device local memory satisfying requirements, lazily allocated if lazy
+  /// (see has_lazy_memory()).
+  export [[nodiscard]] auto allocate_memory(
+    VmaAllocator const allocator,
+    vk::MemoryRequirements const &requirements,
+    MemoryTag const tag,
+    bool const lazy = false
+  ) -> Allocation {
+    auto allocation_ci = VmaAllocationCreateInfo{};
+    if (lazy) {
+      allocation_ci.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+    } else {
+      allocation_ci.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     }
 
-    // Copy bytes into staging buffer
-    std::memcpy(
-      staging_buffer.get().mapped,
-      bitmap.bytes.data(),
-      bitmap.bytes.size_bytes()
+    auto const vk_requirements =
+      static_cast<VkMemoryRequirements>(requirements);
+    VmaAllocation allocation{};
+    auto allocation_info = VmaAllocationInfo{};
+    auto const result = vmaAllocateMemory(
+      allocator, &vk_requirements, &allocation_ci, &allocation, &allocation_info
     );
 
-    // Transition image for transfer
-    auto subresource_range = vk::ImageSubresourceRange{};
-    subresource_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
-      .setLayerCount(1)
-      .setLevelCount(mip_levels);
-    auto barrier =
-      vk::ImageMemoryBarrier2()
-        .setImage(ret.get().image)
-        .setSrcQueueFamilyIndex(create_info.queue_family)
-        .setDstQueueFamilyIndex(create_info.queue_family)
-        .setOldLayout(vk::ImageLayout::eUndefined)
-        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-        .setSubresourceRange(subresource_range)
-        .setSrcStageMask(vk::PipelineStageFlagBits2::eTopOfPipe)
-        .setSrcAccessMask(vk::AccessFlagBits2::eNone)
-        .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
-        .setDstAccessMask(
-          vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite
-        );
-
-    auto dependency_info = vk::DependencyInfo().setImageMemoryBarriers(barrier);
-    command_block.get_command_buffer().pipelineBarrier2(dependency_info);
-
-    // record buffer image copy.
-    auto subresource_layers = vk::ImageSubresourceLayers()
-                                .setAspectMask(vk::ImageAspectFlagBits::eColor)
-                                .setLayerCount(1)
-                                .setLayerCount(mip_levels);
-
-    auto buffer_image_copy =
-      vk::BufferImageCopy2()
-        .setImageSubresource(subresource_layers)
-        .setImageExtent(vk::Extent3D{extent.width, extent.height, 1});
-
-    auto copy_info = vk::CopyBufferToImageInfo2()
-                       .setDstImage(ret.get().image)
-                       .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
-                       .setSrcBuffer(staging_buffer.get().buffer)
-                       .setRegions(buffer_image_copy);
-    command_block.get_command_buffer().copyBufferToImage2(copy_info);
-
-    // transition image for sampling.
-    barrier.setOldLayout(barrier.newLayout)
-      .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-      .setSrcStageMask(barrier.dstStageMask)
-      .setSrcAccessMask(barrier.dstAccessMask)
-      .setDstStageMask(vk::PipelineStageFlagBits2::eAllGraphics)
-      .setDstAccessMask(
-        vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite
-      );
-    dependency_info.setImageMemoryBarriers(barrier);
-    command_block.get_command_buffer().pipelineBarrier2(dependency_info);
+    if (result != VK_SUCCESS) {
+      std::println(stderr, "Failed to allocate VMA Memory");
+      return {};
+    }
 
-    command_block.submit_and_wait();
+    track(tag, allocator, allocation_info);
 
-    return ret;
+    return RawAllocation{
+      .allocator = allocator,
+      .allocation = allocation,
+      .size = allocation_info.size,
+      .memory_type = allocation_info.memoryType,
+      .tag = tag,
+    };
   }
+
+  export struct Bitmap {
+    std::span<std::byte const> bytes;
+    glm::ivec2 size{};
+  };
 } // namespace framework::vma